@@ -0,0 +1,75 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "data/season_archive.h"
+
+ABSL_FLAG(
+    std::string, results_dir, "", "Path to directory containing race results.");
+ABSL_FLAG(
+    std::string,
+    output_dir,
+    "",
+    "Directory to write one archive per season to, e.g. 2024.f1season.");
+
+namespace fs = ::std::filesystem;
+
+using ::f1_predict::list_race_files;
+using ::f1_predict::load_races;
+using ::f1_predict::write_season_archive;
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  const fs::path results_dir = absl::GetFlag(FLAGS_results_dir);
+  if (results_dir.empty() || !fs::is_directory(results_dir)) {
+    std::cerr << "Must specify an existing --results_dir." << std::endl;
+    return 1;
+  }
+  const fs::path output_dir = absl::GetFlag(FLAGS_output_dir);
+  if (output_dir.empty()) {
+    std::cerr << "Must specify --output_dir." << std::endl;
+    return 1;
+  }
+
+  std::map<std::string, std::vector<fs::path>> season_races;
+  for (fs::path& race_path : list_race_files(results_dir)) {
+    season_races[race_path.parent_path().filename().string()].push_back(
+        std::move(race_path));
+  }
+  if (season_races.empty()) {
+    std::cerr << "No results found under " << results_dir << std::endl;
+    return 1;
+  }
+
+  fs::create_directories(output_dir);
+  size_t result_count = 0;
+  uintmax_t archive_size = 0;
+  for (const auto& [season, race_paths] : season_races) {
+    std::vector<f1_predict::RaceResult> races = load_races(race_paths);
+    std::vector<const f1_predict::DriverResult*> results;
+    for (const f1_predict::RaceResult& race : races) {
+      for (const f1_predict::DriverResult& result : race.results()) {
+        results.push_back(&result);
+      }
+    }
+    fs::path archive_path =
+        output_dir / (season + f1_predict::SEASON_ARCHIVE_EXTENSION);
+    write_season_archive(archive_path, results);
+    result_count += results.size();
+    archive_size += fs::file_size(archive_path);
+  }
+  std::cout << "Archived " << result_count << " results from "
+            << season_races.size() << " seasons into " << archive_size
+            << " bytes under " << output_dir << std::endl;
+  return 0;
+}
@@ -0,0 +1,632 @@
+#include "data/batch_io.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "data/batch_io_testing.h"
+
+namespace f1_predict {
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete) {
+  return static_cast<int>(::syscall(
+      __NR_io_uring_enter,
+      ring_fd,
+      to_submit,
+      min_complete,
+      IORING_ENTER_GETEVENTS,
+      nullptr,
+      0));
+}
+
+namespace {
+
+namespace fs = ::std::filesystem;
+
+// Blocking file I/O mostly waits on the disk rather than the CPU, so the thread
+// pool backend runs more threads than there are cores.
+constexpr unsigned IO_THREADS_PER_CORE = 4;
+
+// Every file in a batch has two operations in flight at once while opening:
+// the open itself and a statx for its size.
+constexpr unsigned RING_ENTRIES = 2 * IO_BATCH_SIZE;
+
+constexpr int NEW_FILE_MODE = 0666;
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, void* arg, unsigned count) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, ring_fd, opcode, arg, count));
+}
+
+// Minimal io_uring wrapper. Operations are queued with next_sqe() and run as a
+// single batch by submit_and_wait(), which returns once all of them complete,
+// so the ring never holds more than one batch. Tests can replace the
+// io_uring_enter call it makes.
+class io_ring {
+public:
+  static std::unique_ptr<io_ring>
+  create(unsigned entries, io_uring_enter_fn enter = io_uring_enter) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd < 0) return nullptr;
+    std::unique_ptr<io_ring> ring{new io_ring(ring_fd, enter)};
+    if (!ring->map(params)) return nullptr;
+    return ring;
+  }
+
+  io_ring(const io_ring&) = delete;
+  io_ring& operator=(const io_ring&) = delete;
+
+  ~io_ring() {
+    if (_sqes != MAP_FAILED) ::munmap(_sqes, _sqes_size);
+    if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) {
+      ::munmap(_cq_ring, _cq_ring_size);
+    }
+    if (_sq_ring != MAP_FAILED) ::munmap(_sq_ring, _sq_ring_size);
+    ::close(_fd);
+  }
+
+  int fd() const { return _fd; }
+
+  // Returns a zeroed submission entry. No more entries may be queued than the
+  // ring was created with before the next submit_and_wait().
+  io_uring_sqe& next_sqe() {
+    unsigned tail = *_sq_tail + _queued;
+    unsigned index = tail & *_sq_mask;
+    _sq_array[index] = index;
+    ++_queued;
+    io_uring_sqe& sqe = _sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    return sqe;
+  }
+
+  // Submits every queued entry and calls `on_complete` with the user data and
+  // result of each as it completes. Returns false if the kernel rejected the
+  // submission. By then every entry the kernel had consumed has completed and
+  // been passed to `on_complete`, and the rest were dropped, so nothing is
+  // left queued or in flight to touch the caller's buffers.
+  bool
+  submit_and_wait(const std::function<void(uint64_t, int)>& on_complete) {
+    unsigned to_submit = _queued;
+    std::atomic_ref<unsigned>{*_sq_tail}.store(
+        *_sq_tail + _queued, std::memory_order_release);
+    _queued = 0;
+
+    unsigned remaining = to_submit;
+    while (remaining > 0) {
+      int result = _enter(_fd, to_submit, remaining);
+      if (result < 0) {
+        if (errno == EINTR) continue;
+        drain(remaining, on_complete);
+        return false;
+      }
+      to_submit -= std::min<unsigned>(to_submit, result);
+      remaining -= reap(remaining, on_complete);
+    }
+    return true;
+  }
+
+private:
+  io_ring(int fd, io_uring_enter_fn enter) : _fd{fd}, _enter{enter} {}
+
+  // Passes up to `limit` completions to `on_complete` and returns how many.
+  unsigned
+  reap(unsigned limit, const std::function<void(uint64_t, int)>& on_complete) {
+    unsigned head = *_cq_head;
+    unsigned tail =
+        std::atomic_ref<unsigned>{*_cq_tail}.load(std::memory_order_acquire);
+    unsigned reaped = 0;
+    for (; head != tail && reaped < limit; ++head, ++reaped) {
+      const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+      on_complete(cqe.user_data, cqe.res);
+    }
+    std::atomic_ref<unsigned>{*_cq_head}.store(head, std::memory_order_release);
+    return reaped;
+  }
+
+  // After a failed io_uring_enter, drops the entries the kernel never
+  // consumed and waits for the rest of the `remaining` completions.
+  // Without SQPOLL the kernel only reads the submission queue inside
+  // io_uring_enter, so moving the tail back to its head is safe. Exits if the
+  // wait itself keeps failing, since returning would free buffers the kernel
+  // may still write to.
+  void drain(
+      unsigned remaining,
+      const std::function<void(uint64_t, int)>& on_complete) {
+    unsigned head =
+        std::atomic_ref<unsigned>{*_sq_head}.load(std::memory_order_acquire);
+    remaining -= *_sq_tail - head;
+    std::atomic_ref<unsigned>{*_sq_tail}.store(head, std::memory_order_release);
+    while (remaining > 0) {
+      remaining -= reap(remaining, on_complete);
+      if (remaining == 0) break;
+      if (_enter(_fd, 0, remaining) < 0 && errno != EINTR &&
+          errno != EAGAIN && errno != EBUSY) {
+        std::cerr << "Failed to wait for " << remaining
+                  << " io_uring operations: " << std::strerror(errno)
+                  << std::endl;
+        std::exit(1);
+      }
+    }
+  }
+
+  bool map(const io_uring_params& params) {
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+    _sq_ring = ::mmap(
+        nullptr,
+        _sq_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        _fd,
+        IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED) return false;
+    _cq_ring = single_mmap ? _sq_ring
+                           : ::mmap(
+                                 nullptr,
+                                 _cq_ring_size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE,
+                                 _fd,
+                                 IORING_OFF_CQ_RING);
+    if (_cq_ring == MAP_FAILED) return false;
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(
+        nullptr,
+        _sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        _fd,
+        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(_sq_ring);
+    _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(_cq_ring);
+    _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  int _fd;
+  io_uring_enter_fn _enter;
+  unsigned _queued = 0;
+  void* _sq_ring = MAP_FAILED;
+  size_t _sq_ring_size = 0;
+  void* _cq_ring = MAP_FAILED;
+  size_t _cq_ring_size = 0;
+  io_uring_sqe* _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t _sqes_size = 0;
+  unsigned* _sq_head = nullptr;
+  unsigned* _sq_tail = nullptr;
+  unsigned* _sq_mask = nullptr;
+  unsigned* _sq_array = nullptr;
+  unsigned* _cq_head = nullptr;
+  unsigned* _cq_tail = nullptr;
+  unsigned* _cq_mask = nullptr;
+  io_uring_cqe* _cqes = nullptr;
+};
+
+bool probe_io_uring() {
+  std::unique_ptr<io_ring> ring = io_ring::create(2);
+  if (!ring) return false;
+
+  constexpr unsigned PROBE_OPS = 256;
+  std::vector<char> buffer(
+      sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op));
+  auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+  if (io_uring_register(
+          ring->fd(), IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0) {
+    return false;
+  }
+  for (unsigned op :
+       {IORING_OP_OPENAT,
+        IORING_OP_STATX,
+        IORING_OP_READ,
+        IORING_OP_WRITE,
+        IORING_OP_CLOSE}) {
+    if (op > probe->last_op ||
+        !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool use_io_uring(io_backend backend, size_t file_count) {
+  switch (backend) {
+    case io_backend::io_uring:
+      return true;
+    case io_backend::thread_pool:
+      return false;
+    case io_backend::automatic:
+      // Setting up a ring costs more than it saves for a single file.
+      return file_count > 1 && io_uring_available();
+  }
+  return false;
+}
+
+void queue_close(io_ring& ring, int fd, uint64_t user_data) {
+  io_uring_sqe& sqe = ring.next_sqe();
+  sqe.opcode = IORING_OP_CLOSE;
+  sqe.fd = fd;
+  sqe.user_data = user_data;
+}
+
+struct read_state {
+  int fd = -1;
+  bool failed = false;
+  size_t size = 0;
+  size_t done = 0;
+  struct statx stat;
+};
+
+// Reads one batch of at most IO_BATCH_SIZE files with three rounds of
+// submissions: open and statx, read (repeated for short reads), and close.
+bool read_batch_io_uring(
+    io_ring& ring,
+    std::span<const fs::path> paths,
+    std::span<std::optional<std::string>> contents) {
+  std::vector<read_state> files(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    io_uring_sqe& open = ring.next_sqe();
+    open.opcode = IORING_OP_OPENAT;
+    open.fd = AT_FDCWD;
+    open.addr = reinterpret_cast<uint64_t>(paths[i].c_str());
+    open.open_flags = O_RDONLY | O_CLOEXEC;
+    open.user_data = i << 1;
+
+    io_uring_sqe& stat = ring.next_sqe();
+    stat.opcode = IORING_OP_STATX;
+    stat.fd = AT_FDCWD;
+    stat.addr = reinterpret_cast<uint64_t>(paths[i].c_str());
+    stat.len = STATX_SIZE;
+    stat.off = reinterpret_cast<uint64_t>(&files[i].stat);
+    stat.user_data = (i << 1) | 1;
+  }
+  bool submitted = ring.submit_and_wait([&](uint64_t user_data, int result) {
+    read_state& file = files[user_data >> 1];
+    if (result < 0) {
+      file.failed = true;
+    } else if (!(user_data & 1)) {
+      file.fd = result;
+    }
+  });
+  // If the ring fails part way, close whatever is open so the caller can
+  // retry the batch without it.
+  auto abandon = [&]() {
+    for (const read_state& file : files) {
+      if (file.fd >= 0) ::close(file.fd);
+    }
+    return false;
+  };
+  if (!submitted) return abandon();
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (files[i].failed) continue;
+    files[i].size = files[i].stat.stx_size;
+    contents[i].emplace(files[i].size, '\0');
+  }
+
+  auto unfinished = [&](const read_state& file) {
+    return !file.failed && file.done < file.size;
+  };
+  while (std::ranges::any_of(files, unfinished)) {
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (!unfinished(files[i])) continue;
+      io_uring_sqe& read = ring.next_sqe();
+      read.opcode = IORING_OP_READ;
+      read.fd = files[i].fd;
+      read.addr =
+          reinterpret_cast<uint64_t>(contents[i]->data() + files[i].done);
+      read.len = files[i].size - files[i].done;
+      read.off = files[i].done;
+      read.user_data = i;
+    }
+    submitted = ring.submit_and_wait([&](uint64_t user_data, int result) {
+      read_state& file = files[user_data];
+      if (result < 0) {
+        file.failed = true;
+      } else if (result == 0) {
+        // The file shrank after statx; keep what was there.
+        file.size = file.done;
+        contents[user_data]->resize(file.done);
+      } else {
+        file.done += result;
+      }
+    });
+    if (!submitted) return abandon();
+  }
+
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (files[i].fd >= 0) queue_close(ring, files[i].fd, i);
+    if (files[i].failed) contents[i].reset();
+  }
+  // A descriptor is gone once its close completes, even if the close failed,
+  // so abandon() only closes the ones the kernel never got to.
+  submitted = ring.submit_and_wait(
+      [&](uint64_t user_data, int) { files[user_data].fd = -1; });
+  if (!submitted) return abandon();
+  return true;
+}
+
+struct write_state {
+  int fd = -1;
+  bool failed = false;
+  size_t done = 0;
+};
+
+// Writes one batch of at most IO_BATCH_SIZE files with three rounds of
+// submissions: open, write (repeated for short writes), and close.
+bool write_batch_io_uring(
+    io_ring& ring,
+    std::span<const std::pair<fs::path, std::string>> files,
+    std::vector<fs::path>& failed_paths) {
+  std::vector<write_state> states(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    io_uring_sqe& open = ring.next_sqe();
+    open.opcode = IORING_OP_OPENAT;
+    open.fd = AT_FDCWD;
+    open.addr = reinterpret_cast<uint64_t>(files[i].first.c_str());
+    open.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    open.len = NEW_FILE_MODE;
+    open.user_data = i;
+  }
+  bool submitted = ring.submit_and_wait([&](uint64_t user_data, int result) {
+    if (result < 0) {
+      states[user_data].failed = true;
+    } else {
+      states[user_data].fd = result;
+    }
+  });
+  auto abandon = [&]() {
+    for (const write_state& state : states) {
+      if (state.fd >= 0) ::close(state.fd);
+    }
+    return false;
+  };
+  if (!submitted) return abandon();
+
+  auto unfinished = [&](size_t i) {
+    return !states[i].failed && states[i].done < files[i].second.size();
+  };
+  auto any_unfinished = [&]() {
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (unfinished(i)) return true;
+    }
+    return false;
+  };
+  while (any_unfinished()) {
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (!unfinished(i)) continue;
+      const std::string& data = files[i].second;
+      io_uring_sqe& write = ring.next_sqe();
+      write.opcode = IORING_OP_WRITE;
+      write.fd = states[i].fd;
+      write.addr = reinterpret_cast<uint64_t>(data.data() + states[i].done);
+      write.len = data.size() - states[i].done;
+      write.off = states[i].done;
+      write.user_data = i;
+    }
+    submitted = ring.submit_and_wait([&](uint64_t user_data, int result) {
+      if (result <= 0) {
+        states[user_data].failed = true;
+      } else {
+        states[user_data].done += result;
+      }
+    });
+    if (!submitted) return abandon();
+  }
+
+  for (size_t i = 0; i < states.size(); ++i) {
+    if (states[i].fd >= 0) queue_close(ring, states[i].fd, i);
+  }
+  submitted = ring.submit_and_wait([&](uint64_t user_data, int result) {
+    states[user_data].fd = -1;
+    if (result < 0) states[user_data].failed = true;
+  });
+  if (!submitted) return abandon();
+
+  for (size_t i = 0; i < states.size(); ++i) {
+    if (states[i].failed) failed_paths.push_back(files[i].first);
+  }
+  return true;
+}
+
+std::optional<std::string> read_file_blocking(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::nullopt;
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    return std::nullopt;
+  }
+  std::string contents(file_stat.st_size, '\0');
+  size_t done = 0;
+  while (done < contents.size()) {
+    ssize_t result =
+        ::read(fd, contents.data() + done, contents.size() - done);
+    if (result < 0 && errno == EINTR) continue;
+    if (result < 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+    if (result == 0) {
+      contents.resize(done);
+      break;
+    }
+    done += result;
+  }
+  ::close(fd);
+  return contents;
+}
+
+bool write_file_blocking(const fs::path& path, const std::string& contents) {
+  int fd = ::open(
+      path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, NEW_FILE_MODE);
+  if (fd < 0) return false;
+  size_t done = 0;
+  while (done < contents.size()) {
+    ssize_t result =
+        ::write(fd, contents.data() + done, contents.size() - done);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) {
+      ::close(fd);
+      return false;
+    }
+    done += result;
+  }
+  return ::close(fd) == 0;
+}
+
+int io_thread_count() {
+  return std::max(1u, std::thread::hardware_concurrency()) *
+      IO_THREADS_PER_CORE;
+}
+
+} // namespace
+
+bool io_uring_available() {
+  static const bool available = probe_io_uring();
+  return available;
+}
+
+std::vector<std::optional<std::string>>
+read_files(std::span<const fs::path> paths, io_backend backend) {
+  return read_files(paths, backend, io_uring_enter);
+}
+
+std::vector<std::optional<std::string>> read_files(
+    std::span<const fs::path> paths,
+    io_backend backend,
+    io_uring_enter_fn enter) {
+  std::vector<std::optional<std::string>> contents(paths.size());
+  std::unique_ptr<io_ring> ring;
+  if (use_io_uring(backend, paths.size())) {
+    ring = io_ring::create(RING_ENTRIES, enter);
+  }
+  if (ring) {
+    for (size_t begin = 0; begin < paths.size(); begin += IO_BATCH_SIZE) {
+      size_t size = std::min(IO_BATCH_SIZE, paths.size() - begin);
+      std::span<std::optional<std::string>> batch_contents{
+          contents.data() + begin, size};
+      if (!read_batch_io_uring(
+              *ring, paths.subspan(begin, size), batch_contents)) {
+        // The ring is unusable; finish the remaining files without it.
+        ring.reset();
+        for (size_t i = begin; i < paths.size(); ++i) contents[i].reset();
+        parallel_for(paths.size() - begin, io_thread_count(), [&](size_t i) {
+          contents[begin + i] = read_file_blocking(paths[begin + i]);
+        });
+        break;
+      }
+    }
+    return contents;
+  }
+
+  parallel_for(paths.size(), io_thread_count(), [&](size_t i) {
+    contents[i] = read_file_blocking(paths[i]);
+  });
+  return contents;
+}
+
+std::vector<fs::path> write_files(
+    std::span<const std::pair<fs::path, std::string>> files,
+    io_backend backend) {
+  return write_files(files, backend, io_uring_enter);
+}
+
+std::vector<fs::path> write_files(
+    std::span<const std::pair<fs::path, std::string>> files,
+    io_backend backend,
+    io_uring_enter_fn enter) {
+  std::vector<fs::path> failed_paths;
+  std::unique_ptr<io_ring> ring;
+  if (use_io_uring(backend, files.size())) {
+    ring = io_ring::create(RING_ENTRIES, enter);
+  }
+  size_t begin = 0;
+  if (ring) {
+    for (; begin < files.size(); begin += IO_BATCH_SIZE) {
+      size_t size = std::min(IO_BATCH_SIZE, files.size() - begin);
+      if (!write_batch_io_uring(
+              *ring, files.subspan(begin, size), failed_paths)) {
+        break;
+      }
+    }
+  }
+  if (begin >= files.size()) return failed_paths;
+
+  std::span<const std::pair<fs::path, std::string>> remaining =
+      files.subspan(begin);
+  std::vector<char> failed(remaining.size());
+  parallel_for(remaining.size(), io_thread_count(), [&](size_t i) {
+    failed[i] = !write_file_blocking(remaining[i].first, remaining[i].second);
+  });
+  for (size_t i = 0; i < remaining.size(); ++i) {
+    if (failed[i]) failed_paths.push_back(remaining[i].first);
+  }
+  return failed_paths;
+}
+
+void parallel_for(
+    size_t count, int thread_count, const std::function<void(size_t)>& fn) {
+  if (thread_count <= 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t chunk_count =
+      std::clamp<size_t>(thread_count, 1, std::max<size_t>(count, 1));
+  if (chunk_count == 1) {
+    for (size_t i = 0; i < count; ++i) fn(i);
+    return;
+  }
+
+  size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+  std::vector<std::jthread> workers;
+  workers.reserve(chunk_count);
+  for (size_t begin = 0; begin < count; begin += chunk_size) {
+    size_t end = std::min(begin + chunk_size, count);
+    workers.emplace_back([&fn, begin, end]() {
+      for (size_t i = begin; i < end; ++i) fn(i);
+    });
+  }
+}
+
+} // namespace f1_predict
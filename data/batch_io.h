@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace f1_predict {
+
+// Batched whole-file I/O for trees of many small files.
+//
+// On Linux the io_uring backend submits the opens, reads or writes, and closes
+// for up to IO_BATCH_SIZE files at a time, so a batch costs a handful of
+// system calls instead of several per file. When io_uring is unavailable the
+// thread pool backend does the same work with blocking calls spread across
+// threads.
+enum class io_backend {
+  // io_uring when the kernel supports it, otherwise the thread pool.
+  automatic,
+  io_uring,
+  thread_pool,
+};
+
+inline constexpr size_t IO_BATCH_SIZE = 256;
+
+// Returns whether the running kernel supports everything the io_uring backend
+// needs.
+bool io_uring_available();
+
+// Reads each file in full. Files that cannot be read come back as nullopt.
+std::vector<std::optional<std::string>> read_files(
+    std::span<const std::filesystem::path> paths,
+    io_backend backend = io_backend::automatic);
+
+// Writes each file, replacing any existing contents. Returns the paths that
+// could not be written.
+std::vector<std::filesystem::path> write_files(
+    std::span<const std::pair<std::filesystem::path, std::string>> files,
+    io_backend backend = io_backend::automatic);
+
+// Calls `fn` with every index in [0, count), splitting the range into
+// contiguous chunks run on up to `thread_count` threads. A thread count of 0
+// means one per core.
+void parallel_for(
+    size_t count, int thread_count, const std::function<void(size_t)>& fn);
+
+} // namespace f1_predict
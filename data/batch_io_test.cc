@@ -0,0 +1,165 @@
+#include "data/batch_io.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data/batch_io_testing.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+class BatchIoTest : public ::testing::TestWithParam<io_backend> {
+protected:
+  void SetUp() override {
+    if (GetParam() == io_backend::io_uring && !io_uring_available()) {
+      GTEST_SKIP() << "io_uring is not available.";
+    }
+    _dir = fs::path{::testing::TempDir()} / "batch_io_test";
+    fs::remove_all(_dir);
+    fs::create_directories(_dir);
+  }
+
+  // More files than fit in one batch, of varying sizes including empty.
+  std::vector<std::pair<fs::path, std::string>> make_files() const {
+    std::vector<std::pair<fs::path, std::string>> files;
+    for (size_t i = 0; i < IO_BATCH_SIZE + 10; ++i) {
+      files.emplace_back(
+          _dir / ("file_" + std::to_string(i)),
+          std::string(i * 31, static_cast<char>('a' + i % 26)));
+    }
+    return files;
+  }
+
+  fs::path _dir;
+};
+
+std::string read_back(const fs::path& path) {
+  std::ifstream stream(path, std::ios::binary);
+  std::stringstream data;
+  data << stream.rdbuf();
+  return std::move(data).str();
+}
+
+TEST_P(BatchIoTest, WritesAndReadsFiles) {
+  std::vector<std::pair<fs::path, std::string>> files = make_files();
+  EXPECT_TRUE(write_files(files, GetParam()).empty());
+
+  std::vector<fs::path> paths;
+  for (const auto& [path, contents] : files) {
+    EXPECT_EQ(read_back(path), contents);
+    paths.push_back(path);
+  }
+  std::vector<std::optional<std::string>> contents =
+      read_files(paths, GetParam());
+  ASSERT_EQ(contents.size(), files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    ASSERT_TRUE(contents[i].has_value()) << paths[i];
+    EXPECT_EQ(*contents[i], files[i].second) << paths[i];
+  }
+}
+
+TEST_P(BatchIoTest, ReplacesExistingContents) {
+  std::vector<std::pair<fs::path, std::string>> files = {
+      {_dir / "replaced", "a much longer original file"}};
+  ASSERT_TRUE(write_files(files, GetParam()).empty());
+  files.front().second = "short";
+  ASSERT_TRUE(write_files(files, GetParam()).empty());
+  EXPECT_EQ(read_back(files.front().first), "short");
+}
+
+TEST_P(BatchIoTest, ReportsMissingFiles) {
+  std::vector<fs::path> paths = {_dir / "missing", _dir / "present"};
+  std::ofstream{paths[1]} << "present";
+
+  std::vector<std::optional<std::string>> contents =
+      read_files(paths, GetParam());
+  ASSERT_EQ(contents.size(), 2);
+  EXPECT_FALSE(contents[0].has_value());
+  EXPECT_EQ(contents[1], "present");
+
+  std::vector<std::pair<fs::path, std::string>> files = {
+      {_dir / "missing_dir" / "file", "contents"}, {_dir / "written", "ok"}};
+  EXPECT_EQ(
+      write_files(files, GetParam()), std::vector<fs::path>{files[0].first});
+  EXPECT_EQ(read_back(files[1].first), "ok");
+}
+
+// The number of io_uring_enter calls that submit entries to let through before
+// one fails. Negative for none.
+int submits_until_failure = -1;
+
+// Fails like io_uring_enter can after the kernel has taken some entries: the
+// entries are submitted, but the call reports EAGAIN.
+int failing_io_uring_enter(
+    int ring_fd, unsigned to_submit, unsigned min_complete) {
+  if (to_submit > 0 && submits_until_failure >= 0 &&
+      submits_until_failure-- == 0) {
+    io_uring_enter(ring_fd, to_submit, 0);
+    errno = EAGAIN;
+    return -1;
+  }
+  return io_uring_enter(ring_fd, to_submit, min_complete);
+}
+
+size_t open_fd_count() {
+  return std::distance(
+      fs::directory_iterator{"/proc/self/fd"}, fs::directory_iterator{});
+}
+
+// Fails each round of submissions in turn after the kernel has taken its
+// entries, which must neither leave descriptors open nor let a late operation
+// overwrite the blocking retry.
+TEST_P(BatchIoTest, FallsBackWhenSubmissionFails) {
+  if (GetParam() != io_backend::io_uring) GTEST_SKIP();
+  std::vector<std::pair<fs::path, std::string>> files = make_files();
+  std::vector<fs::path> paths;
+  for (const auto& [path, contents] : files) paths.push_back(path);
+  size_t fd_count = open_fd_count();
+
+  for (int call = 0; call < 6; ++call) {
+    for (auto& [path, contents] : files) {
+      if (!contents.empty()) contents.front() ^= 1;
+    }
+    submits_until_failure = call;
+    EXPECT_TRUE(write_files(files, GetParam(), failing_io_uring_enter).empty())
+        << call;
+    submits_until_failure = call;
+    std::vector<std::optional<std::string>> contents =
+        read_files(paths, GetParam(), failing_io_uring_enter);
+    submits_until_failure = -1;
+
+    ASSERT_EQ(contents.size(), files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+      if (files[i].second.empty()) continue;
+      EXPECT_EQ(read_back(paths[i]), files[i].second) << call << paths[i];
+      EXPECT_EQ(contents[i], files[i].second) << call << paths[i];
+    }
+    EXPECT_EQ(open_fd_count(), fd_count) << call;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Backends,
+    BatchIoTest,
+    ::testing::Values(io_backend::io_uring, io_backend::thread_pool));
+
+TEST(ParallelForTest, VisitsEveryIndexOnce) {
+  std::vector<std::atomic<int>> visits(1000);
+  parallel_for(visits.size(), 4, [&](size_t i) { ++visits[i]; });
+  for (const std::atomic<int>& count : visits) EXPECT_EQ(count, 1);
+}
+
+} // namespace
+} // namespace f1_predict
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data/batch_io.h"
+
+namespace f1_predict {
+
+// Hooks for testing how the io_uring backend handles a failing kernel.
+
+// Calls io_uring_enter with IORING_ENTER_GETEVENTS, as the backend does.
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete);
+
+using io_uring_enter_fn =
+    int (*)(int ring_fd, unsigned to_submit, unsigned min_complete);
+
+// Like read_files and write_files, but with `enter` called in place of
+// io_uring_enter.
+std::vector<std::optional<std::string>> read_files(
+    std::span<const std::filesystem::path> paths,
+    io_backend backend,
+    io_uring_enter_fn enter);
+std::vector<std::filesystem::path> write_files(
+    std::span<const std::pair<std::filesystem::path, std::string>> files,
+    io_backend backend,
+    io_uring_enter_fn enter);
+
+} // namespace f1_predict
@@ -0,0 +1,22 @@
+#include "data/checksum.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace f1_predict {
+namespace {
+
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+} // namespace
+
+uint64_t fnv1a_hash(std::string_view data, uint64_t seed) {
+  uint64_t hash = seed;
+  for (char c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+} // namespace f1_predict
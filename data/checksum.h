@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace f1_predict {
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+// Computes the 64-bit FNV-1a hash of the given bytes. Pass the result of a
+// previous call as `seed` to hash data in multiple pieces.
+uint64_t fnv1a_hash(std::string_view data, uint64_t seed = FNV_OFFSET_BASIS);
+
+} // namespace f1_predict
@@ -1,57 +1,463 @@
 #include "data/csv.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <istream>
-#include <sstream>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include "strings/trim.h"
+#include "data/batch_io.h"
+#include "strings/simd.h"
 
 namespace f1_predict {
 namespace {
 
+namespace fs = ::std::filesystem;
+
 constexpr char DELIM = ',';
 
-std::vector<std::string> readline(std::istream& input) {
-  std::vector<std::string> row;
-  row.emplace_back();
-  char c;
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+      c == '\r';
+}
+
+// Splits a row containing quotes or backslashes. See split_row.
+bool split_escaped_row(
+    std::string_view text,
+    size_t& position,
+    std::vector<std::string_view>& cells,
+    std::deque<std::string>& unescaped_cells) {
+  size_t row_start = cells.size();
+  size_t cell_begin = position;
+  // Cells without quotes or escapes stay views into the text. The others are
+  // copied into `unescaped` from their first quote or backslash on.
+  bool plain = true;
+  std::string unescaped;
   bool in_quotes = false;
-  while (input.get(c)) {
-    if (!in_quotes && c == ',') {
-      row.emplace_back();
+  auto end_cell = [&] {
+    std::string_view cell = text.substr(cell_begin, position - cell_begin);
+    if (!plain) cell = unescaped_cells.emplace_back(std::move(unescaped));
+    cells.push_back(cell);
+    plain = true;
+    unescaped.clear();
+  };
+  auto start_escaping = [&] {
+    if (!plain) return;
+    unescaped.assign(text.substr(cell_begin, position - cell_begin));
+    plain = false;
+  };
+
+  bool row_empty = true;
+  while (position < text.size()) {
+    char c = text[position];
+    if (!in_quotes && c == DELIM) {
+      end_cell();
+      cell_begin = ++position;
+      row_empty = false;
       continue;
     }
     if (c == '"') {
+      start_escaping();
       in_quotes = !in_quotes;
+      ++position;
       continue;
     }
     if (c == '\n') break;
-    if (c == '\\') input >> c;
-    row.back().push_back(c);
+    row_empty = false;
+    if (c == '\\') {
+      start_escaping();
+      ++position;
+      while (position < text.size() && is_space(text[position])) {
+        ++position;
+      }
+      if (position < text.size()) c = text[position++];
+      unescaped.push_back(c);
+      continue;
+    }
+    ++position;
+    if (!plain) unescaped.push_back(c);
+  }
+  end_cell();
+  if (position < text.size()) ++position;
+
+  if (row_empty) {
+    cells.resize(row_start);
+    return false;
+  }
+  return true;
+}
+
+// Appends the untrimmed cells of the row starting at `position` to `cells`,
+// advancing `position` past the row. Cells that needed unescaping are stored
+// in `unescaped_cells`. Returns false, adding no cells, if the row is empty.
+bool split_row(
+    std::string_view text,
+    size_t& position,
+    std::vector<std::string_view>& cells,
+    std::deque<std::string>& unescaped_cells) {
+  size_t line_end = text.find('\n', position);
+  if (line_end == std::string_view::npos) line_end = text.size();
+  std::string_view line = text.substr(position, line_end - position);
+  if (line.empty()) return false;
+
+  if (std::memchr(line.data(), '"', line.size()) != nullptr ||
+      std::memchr(line.data(), '\\', line.size()) != nullptr) {
+    return split_escaped_row(text, position, cells, unescaped_cells);
+  }
+  while (true) {
+    size_t comma = line.find(DELIM);
+    std::string_view cell = line.substr(0, comma);
+    cells.push_back(cell);
+    if (comma == std::string_view::npos) break;
+    line.remove_prefix(comma + 1);
+  }
+  position = line_end + 1;
+  return true;
+}
+
+// Like split_row, but trims the row's cells if `trim_whitespace` is set. The
+// whole row is trimmed in one batch, which is faster than a cell at a time.
+bool read_row(
+    std::string_view text,
+    size_t& position,
+    bool trim_whitespace,
+    std::vector<std::string_view>& cells,
+    std::deque<std::string>& unescaped_cells) {
+  size_t row_start = cells.size();
+  if (!split_row(text, position, cells, unescaped_cells)) return false;
+  if (trim_whitespace) trim_cells(std::span{cells}.subspan(row_start));
+  return true;
+}
+
+// Returns the position just past the end of the row starting at `position`,
+// or npos if the row does not end within `text`. Rows end at a newline unless
+// it is skipped by a backslash escape.
+size_t find_row_end(std::string_view text, size_t position) {
+  while (true) {
+    size_t line_end = text.find('\n', position);
+    if (line_end == std::string_view::npos) return line_end;
+    const void* backslash_ptr =
+        std::memchr(text.data() + position, '\\', line_end - position);
+    if (backslash_ptr == nullptr) return line_end + 1;
+    size_t backslash = static_cast<const char*>(backslash_ptr) - text.data();
+    // The escape skips any whitespace after the backslash, newlines included,
+    // and then takes the next character literally.
+    position = backslash + 1;
+    while (position < text.size() && is_space(text[position])) ++position;
+    if (position == text.size()) return std::string_view::npos;
+    ++position;
+  }
+}
+
+// Rows parsed from part of a csv_reader block.
+struct parsed_rows {
+  std::vector<std::string_view> cells;
+  std::deque<std::string> unescaped;
+  // Index into cells of each row's first cell, plus one past the last row.
+  std::vector<size_t> row_starts = {0};
+  // Whether an empty row ended the file within these rows.
+  bool ended = false;
+};
+
+// Parses the rows from `position` to each of `row_ends` in turn.
+void parse_rows(
+    std::string_view text,
+    size_t position,
+    std::span<const size_t> row_ends,
+    parsed_rows& rows) {
+  for (size_t row_end : row_ends) {
+    if (!read_row(text, position, true, rows.cells, rows.unescaped)) {
+      rows.ended = true;
+      return;
+    }
+    rows.row_starts.push_back(rows.cells.size());
+    position = row_end;
+  }
+}
+
+template <typename Name>
+std::optional<size_t>
+find_column(std::span<const Name> names, std::string_view name) {
+  for (size_t i = names.size(); i > 0; --i) {
+    if (names[i - 1] == name) return i - 1;
   }
-  if (row.size() == 1 && row.front() == "") return {};
-  return row;
+  return std::nullopt;
 }
 
 } // namespace
 
-std::vector<std::unordered_map<std::string, std::string>>
-load_csv(std::istream& input) {
-  std::vector<std::string> column_names = readline(input);
-  if (column_names.empty()) {
+std::optional<csv_file> csv_file::open(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << path << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    std::cerr << "Failed to read " << path << std::endl;
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  csv_file file;
+  if (file_stat.st_size > 0) {
+    void* data =
+        ::mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      std::cerr << "Failed to map " << path << std::endl;
+      ::close(fd);
+      return std::nullopt;
+    }
+    ::madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+    file._data = data;
+    file._size = file_stat.st_size;
+    file._text = {static_cast<const char*>(data), file._size};
+  }
+  ::close(fd);
+  if (!file.parse_text()) {
+    std::cerr << "CSV file " << path << " is empty." << std::endl;
+    return std::nullopt;
+  }
+  return file;
+}
+
+std::optional<csv_file> csv_file::parse(std::string contents) {
+  csv_file file;
+  file._contents = std::make_unique<std::string>(std::move(contents));
+  file._text = *file._contents;
+  if (!file.parse_text()) {
     std::cerr << "Input is empty." << std::endl;
-    std::exit(1);
+    return std::nullopt;
+  }
+  return file;
+}
+
+csv_file::csv_file(csv_file&& other) noexcept
+    : _data{std::exchange(other._data, nullptr)},
+      _size{std::exchange(other._size, 0)},
+      _contents{std::move(other._contents)},
+      _text{std::exchange(other._text, {})},
+      _unescaped{std::move(other._unescaped)},
+      _header_size{std::exchange(other._header_size, 0)},
+      _cells{std::move(other._cells)},
+      _row_starts{std::move(other._row_starts)} {}
+
+csv_file& csv_file::operator=(csv_file&& other) noexcept {
+  if (this != &other) {
+    release();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _contents = std::move(other._contents);
+    _text = std::exchange(other._text, {});
+    _unescaped = std::move(other._unescaped);
+    _header_size = std::exchange(other._header_size, 0);
+    _cells = std::move(other._cells);
+    _row_starts = std::move(other._row_starts);
+  }
+  return *this;
+}
+
+csv_file::~csv_file() { release(); }
+
+void csv_file::release() {
+  if (_data) ::munmap(_data, _size);
+  _data = nullptr;
+}
+
+std::optional<size_t> csv_file::column(std::string_view name) const {
+  return find_column(column_names(), name);
+}
+
+bool csv_file::find_columns(
+    std::initializer_list<std::pair<std::string_view, size_t*>> columns)
+    const {
+  for (const auto& [name, index] : columns) {
+    std::optional<size_t> found = column(name);
+    if (!found) return false;
+    *index = *found;
+  }
+  return true;
+}
+
+bool csv_file::parse_text() {
+  _row_starts = {0};
+  size_t position = 0;
+  // Header names are kept untrimmed. Parsing stops at the first empty row.
+  for (bool header = true; position < _text.size(); header = false) {
+    if (!read_row(_text, position, !header, _cells, _unescaped)) break;
+    if (header) {
+      _header_size = _cells.size();
+      _row_starts = {_header_size};
+    } else {
+      _row_starts.push_back(_cells.size());
+    }
+  }
+  return _header_size > 0;
+}
+
+csv_reader::csv_reader(std::ifstream input, csv_read_options options)
+    : _input{std::move(input)}, _options{options} {}
+
+std::optional<csv_reader>
+csv_reader::open(const fs::path& path, csv_read_options options) {
+  std::ifstream input{path, std::ios::binary};
+  if (!input) {
+    std::cerr << "Failed to open " << path << std::endl;
+    return std::nullopt;
+  }
+  csv_reader reader{std::move(input), options};
+
+  size_t header_end = std::string_view::npos;
+  while (true) {
+    header_end = find_row_end(reader._buffer, 0);
+    if (header_end != std::string_view::npos || !reader.fill_buffer()) break;
+  }
+  if (header_end == std::string_view::npos) header_end = reader._buffer.size();
+
+  // Header names are kept untrimmed.
+  std::vector<std::string_view> cells;
+  std::deque<std::string> unescaped;
+  size_t position = 0;
+  if (!read_row(reader._buffer, position, false, cells, unescaped)) {
+    std::cerr << "CSV file " << path << " is empty." << std::endl;
+    return std::nullopt;
+  }
+  reader._column_names.assign(cells.begin(), cells.end());
+  reader._position = header_end;
+  return reader;
+}
+
+std::optional<size_t> csv_reader::column(std::string_view name) const {
+  return find_column(column_names(), name);
+}
+
+bool csv_reader::fill_buffer() {
+  _buffer.erase(0, _position);
+  _position = 0;
+  size_t size = _buffer.size();
+  _buffer.resize(size + _options.block_size);
+  _input.read(_buffer.data() + size, _options.block_size);
+  _buffer.resize(size + _input.gcount());
+  return _input.gcount() > 0;
+}
+
+size_t
+csv_reader::for_each_row(const std::function<void(const csv_row&)>& fn) {
+  int thread_count = _options.thread_count;
+  if (thread_count <= 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
   }
 
+  size_t row_count = 0;
+  std::vector<size_t> row_ends;
+  while (!_done) {
+    bool at_end = !fill_buffer();
+    std::string_view text = _buffer;
+
+    // Finding where rows end is a quick scan. Splitting them into cells is
+    // the expensive part, and is spread across threads.
+    row_ends.clear();
+    for (size_t position = _position; position < text.size();) {
+      size_t row_end = find_row_end(text, position);
+      if (row_end == std::string_view::npos) {
+        if (!at_end) break;
+        row_end = text.size();
+      }
+      row_ends.push_back(row_end);
+      position = row_end;
+    }
+
+    size_t chunk_count = std::clamp<size_t>(
+        thread_count, 1, std::max<size_t>(row_ends.size(), 1));
+    size_t chunk_size = (row_ends.size() + chunk_count - 1) / chunk_count;
+    std::vector<parsed_rows> chunks(chunk_count);
+    parallel_for(chunk_count, chunk_count, [&](size_t i) {
+      size_t begin = std::min(i * chunk_size, row_ends.size());
+      size_t end = std::min(begin + chunk_size, row_ends.size());
+      size_t position = begin == 0 ? _position : row_ends[begin - 1];
+      parse_rows(
+          text,
+          position,
+          std::span{row_ends}.subspan(begin, end - begin),
+          chunks[i]);
+    });
+    if (!row_ends.empty()) _position = row_ends.back();
+
+    for (const parsed_rows& rows : chunks) {
+      for (size_t i = 0; i + 1 < rows.row_starts.size(); ++i) {
+        fn(csv_row{std::span{rows.cells}.subspan(
+            rows.row_starts[i], rows.row_starts[i + 1] - rows.row_starts[i])});
+        ++row_count;
+      }
+      if (rows.ended) {
+        _done = true;
+        break;
+      }
+    }
+    if (at_end) _done = true;
+  }
+  return row_count;
+}
+
+void save_csv_file(
+    const fs::path& path,
+    std::initializer_list<std::string_view> column_names,
+    const std::function<void(std::ostream&)>& write_rows) {
+  fs::path temp_path = path;
+  temp_path += ".tmp";
+  {
+    std::ofstream out{temp_path, std::ios::trunc};
+    const char* separator = "";
+    for (std::string_view name : column_names) {
+      out << std::exchange(separator, ",") << name;
+    }
+    out << '\n';
+    write_rows(out);
+    out.close();
+    if (!out) {
+      std::cerr << "Failed to write " << temp_path << std::endl;
+      std::exit(1);
+    }
+  }
+  fs::rename(temp_path, path);
+}
+
+std::vector<std::unordered_map<std::string, std::string>>
+load_csv(std::istream& input) {
+  std::optional<csv_file> file = csv_file::parse(
+      std::string{std::istreambuf_iterator<char>{input}, {}});
+  if (!file) std::exit(1);
+
+  std::span<const std::string_view> column_names = file->column_names();
   std::vector<std::unordered_map<std::string, std::string>> content;
-  for (std::vector<std::string> line; line = readline(input), !line.empty();) {
-    auto& row = content.emplace_back();
-    for (int i = 0; i < line.size(); ++i) {
-      row[column_names[i]] = trim(line[i]);
+  content.reserve(file->size());
+  for (size_t i = 0; i < file->size(); ++i) {
+    csv_row row = (*file)[i];
+    auto& cells = content.emplace_back();
+    for (size_t j = 0; j < row.size() && j < column_names.size(); ++j) {
+      cells[std::string{column_names[j]}] = row[j];
     }
   }
   return content;
@@ -1,12 +1,156 @@
 #pragma once
 
+#include <charconv>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
 #include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace f1_predict {
 
+// One row of a csv_file. Cells are addressed by column index, and missing
+// trailing cells read as empty.
+class csv_row {
+public:
+  explicit csv_row(std::span<const std::string_view> cells) : _cells{cells} {}
+
+  size_t size() const { return _cells.size(); }
+  bool has(size_t column) const { return column < _cells.size(); }
+  std::string_view operator[](size_t column) const {
+    return has(column) ? _cells[column] : std::string_view{};
+  }
+
+private:
+  std::span<const std::string_view> _cells;
+};
+
+// A parsed CSV file, mapped into memory. Cells are trimmed views into the
+// file, except for cells with quotes or backslash escapes, which are unescaped
+// into storage owned by the csv_file. The file ends at its first empty line.
+class csv_file {
+public:
+  // Maps and parses the file at `path`. Returns nullopt and prints the reason
+  // to stderr if it cannot be read or has no header.
+  static std::optional<csv_file> open(const std::filesystem::path& path);
+  // Parses CSV text held in memory.
+  static std::optional<csv_file> parse(std::string contents);
+
+  csv_file(const csv_file&) = delete;
+  csv_file& operator=(const csv_file&) = delete;
+  csv_file(csv_file&& other) noexcept;
+  csv_file& operator=(csv_file&& other) noexcept;
+  ~csv_file();
+
+  std::span<const std::string_view> column_names() const {
+    return std::span{_cells}.first(_header_size);
+  }
+  // Returns the index of the last column with the given name.
+  std::optional<size_t> column(std::string_view name) const;
+  // Sets each index to that of the named column, as column() finds it.
+  // Returns false if any of the columns is missing.
+  bool find_columns(
+      std::initializer_list<std::pair<std::string_view, size_t*>> columns)
+      const;
+
+  size_t size() const { return _row_starts.size() - 1; }
+  bool empty() const { return size() == 0; }
+  csv_row operator[](size_t row) const {
+    return csv_row{std::span{_cells}.subspan(
+        _row_starts[row], _row_starts[row + 1] - _row_starts[row])};
+  }
+
+private:
+  csv_file() = default;
+
+  bool parse_text();
+  void release();
+
+  void* _data = nullptr;
+  size_t _size = 0;
+  std::unique_ptr<std::string> _contents;
+  std::string_view _text;
+  std::deque<std::string> _unescaped;
+  size_t _header_size = 0;
+  std::vector<std::string_view> _cells;
+  // Index into _cells of each row's first cell, plus one past the last row.
+  std::vector<size_t> _row_starts;
+};
+
+struct csv_read_options {
+  // Bytes read from the file at a time. A row longer than this grows the
+  // buffer until it fits.
+  size_t block_size = 1 << 20;
+  // Threads splitting the rows of each block into cells. A thread count of 0
+  // means one per core. Rows are always delivered in file order on the
+  // calling thread.
+  int thread_count = 1;
+};
+
+// Streams the rows of a CSV file through a fixed-size buffer, so memory use
+// does not grow with the size of the file. Rows are parsed the same way as by
+// csv_file.
+class csv_reader {
+public:
+  // Opens the file at `path` and reads its header. Returns nullopt and prints
+  // the reason to stderr if it cannot be read or has no header.
+  static std::optional<csv_reader>
+  open(const std::filesystem::path& path, csv_read_options options = {});
+
+  std::span<const std::string> column_names() const { return _column_names; }
+  // Returns the index of the last column with the given name.
+  std::optional<size_t> column(std::string_view name) const;
+
+  // Calls `fn` with each row after the header, in file order, up to the first
+  // empty row. A row and its cells are only valid during the call. Returns
+  // the number of rows read.
+  size_t for_each_row(const std::function<void(const csv_row&)>& fn);
+
+private:
+  csv_reader(std::ifstream input, csv_read_options options);
+
+  // Reads more of the file onto the end of the buffer. Returns false at the
+  // end of the file.
+  bool fill_buffer();
+
+  std::ifstream _input;
+  csv_read_options _options;
+  std::vector<std::string> _column_names;
+  std::string _buffer;
+  // Start of the unparsed part of the buffer.
+  size_t _position = 0;
+  bool _done = false;
+};
+
+// Parses the whole of a cell as an integer in the given base.
+template <typename Int>
+bool parse_csv_number(std::string_view text, Int& value, int base = 10) {
+  const char* end = text.data() + text.size();
+  auto [ptr, error] = std::from_chars(text.data(), end, value, base);
+  return error == std::errc{} && ptr == end;
+}
+
+// Writes a CSV file with the given header, then calls `write_rows` to write
+// the rows. The file is written beside `path` and renamed into place, so
+// readers never see it half written. Exits if it cannot be written.
+void save_csv_file(
+    const std::filesystem::path& path,
+    std::initializer_list<std::string_view> column_names,
+    const std::function<void(std::ostream&)>& write_rows);
+
+// Reads a whole CSV stream into one map per row, keyed by column name.
 std::vector<std::unordered_map<std::string, std::string>>
 load_csv(std::istream& input);
 
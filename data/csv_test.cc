@@ -0,0 +1,170 @@
+#include "data/csv.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "strings/trim.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+TEST(CsvFileTest, ReadsCellsByColumn) {
+  fs::path path = fs::path{::testing::TempDir()} / "csv_file_test.csv";
+  std::ofstream{path} << "raceId,name,time\n"
+                      << "1, Monaco Grand Prix ,1:12.345\n"
+                      << "2,\"Grand Prix, Bahrain\",\\N\n"
+                      << "3\n";
+
+  std::optional<csv_file> file = csv_file::open(path);
+  ASSERT_TRUE(file.has_value());
+  ASSERT_EQ(file->size(), 3);
+  std::optional<size_t> name = file->column("name");
+  ASSERT_TRUE(name.has_value());
+  EXPECT_FALSE(file->column("missing").has_value());
+
+  EXPECT_EQ((*file)[0][*name], "Monaco Grand Prix");
+  EXPECT_EQ((*file)[1][*name], "Grand Prix, Bahrain");
+  EXPECT_EQ((*file)[1][*file->column("time")], "N");
+  EXPECT_EQ((*file)[2].size(), 1);
+  EXPECT_FALSE((*file)[2].has(*name));
+  EXPECT_EQ((*file)[2][*name], "");
+}
+
+TEST(CsvFileTest, StopsAtEmptyLine) {
+  std::optional<csv_file> file = csv_file::parse("a,b\n1,2\n\n3,4\n");
+  ASSERT_TRUE(file.has_value());
+  EXPECT_EQ(file->size(), 1);
+  EXPECT_FALSE(csv_file::parse("\na,b\n").has_value());
+}
+
+TEST(CsvFileTest, FindsRequiredColumns) {
+  std::optional<csv_file> file = csv_file::parse("a,b,c\n1,2,3\n");
+  ASSERT_TRUE(file.has_value());
+  size_t a = 0;
+  size_t c = 0;
+  EXPECT_TRUE(file->find_columns({{"c", &c}, {"a", &a}}));
+  EXPECT_EQ(a, 0);
+  EXPECT_EQ(c, 2);
+  EXPECT_FALSE(file->find_columns({{"a", &a}, {"d", &c}}));
+}
+
+TEST(CsvFileTest, SavesAndParsesNumbers) {
+  fs::path path = fs::path{::testing::TempDir()} / "csv_save_test.csv";
+  save_csv_file(path, {"id", "hash"}, [](std::ostream& out) {
+    out << "7,00ff\n";
+  });
+  EXPECT_FALSE(fs::exists(fs::path{path} += ".tmp"));
+
+  std::optional<csv_file> file = csv_file::open(path);
+  ASSERT_TRUE(file.has_value());
+  ASSERT_EQ(file->size(), 1);
+  int id = 0;
+  uint64_t hash = 0;
+  EXPECT_TRUE(parse_csv_number((*file)[0][0], id));
+  EXPECT_TRUE(parse_csv_number((*file)[0][1], hash, 16));
+  EXPECT_EQ(id, 7);
+  EXPECT_EQ(hash, 0xff);
+  EXPECT_FALSE(parse_csv_number("7x", id));
+  EXPECT_FALSE(parse_csv_number("", id));
+}
+
+std::vector<std::vector<std::string>> read_rows(const csv_file& file) {
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0; i < file.size(); ++i) {
+    csv_row row = file[i];
+    rows.emplace_back(row.size());
+    for (size_t j = 0; j < row.size(); ++j) rows.back()[j] = row[j];
+  }
+  return rows;
+}
+
+TEST(CsvFileTest, TrimsCellsLikeTrim) {
+  const std::vector<std::string> samples = {
+      "",
+      "x",
+      " 42 ",
+      "\t1:23.456\t",
+      " \v\f ",
+      "+1.234   ",
+      "  a cell longer than one sixteen byte block  ",
+      "\"  quoted \"",
+      "esc\\,aped "};
+  std::string text = "a,b,c\n";
+  std::vector<std::vector<std::string>> expected;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    std::vector<std::string>& row = expected.emplace_back();
+    for (size_t j = 0; j < 3; ++j) {
+      const std::string& sample = samples[(i + j) % samples.size()];
+      text += (j > 0 ? "," : "") + sample;
+      // The escaped samples read as their unescaped text, then trimmed.
+      std::string unescaped = sample;
+      if (sample.starts_with('"')) unescaped = "  quoted ";
+      if (sample.starts_with("esc")) unescaped = "esc,aped ";
+      row.emplace_back(trim(unescaped));
+    }
+    text += "\n";
+  }
+
+  std::optional<csv_file> file = csv_file::parse(text);
+  ASSERT_TRUE(file.has_value());
+  EXPECT_EQ(read_rows(*file), expected);
+}
+
+TEST(CsvReaderTest, ReadsLikeCsvFile) {
+  fs::path path = fs::path{::testing::TempDir()} / "csv_reader_test.csv";
+  std::mt19937 random{42};
+  const std::string_view alphabet = "ab ,,\n\n\"\\";
+  for (int i = 0; i < 500; ++i) {
+    std::string text = "x, y\n";
+    int length = random() % 200;
+    for (int j = 0; j < length; ++j) {
+      text.push_back(alphabet[random() % alphabet.size()]);
+    }
+    std::ofstream{path, std::ios::trunc} << text;
+    std::optional<csv_file> file = csv_file::parse(text);
+    ASSERT_TRUE(file.has_value());
+
+    for (int thread_count : {1, 3}) {
+      csv_read_options options{
+          .block_size = 1 + random() % 16, .thread_count = thread_count};
+      std::optional<csv_reader> reader = csv_reader::open(path, options);
+      ASSERT_TRUE(reader.has_value());
+      EXPECT_EQ(
+          std::vector<std::string>(
+              reader->column_names().begin(), reader->column_names().end()),
+          (std::vector<std::string>{"x", " y"}));
+      EXPECT_EQ(reader->column("y"), std::nullopt);
+
+      std::vector<std::vector<std::string>> rows;
+      size_t row_count = reader->for_each_row([&](const csv_row& row) {
+        rows.emplace_back(row.size());
+        for (size_t j = 0; j < row.size(); ++j) rows.back()[j] = row[j];
+      });
+      EXPECT_EQ(row_count, rows.size());
+      ASSERT_EQ(rows, read_rows(*file)) << text;
+    }
+  }
+}
+
+TEST(LoadCsvTest, BuildsRowMaps) {
+  std::istringstream input{"id, name\n7,\" Max\\\"\" \nx\\\n y,z\n"};
+  EXPECT_EQ(
+      load_csv(input),
+      (std::vector<std::unordered_map<std::string, std::string>>{
+          {{"id", "7"}, {" name", "Max\""}}, {{"id", "xy"}, {" name", "z"}}}));
+}
+
+} // namespace
+} // namespace f1_predict
@@ -1,48 +1,81 @@
+#include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <map>
+#include <optional>
+#include <set>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "data/batch_io.h"
 #include "data/constants.pb.h"
 #include "data/constants_maps.h"
 #include "data/csv.h"
 #include "data/proto_utils.h"
 #include "data/race_results.pb.h"
+#include "data/results_manifest.h"
+#include "data/write_transaction.h"
 #include "strings/parse.h"
 #include "strings/trim.h"
 
 namespace fs = ::std::filesystem;
 
-using ::f1_predict::load_csv;
-using ::f1_predict::load_result;
+using ::f1_predict::csv_file;
+using ::f1_predict::csv_row;
+using ::f1_predict::find_or_add_driver;
+using ::f1_predict::load_races;
 using ::f1_predict::lookup_circuit;
 using ::f1_predict::lookup_driver;
 using ::f1_predict::lookup_team;
 using ::f1_predict::parse_duration;
 using ::f1_predict::parse_gap;
+using ::f1_predict::parallel_for;
 using ::f1_predict::parse_int;
-using ::f1_predict::save_result;
+using ::f1_predict::race_file_path;
+using ::f1_predict::recover_write_transaction;
+using ::f1_predict::save_races;
 using ::f1_predict::to_proto_duration;
 using ::f1_predict::trim;
+using ::f1_predict::update_manifest;
+using ::f1_predict::write_transaction;
 using ::std::chrono::hours;
 using ::std::chrono::milliseconds;
 using ::std::chrono::minutes;
 using ::std::chrono::seconds;
 
 ABSL_FLAG(std::string, input_file, "", "Path to CSV file containing data.");
+ABSL_FLAG(
+    std::string,
+    input_dir,
+    "",
+    "Directory of CSV files to import together instead of --input_file. Each "
+    "file's season is the name of its directory, or --season if that is not a "
+    "year.");
 ABSL_FLAG(
     std::string,
     output_dir,
     "",
     "Path to directory containing the imported data files.");
 ABSL_FLAG(int, season, 0, "Year of the race season this data covers.");
+ABSL_FLAG(
+    int,
+    threads,
+    0,
+    "Number of threads used to read files and apply results. Defaults to one "
+    "per core.");
+ABSL_FLAG(
+    std::string,
+    result_cache_dir,
+    "",
+    "Directory for caching parsed result files between runs.");
 
 const std::string CIRCUIT_COLUMN = "Track";
 const std::string POSITION_COLUMN = "Position";
@@ -61,104 +94,258 @@ constexpr std::string_view DSQ = "DSQ";
 constexpr std::string_view DQ = "DQ";
 constexpr std::string_view NC = "NC";
 
-void save_race_results(
-    const std::vector<std::unordered_map<std::string, std::string>>& results,
-    const fs::path& output_dir,
+// Indices of the columns read from a race results file.
+struct RaceColumns {
+  size_t position;
+  size_t time;
+  size_t team;
+  size_t driver;
+  size_t starting_position;
+};
+
+// Indices of the columns read from a qualification results file.
+struct QualificationColumns {
+  size_t position;
+  size_t team;
+  size_t driver;
+  size_t qual_1;
+  size_t qual_2;
+  size_t qual_3;
+};
+
+// One input CSV, with its rows grouped by the circuit they belong to.
+struct InputFile {
+  fs::path path;
+  int season = 0;
+  std::optional<csv_file> csv;
+  std::optional<RaceColumns> race_columns;
+  std::optional<QualificationColumns> qualification_columns;
+  std::vector<f1_predict::constants::Circuit> circuits;
+  // Indices of the rows at each circuit, in file order.
+  std::vector<std::vector<size_t>> circuit_rows;
+  // Finishing time of the winner at each circuit, for race results.
+  std::vector<std::optional<milliseconds>> fastest_times;
+};
+
+// The rows of every input file that belong to one race.
+struct RaceImport {
+  int season = 0;
+  f1_predict::constants::Circuit circuit;
+  // Input file and circuit index of each group of rows, with qualification
+  // results ahead of race results.
+  std::vector<std::pair<const InputFile*, size_t>> parts;
+};
+
+std::optional<size_t>
+require_column(const csv_file& file, const std::string& name) {
+  std::optional<size_t> column = file.column(name);
+  if (!column) {
+    std::cerr << "Missing column \"" << name << "\"" << std::endl;
+  }
+  return column;
+}
+
+void apply_race_result(
+    const csv_row& result,
+    const RaceColumns& columns,
     int season,
-    f1_predict::constants::Circuit circuit) {
-  const std::unordered_map<std::string, std::string>* fastest_result = nullptr;
-  for (const auto& result : results) {
-    if (result.at(POSITION_COLUMN) == "1") {
-      fastest_result = &result;
-      break;
-    }
+    f1_predict::constants::Circuit circuit,
+    milliseconds fastest_time,
+    f1_predict::RaceResult& race) {
+  f1_predict::constants::Driver driver = lookup_driver(result[columns.driver]);
+  f1_predict::DriverResult& proto_result = find_or_add_driver(race, driver);
+
+  proto_result.set_circuit(circuit);
+  proto_result.set_race_season(season);
+  proto_result.set_team(lookup_team(result[columns.team]));
+  proto_result.set_driver(driver);
+
+  if (!result[columns.starting_position].empty()) {
+    proto_result.set_starting_position(
+        parse_int(result[columns.starting_position]));
   }
-  if (fastest_result == nullptr) {
-    std::cerr << "Failed to find first place position within results."
-              << std::endl;
-    std::exit(1);
+  if (!result[columns.position].empty() && result[columns.position] != NC &&
+      result[columns.position] != DQ) {
+    proto_result.set_final_position(parse_int(result[columns.position]));
   }
+  if (proto_result.final_position() == 1) {
+    *proto_result.mutable_finals_time() = to_proto_duration(fastest_time);
+  } else if (
+      result[columns.time] != DNF && result[columns.time] != DNS &&
+      result[columns.time] != DSQ) {
+    *proto_result.mutable_finals_time() =
+        to_proto_duration(fastest_time + parse_gap(result[columns.time]));
+  }
+}
 
-  milliseconds fastest_time = parse_duration(fastest_result->at(TIME_COLUMN));
-  fs::create_directories(output_dir);
-  for (const auto& result : results) {
-    f1_predict::DriverResult proto_result;
-
-    f1_predict::constants::Driver driver =
-        lookup_driver(result.at(DRIVER_COLUMN));
-    fs::path out_path = output_dir / f1_predict::constants::Driver_Name(driver);
-    out_path += ".textproto";
-    if (fs::exists(out_path)) proto_result = load_result(out_path);
+void apply_qualification_result(
+    const csv_row& result,
+    const QualificationColumns& columns,
+    int season,
+    f1_predict::constants::Circuit circuit,
+    f1_predict::RaceResult& race) {
+  f1_predict::constants::Driver driver = lookup_driver(result[columns.driver]);
+  f1_predict::DriverResult& proto_result = find_or_add_driver(race, driver);
 
-    proto_result.set_circuit(circuit);
-    proto_result.set_race_season(season);
-    proto_result.set_team(lookup_team(result.at(TEAM_COLUMN)));
-    proto_result.set_driver(driver);
+  proto_result.set_circuit(circuit);
+  proto_result.set_race_season(season);
+  proto_result.set_team(lookup_team(result[columns.team]));
+  proto_result.set_driver(driver);
 
-    if (!result.at(STARTING_POSITION_COLUMN).empty()) {
-      proto_result.set_starting_position(
-          parse_int(result.at(STARTING_POSITION_COLUMN)));
+  if (result[columns.position] != NC && result[columns.position] != DQ) {
+    *proto_result.mutable_qualification_time_1() =
+        to_proto_duration(parse_duration(result[columns.qual_1]));
+    if (!result[columns.qual_2].empty()) {
+      *proto_result.mutable_qualification_time_2() =
+          to_proto_duration(parse_duration(result[columns.qual_2]));
     }
-    if (!result.at(POSITION_COLUMN).empty() &&
-        result.at(POSITION_COLUMN) != NC && result.at(POSITION_COLUMN) != DQ) {
-      proto_result.set_final_position(parse_int(result.at(POSITION_COLUMN)));
+    if (!result[columns.qual_3].empty()) {
+      *proto_result.mutable_qualification_time_3() =
+          to_proto_duration(parse_duration(result[columns.qual_3]));
     }
-    if (proto_result.final_position() == 1) {
-      *proto_result.mutable_finals_time() = to_proto_duration(fastest_time);
-    } else if (
-        result.at(TIME_COLUMN) != DNF && result.at(TIME_COLUMN) != DNS &&
-        result.at(TIME_COLUMN) != DSQ) {
-      *proto_result.mutable_finals_time() =
-          to_proto_duration(fastest_time + parse_gap(result.at(TIME_COLUMN)));
+  }
+}
+
+// Returns the CSV files under `input_dir`, sorted by path. Each takes its
+// season from the name of its directory, or `default_season` if that is not a
+// year.
+std::vector<InputFile>
+find_inputs(const fs::path& input_dir, int default_season) {
+  std::vector<fs::path> paths;
+  for (const auto& entry : fs::recursive_directory_iterator(input_dir)) {
+    if (entry.is_regular_file() &&
+        entry.path().extension() == INPUT_EXTENSION) {
+      paths.push_back(entry.path());
     }
+  }
+  std::ranges::sort(paths);
 
-    save_result(out_path, proto_result);
+  std::vector<InputFile> inputs;
+  inputs.reserve(paths.size());
+  for (fs::path& path : paths) {
+    std::string dir_name = path.parent_path().filename().string();
+    int season = default_season;
+    auto [end, error] = std::from_chars(
+        dir_name.data(), dir_name.data() + dir_name.size(), season);
+    if (error != std::errc{} || end != dir_name.data() + dir_name.size()) {
+      season = default_season;
+    }
+    inputs.push_back({.path = std::move(path), .season = season});
   }
+  return inputs;
 }
 
-void save_qualification_results(
-    const std::vector<std::unordered_map<std::string, std::string>>& results,
-    const fs::path& output_dir,
-    int season,
-    f1_predict::constants::Circuit circuit) {
-
-  fs::create_directories(output_dir);
-  for (const auto& result : results) {
-    f1_predict::DriverResult proto_result;
-
-    f1_predict::constants::Driver driver =
-        lookup_driver(result.at(DRIVER_COLUMN));
-    fs::path out_path = output_dir / f1_predict::constants::Driver_Name(driver);
-    out_path += ".textproto";
-    if (fs::exists(out_path)) proto_result = load_result(out_path);
-
-    proto_result.set_circuit(circuit);
-    proto_result.set_race_season(season);
-    proto_result.set_team(lookup_team(result.at(TEAM_COLUMN)));
-    proto_result.set_driver(driver);
-
-    if (result.at(POSITION_COLUMN) != NC && result.at(POSITION_COLUMN) != DQ) {
-      *proto_result.mutable_qualification_time_1() =
-          to_proto_duration(parse_duration(result.at(QUAL_1_COLUMN)));
-      if (!result.at(QUAL_2_COLUMN).empty()) {
-        *proto_result.mutable_qualification_time_2() =
-            to_proto_duration(parse_duration(result.at(QUAL_2_COLUMN)));
-      }
-      if (!result.at(QUAL_3_COLUMN).empty()) {
-        *proto_result.mutable_qualification_time_3() =
-            to_proto_duration(parse_duration(result.at(QUAL_3_COLUMN)));
-      }
+// Maps an input file and groups its rows by circuit. Returns false and prints
+// the reason to stderr if it cannot be imported.
+bool read_input(InputFile& input) {
+  if (input.season == 0) {
+    std::cerr << "Cannot tell the race season of " << input.path << std::endl;
+    return false;
+  }
+  input.csv = csv_file::open(input.path);
+  if (!input.csv) return false;
+  const csv_file& csv = *input.csv;
+  if (csv.empty()) {
+    std::cerr << "No data loaded from " << input.path << std::endl;
+    return false;
+  }
+
+  std::optional<size_t> circuit_column = require_column(csv, CIRCUIT_COLUMN);
+  if (!circuit_column) return false;
+  if (csv.column(STARTING_POSITION_COLUMN)) {
+    std::optional<size_t> position = require_column(csv, POSITION_COLUMN);
+    std::optional<size_t> time = require_column(csv, TIME_COLUMN);
+    std::optional<size_t> team = require_column(csv, TEAM_COLUMN);
+    std::optional<size_t> driver = require_column(csv, DRIVER_COLUMN);
+    if (!position || !time || !team || !driver) return false;
+    input.race_columns = RaceColumns{
+        .position = *position,
+        .time = *time,
+        .team = *team,
+        .driver = *driver,
+        .starting_position = *csv.column(STARTING_POSITION_COLUMN)};
+  } else if (csv.column(QUAL_1_COLUMN)) {
+    std::optional<size_t> position = require_column(csv, POSITION_COLUMN);
+    std::optional<size_t> team = require_column(csv, TEAM_COLUMN);
+    std::optional<size_t> driver = require_column(csv, DRIVER_COLUMN);
+    std::optional<size_t> qual_2 = require_column(csv, QUAL_2_COLUMN);
+    std::optional<size_t> qual_3 = require_column(csv, QUAL_3_COLUMN);
+    if (!position || !team || !driver || !qual_2 || !qual_3) return false;
+    input.qualification_columns = QualificationColumns{
+        .position = *position,
+        .team = *team,
+        .driver = *driver,
+        .qual_1 = *csv.column(QUAL_1_COLUMN),
+        .qual_2 = *qual_2,
+        .qual_3 = *qual_3};
+  }
+
+  std::unordered_map<f1_predict::constants::Circuit, size_t> circuit_indices;
+  for (size_t i = 0; i < csv.size(); ++i) {
+    csv_row row = csv[i];
+    auto [itr, inserted] = circuit_indices.try_emplace(
+        lookup_circuit(row[*circuit_column]), input.circuits.size());
+    if (inserted) {
+      input.circuits.push_back(itr->first);
+      input.circuit_rows.emplace_back();
+      input.fastest_times.emplace_back();
+    }
+    input.circuit_rows[itr->second].push_back(i);
+    std::optional<milliseconds>& fastest_time =
+        input.fastest_times[itr->second];
+    if (input.race_columns && !fastest_time &&
+        row[input.race_columns->position] == "1") {
+      fastest_time = parse_duration(row[input.race_columns->time]);
     }
+  }
+  if (input.race_columns &&
+      std::ranges::any_of(input.fastest_times, [](const auto& time) {
+        return !time.has_value();
+      })) {
+    std::cerr << "Failed to find first place position within results of "
+              << input.path << std::endl;
+    return false;
+  }
+  return true;
+}
 
-    save_result(out_path, proto_result);
+void apply_import(const RaceImport& import, f1_predict::RaceResult& race) {
+  race.set_circuit(import.circuit);
+  race.set_race_season(import.season);
+  for (const auto& [input, i] : import.parts) {
+    for (size_t row : input->circuit_rows[i]) {
+      if (input->race_columns) {
+        apply_race_result(
+            (*input->csv)[row],
+            *input->race_columns,
+            import.season,
+            import.circuit,
+            *input->fastest_times[i],
+            race);
+      } else {
+        apply_qualification_result(
+            (*input->csv)[row],
+            *input->qualification_columns,
+            import.season,
+            import.circuit,
+            race);
+      }
+    }
   }
 }
 
 int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
+  f1_predict::set_result_cache_dir(absl::GetFlag(FLAGS_result_cache_dir));
 
   fs::path input_path = absl::GetFlag(FLAGS_input_file);
-  if (input_path.extension() != INPUT_EXTENSION) {
+  fs::path input_dir = absl::GetFlag(FLAGS_input_dir);
+  if (input_path.empty() == input_dir.empty()) {
+    std::cerr << "Must specify exactly one of input_file and input_dir."
+              << std::endl;
+    return 1;
+  }
+  if (!input_path.empty() && input_path.extension() != INPUT_EXTENSION) {
     std::cerr << "Input file must be a CSV." << std::endl;
     return 1;
   }
@@ -167,47 +354,85 @@ int main(int argc, char** argv) {
     std::cerr << "Must specify output directory." << std::endl;
     return 1;
   }
-  if (absl::GetFlag(FLAGS_season) == 0) {
+  int season = absl::GetFlag(FLAGS_season);
+  if (!input_path.empty() && season == 0) {
     std::cerr << "Must specify the race season." << std::endl;
     return 1;
   }
+  if (season != 0 && output_dir.filename() == std::to_string(season)) {
+    output_dir = output_dir.parent_path();
+  }
+  recover_write_transaction(output_dir);
 
-  std::ifstream input_stream{input_path};
-  auto data = load_csv(input_stream);
-  if (data.empty()) {
-    std::cerr << "No data loaded." << std::endl;
+  std::vector<InputFile> inputs;
+  if (!input_path.empty()) {
+    inputs.push_back({.path = input_path, .season = season});
+  } else {
+    inputs = find_inputs(input_dir, season);
+  }
+  if (inputs.empty()) {
+    std::cerr << "No CSV files found in " << input_dir << std::endl;
     return 1;
   }
 
-  std::unordered_map<
-      f1_predict::constants::Circuit,
-      std::vector<std::unordered_map<std::string, std::string>>>
-      races_to_results;
-  for (const auto& row : data) {
-    races_to_results[lookup_circuit(row.at(CIRCUIT_COLUMN))].push_back(
-        std::move(row));
-  }
-
-  std::string season_name = std::to_string(absl::GetFlag(FLAGS_season));
-  if (output_dir.filename() != season_name) { output_dir /= season_name; }
-
-  for (const auto& [circuit, results] : races_to_results) {
-    if (results.front().contains(STARTING_POSITION_COLUMN)) {
-      save_race_results(
-          results,
-          output_dir / f1_predict::constants::Circuit_Name(circuit),
-          absl::GetFlag(FLAGS_season),
-          circuit);
-    } else if (results.front().contains(QUAL_1_COLUMN)) {
-      save_qualification_results(
-          results,
-          output_dir / f1_predict::constants::Circuit_Name(circuit),
-          absl::GetFlag(FLAGS_season),
-          circuit);
+  int thread_count = absl::GetFlag(FLAGS_threads);
+  std::vector<char> read(inputs.size());
+  parallel_for(inputs.size(), thread_count, [&](size_t i) {
+    read[i] = read_input(inputs[i]);
+  });
+  if (std::ranges::find(read, false) != read.end()) return 1;
+
+  // Qualification and race results for the same race are merged in memory,
+  // so each race file is read and written once.
+  std::map<std::pair<int, f1_predict::constants::Circuit>, RaceImport> imports;
+  for (bool qualification : {true, false}) {
+    for (const InputFile& input : inputs) {
+      bool has_columns = qualification ? input.qualification_columns.has_value()
+                                       : input.race_columns.has_value();
+      if (!has_columns) continue;
+      for (size_t i = 0; i < input.circuits.size(); ++i) {
+        RaceImport& import = imports[{input.season, input.circuits[i]}];
+        import.season = input.season;
+        import.circuit = input.circuits[i];
+        import.parts.emplace_back(&input, i);
+      }
     }
   }
 
-  std::cout << "Processed " << data.size() << " results from "
-            << races_to_results.size() << " circuits." << std::endl;
+  std::vector<const RaceImport*> race_imports;
+  std::vector<fs::path> race_paths;
+  std::set<fs::path> season_dirs;
+  for (const auto& [race, import] : imports) {
+    race_imports.push_back(&import);
+    race_paths.push_back(
+        race_file_path(output_dir, import.season, import.circuit));
+    season_dirs.insert(race_paths.back().parent_path());
+  }
+  std::vector<f1_predict::RaceResult> races = load_races(race_paths);
+  parallel_for(races.size(), thread_count, [&](size_t i) {
+    apply_import(*race_imports[i], races[i]);
+  });
+
+  std::vector<std::pair<fs::path, f1_predict::RaceResult>> updated_races;
+  updated_races.reserve(races.size());
+  for (size_t i = 0; i < races.size(); ++i) {
+    updated_races.emplace_back(race_paths[i], std::move(races[i]));
+  }
+  for (const fs::path& season_dir : season_dirs) {
+    fs::create_directories(season_dir);
+  }
+  write_transaction transaction{output_dir};
+  f1_predict::save_summary summary = save_races(updated_races, &transaction);
+  transaction.commit();
+  update_manifest(output_dir, summary.written_paths);
+
+  size_t result_count = 0;
+  for (const InputFile& input : inputs) result_count += input.csv->size();
+  std::cout << "Processed " << result_count << " results from "
+            << inputs.size() << " files into " << races.size() << " races."
+            << std::endl;
+  std::cout << "Race files: " << summary.added << " added, "
+            << summary.changed << " changed, " << summary.unchanged
+            << " unchanged" << std::endl;
   return 0;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <filesystem>
@@ -7,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
@@ -16,6 +18,8 @@
 #include "data/constants.pb.h"
 #include "data/proto_utils.h"
 #include "data/race_results.pb.h"
+#include "data/results_manifest.h"
+#include "data/write_transaction.h"
 #include "google/protobuf/descriptor.h"
 #include "strings/parse.h"
 
@@ -158,6 +162,7 @@ int main(int argc, char** argv) {
     std::cerr << "Must specify --results_dir flag." << std::endl;
     return 1;
   }
+  f1_predict::recover_write_transaction(results_dir);
 
   std::cout << "Season\n";
   int season = prompt_int(1950, 2030);
@@ -171,20 +176,24 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  fs::path results_file = results_dir / std::to_string(season) /
-      f1_c::Circuit_Name(circuit) / f1_c::Driver_Name(driver);
-  results_file += ".textproto";
-  std::cout << results_file << ": ";
-  f1_predict::DriverResult results;
-  if (!fs::exists(results_file)) {
+  fs::path race_file = f1_predict::race_file_path(results_dir, season, circuit);
+  std::cout << race_file << ": ";
+  f1_predict::RaceResult race = f1_predict::load_race(race_file);
+  race.set_race_season(season);
+  race.set_circuit(circuit);
+  bool is_new =
+      std::ranges::none_of(race.results(), [&](const DriverResult& result) {
+        return result.driver() == driver;
+      });
+  f1_predict::DriverResult& results =
+      f1_predict::find_or_add_driver(race, driver);
+  if (is_new) {
     std::cout << "Creating new results." << std::endl;
-    fs::create_directories(results_file.parent_path());
+    fs::create_directories(race_file.parent_path());
     results.set_race_season(season);
     results.set_circuit(circuit);
-    results.set_driver(driver);
   } else {
     std::cout << "Editing existing results." << std::endl;
-    results = f1_predict::load_result(results_file);
   }
 
   std::cout << "Team";
@@ -200,8 +209,12 @@ int main(int argc, char** argv) {
   std::cout << "Update finals? [Y/n]\n";
   if (prompt_bool()) prompt_finals_fields(results);
 
-  std::cout << "Saving to " << results_file << "...";
-  f1_predict::save_result(results_file, results);
+  std::cout << "Saving to " << race_file << "...";
+  f1_predict::write_transaction transaction{results_dir};
+  std::pair<fs::path, f1_predict::RaceResult> race_files{race_file, race};
+  f1_predict::save_races({&race_files, 1}, &transaction);
+  transaction.commit();
+  f1_predict::update_manifest(results_dir, {&race_file, 1});
   std::cout << "\n";
 
   return 0;
@@ -1,19 +1,31 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
-#include "absl/strings/str_join.h"
 #include "data/constants.pb.h"
 #include "data/constants_maps.h"
 #include "data/csv.h"
+#include "data/lap_store.h"
+#include "data/pit_stops.h"
 #include "data/proto_utils.h"
 #include "data/race_results.pb.h"
+#include "data/results_manifest.h"
+#include "data/write_transaction.h"
 #include "strings/parse.h"
+#include "strings/simd.h"
 #include "strings/trim.h"
 
 ABSL_FLAG(std::string, dir, "", "Root directory for kaggle dataset.");
@@ -21,7 +33,23 @@ ABSL_FLAG(
     std::string,
     output_dir,
     "",
-    "Path to directory containing the imported data files.");
+    "Path to directory containing the imported data files. May be omitted "
+    "when only importing lap times or pit stops.");
+ABSL_FLAG(
+    std::string,
+    lap_store,
+    "",
+    "If set, lap_times.csv is imported into a lap store at this path.");
+ABSL_FLAG(
+    std::string,
+    pit_stops,
+    "",
+    "If set, pit_stops.csv is aggregated into a pit stop table at this path.");
+ABSL_FLAG(
+    std::string,
+    result_cache_dir,
+    "",
+    "Directory for caching parsed result files between runs.");
 
 namespace fs = ::std::filesystem;
 
@@ -31,14 +59,17 @@ const fs::path DRIVERS_FILE = "drivers.csv";
 const fs::path QUALIFYING_FILE = "qualifying.csv";
 const fs::path RACES_FILE = "races.csv";
 const fs::path RESULTS_FILE = "results.csv";
+const fs::path LAP_TIMES_FILE = "lap_times.csv";
+const fs::path PIT_STOPS_FILE = "pit_stops.csv";
 
 constexpr std::string CIRCUIT_ID_COLUMN = "circuitId";
 constexpr std::string CONSTRUCTOR_ID_COLUMN = "constructorId";
 constexpr std::string DRIVER_ID_COLUMN = "driverId";
-constexpr std::string QUALIFYING_ID_COLUMN = "qualifyId";
 constexpr std::string RACE_ID_COLUMN = "raceId";
+constexpr std::string QUALIFYING_ID_COLUMN = "qualifyId";
 constexpr std::string RESULT_ID_COLUMN = "resultId";
 constexpr std::string SEASON_COLUMN = "year";
+constexpr std::string ROUND_COLUMN = "round";
 constexpr std::string POSITION_COLUMN = "position";
 constexpr std::string FINAL_POSITION_COLUMN = "positionOrder";
 constexpr std::string STARTING_POSITION_COLUMN = "grid";
@@ -49,64 +80,201 @@ constexpr std::string QUAL_2_COLUMN = "q2";
 constexpr std::string QUAL_3_COLUMN = "q3";
 constexpr std::string FINALS_LAP_COUNT_COLUMN = "laps";
 constexpr std::string FINALS_FASTEST_LAP_TIME_COLUMN = "fastestLapTime";
+constexpr std::string LAP_COLUMN = "lap";
+constexpr std::string LAP_TIME_MSEC_COLUMN = "milliseconds";
+constexpr std::string PIT_STOP_MSEC_COLUMN = "milliseconds";
 
 constexpr std::string_view NULL_VALUE = "N";
+// Kaggle ids are small and dense, so tables indexed by them are sized by the
+// largest id. Anything larger is rejected as corrupt rather than allocated for.
+constexpr int MAX_ID = 1'000'000;
 
-using ::f1_predict::load_csv;
-using ::f1_predict::load_result;
+using ::f1_predict::csv_reader;
+using ::f1_predict::csv_row;
+using ::f1_predict::find_or_add_driver;
+using ::f1_predict::lap_record;
+using ::f1_predict::load_races;
 using ::f1_predict::lookup_circuit;
 using ::f1_predict::lookup_driver;
 using ::f1_predict::lookup_team;
 using ::f1_predict::parse_duration;
 using ::f1_predict::parse_int;
-using ::f1_predict::save_result;
+using ::f1_predict::parse_ints;
+using ::f1_predict::pit_stop_summary;
+using ::f1_predict::pit_stop_table;
+using ::f1_predict::race_file_path;
+using ::f1_predict::recover_write_transaction;
+using ::f1_predict::save_races;
 using ::f1_predict::to_proto_duration;
 using ::f1_predict::trim;
+using ::f1_predict::update_manifest;
+using ::f1_predict::write_lap_store;
+using ::f1_predict::write_transaction;
 using ::std::chrono::milliseconds;
 
+// A table keyed by one of the small, dense ids of the Kaggle dataset, stored
+// as a vector indexed directly by id.
+template <typename Value>
+class IdTable {
+public:
+  explicit IdTable(std::string_view name) : _name{name} {}
+
+  void set(int id, Value value) {
+    if (id < 0 || id > MAX_ID) {
+      std::cerr << "Invalid " << _name << " id " << id << std::endl;
+      std::exit(1);
+    }
+    if (static_cast<size_t>(id) >= _values.size()) {
+      _values.resize(id + 1);
+      _present.resize(id + 1);
+    }
+    _values[id] = std::move(value);
+    _present[id] = true;
+  }
+
+  bool contains(int id) const {
+    return id >= 0 && static_cast<size_t>(id) < _present.size() &&
+        _present[id];
+  }
+
+  // Returns the value with the given id, exiting if there is none.
+  const Value& at(int id) const {
+    if (!contains(id)) {
+      std::cerr << "Unknown " << _name << " id " << id << std::endl;
+      std::exit(1);
+    }
+    return _values[id];
+  }
+
+private:
+  std::string_view _name;
+  std::vector<Value> _values;
+  std::vector<bool> _present;
+};
+
 struct IdMaps {
-  std::unordered_map<int, f1_predict::constants::Circuit> circuit_map;
-  std::unordered_map<int, f1_predict::constants::Team> team_map;
-  std::unordered_map<int, f1_predict::constants::Driver> driver_map;
+  IdTable<f1_predict::constants::Circuit> circuit_map{"circuit"};
+  IdTable<f1_predict::constants::Team> team_map{"constructor"};
+  IdTable<f1_predict::constants::Driver> driver_map{"driver"};
 };
 
-std::unordered_map<int, std::unordered_map<std::string, std::string>>
-load_data(const fs::path& path, const std::string& id_column) {
-  std::ifstream input_file{path};
-  auto data = load_csv(input_file);
+// A row of races.csv.
+struct Race {
+  int season = 0;
+  int round = 0;
+  int circuit_id = 0;
+};
 
-  std::unordered_map<int, std::unordered_map<std::string, std::string>> output;
-  for (auto& row : data) {
-    auto itr = row.find(id_column);
-    if (itr == row.end()) {
-      std::cerr << "Row missing id column \"" << id_column << "\"" << std::endl;
-      std::exit(1);
+// A race file that result rows are imported into. Races held at the same
+// circuit in the same season share a file.
+struct ImportedRace {
+  fs::path path;
+  int season;
+  f1_predict::constants::Circuit circuit;
+};
+
+// A row of qualifying.csv joined with its race, with every id resolved.
+struct QualifyingRow {
+  // Index into the imported races.
+  size_t race;
+  f1_predict::constants::Driver driver;
+  int position;
+  std::optional<milliseconds> qual_1;
+  std::optional<milliseconds> qual_2;
+  std::optional<milliseconds> qual_3;
+};
+
+// A row of results.csv joined with its race, with every id resolved.
+struct FinalsRow {
+  // Index into the imported races.
+  size_t race;
+  f1_predict::constants::Driver driver;
+  int starting_position;
+  int final_position;
+  int finals_lap_count;
+  std::optional<milliseconds> finals_fastest_lap_time;
+  std::optional<milliseconds> finals_time;
+};
+
+csv_reader open_csv(const fs::path& path) {
+  std::optional<csv_reader> reader = csv_reader::open(path);
+  if (!reader) std::exit(1);
+  return std::move(*reader);
+}
+
+size_t require_column(const csv_reader& reader, const std::string& name) {
+  std::optional<size_t> column = reader.column(name);
+  if (!column) {
+    std::cerr << "Missing column \"" << name << "\"" << std::endl;
+    std::exit(1);
+  }
+  return *column;
+}
+
+std::optional<milliseconds> parse_optional_duration(std::string_view cell) {
+  if (cell.empty() || cell == NULL_VALUE) return std::nullopt;
+  return parse_duration(cell);
+}
+
+// Parses the id in the given column, exiting with the whole row if the id is
+// out of range.
+int parse_id(const csv_row& row, size_t column, std::string_view table_name) {
+  int id = parse_int(row[column]);
+  if (id < 0 || id > MAX_ID) {
+    std::cerr << "Invalid " << table_name << " id " << id << " in row \"";
+    for (size_t i = 0; i < row.size(); ++i) {
+      std::cerr << (i > 0 ? "," : "") << row[i];
     }
-    output[parse_int(itr->second)] = std::move(row);
+    std::cerr << "\"" << std::endl;
+    std::exit(1);
+  }
+  return id;
+}
+
+// Adds a row of a table keyed by its own id column. A later row with the same
+// id replaces the earlier one.
+template <typename Row>
+void add_row(
+    std::vector<Row>& rows, IdTable<size_t>& row_indices, int id, Row row) {
+  if (row_indices.contains(id)) {
+    rows[row_indices.at(id)] = std::move(row);
+    return;
   }
-  return output;
+  row_indices.set(id, rows.size());
+  rows.push_back(std::move(row));
 }
 
 template <typename Enum, typename... NameColumns>
-std::unordered_map<int, Enum> to_constants(
-    const std::unordered_map<int, std::unordered_map<std::string, std::string>>&
-        dataset,
+IdTable<Enum> load_constants(
+    const fs::path& path,
+    const std::string& id_column,
+    std::string_view table_name,
     Enum (*lookup)(std::string_view),
-    NameColumns&&... name_columns) {
+    const NameColumns&... name_columns) {
+  csv_reader reader = open_csv(path);
+  size_t id_index = require_column(reader, id_column);
+  std::vector<size_t> name_indices = {require_column(reader, name_columns)...};
+
   int failures_count = 0;
-  std::unordered_map<int, Enum> mapper;
-  for (const auto& [id, row] : dataset) {
-    std::string name = absl::StrJoin({row.at(name_columns)...}, " ");
+  IdTable<Enum> mapper{table_name};
+  reader.for_each_row([&](const csv_row& row) {
+    int id = parse_id(row, id_index, table_name);
+    std::string name;
+    for (size_t i = 0; i < name_indices.size(); ++i) {
+      if (i > 0) name += ' ';
+      name += row[name_indices[i]];
+    }
     std::string_view trimmed = trim(name);
     if (trimmed.empty()) {
       ((std::cerr << id << " missing columns ") << ... << name_columns)
           << std::endl;
       ++failures_count;
-      continue;
+      return;
     }
-    mapper[id] = lookup(trimmed);
-    if (!mapper[id]) ++failures_count;
-  }
+    Enum value = lookup(trimmed);
+    mapper.set(id, value);
+    if (!value) ++failures_count;
+  });
   if (failures_count) {
     std::cerr << "Encountered " << failures_count << " failures." << std::endl;
     exit(1);
@@ -114,109 +282,339 @@ std::unordered_map<int, Enum> to_constants(
   return mapper;
 }
 
-fs::path results_file_path(
-    const fs::path& output_dir,
-    const std::unordered_map<std::string, std::string>& results,
-    const IdMaps& id_maps,
-    const std::unordered_map<std::string, std::string>& race) {
-  fs::path file_path =
-      output_dir / race.at(SEASON_COLUMN) /
-      f1_predict::constants::Circuit_Name(
-          id_maps.circuit_map.at(parse_int(race.at(CIRCUIT_ID_COLUMN)))) /
-      f1_predict::constants::Driver_Name(
-          id_maps.driver_map.at(parse_int(results.at(DRIVER_ID_COLUMN))));
-  file_path += ".textproto";
-  return file_path;
+IdTable<Race> load_race_table(const fs::path& path) {
+  csv_reader reader = open_csv(path);
+  size_t race_id = require_column(reader, RACE_ID_COLUMN);
+  size_t season = require_column(reader, SEASON_COLUMN);
+  size_t round = require_column(reader, ROUND_COLUMN);
+  size_t circuit_id = require_column(reader, CIRCUIT_ID_COLUMN);
+  IdTable<Race> races{"race"};
+  reader.for_each_row([&](const csv_row& row) {
+    races.set(
+        parse_id(row, race_id, "race"),
+        Race{
+            .season = parse_int(row[season]),
+            .round = parse_int(row[round]),
+            .circuit_id = parse_int(row[circuit_id])});
+  });
+  return races;
 }
 
-void save_finals_results(
-    const std::unordered_map<std::string, std::string>& finals_result,
-    const IdMaps& id_maps,
-    const std::unordered_map<std::string, std::string>& race,
-    const fs::path& results_file) {
-  f1_predict::DriverResult result;
-  if (fs::exists(results_file)) {
-    result = load_result(results_file);
-  } else {
-    fs::create_directories(results_file.parent_path());
-  }
-
-  result.set_race_season(parse_int(race.at(SEASON_COLUMN)));
-  result.set_circuit(
-      id_maps.circuit_map.at(parse_int(race.at(CIRCUIT_ID_COLUMN))));
-  result.set_driver(
-      id_maps.driver_map.at(parse_int(finals_result.at(DRIVER_ID_COLUMN))));
-  result.set_starting_position(
-      parse_int(finals_result.at(STARTING_POSITION_COLUMN)));
-  result.set_final_position(parse_int(finals_result.at(FINAL_POSITION_COLUMN)));
-  result.set_finals_lap_count(
-      parse_int(finals_result.at(FINALS_LAP_COUNT_COLUMN)));
-
-  if (!finals_result.at(FINALS_FASTEST_LAP_TIME_COLUMN).empty() &&
-      finals_result.at(FINALS_FASTEST_LAP_TIME_COLUMN) != NULL_VALUE) {
-    *result.mutable_finals_fastest_lap_time() = to_proto_duration(
-        parse_duration(finals_result.at(FINALS_FASTEST_LAP_TIME_COLUMN)));
-  }
-
-  if (!finals_result.at(FINAL_TIME_COLUMN).empty() &&
-      finals_result.at(FINAL_TIME_COLUMN) != NULL_VALUE) {
-    *result.mutable_finals_time() = to_proto_duration(
-        milliseconds(parse_int(finals_result.at(FINAL_TIME_MSEC_COLUMN))));
-  }
-
-  save_result(results_file, result);
+// Resolves the race ids of result rows to the race files they are imported
+// into. Each race id is resolved once.
+class RaceIndex {
+public:
+  RaceIndex(
+      const fs::path& output_dir,
+      const IdTable<Race>& races,
+      const IdMaps& id_maps)
+      : _output_dir{output_dir}, _races{races}, _id_maps{id_maps} {}
+
+  // Returns the index of the race file for the given race id.
+  size_t resolve(int race_id) {
+    if (_indices.contains(race_id)) return _indices.at(race_id);
+    const Race& race = _races.at(race_id);
+    f1_predict::constants::Circuit circuit =
+        _id_maps.circuit_map.at(race.circuit_id);
+    auto [itr, inserted] = _file_indices.try_emplace(
+        std::pair{race.season, circuit}, _imported.size());
+    if (inserted) {
+      _imported.push_back(
+          {.path = race_file_path(_output_dir, race.season, circuit),
+           .season = race.season,
+           .circuit = circuit});
+    }
+    _indices.set(race_id, itr->second);
+    return itr->second;
+  }
+
+  const std::vector<ImportedRace>& imported() const { return _imported; }
+
+private:
+  const fs::path& _output_dir;
+  const IdTable<Race>& _races;
+  const IdMaps& _id_maps;
+  IdTable<size_t> _indices{"race"};
+  std::map<std::pair<int, f1_predict::constants::Circuit>, size_t>
+      _file_indices;
+  std::vector<ImportedRace> _imported;
+};
+
+std::vector<QualifyingRow> join_qualifying(
+    const fs::path& path, const IdMaps& id_maps, RaceIndex& race_index) {
+  csv_reader reader = open_csv(path);
+  size_t qualifying_id = require_column(reader, QUALIFYING_ID_COLUMN);
+  size_t race_id = require_column(reader, RACE_ID_COLUMN);
+  size_t driver_id = require_column(reader, DRIVER_ID_COLUMN);
+  size_t position = require_column(reader, POSITION_COLUMN);
+  size_t qual_1 = require_column(reader, QUAL_1_COLUMN);
+  size_t qual_2 = require_column(reader, QUAL_2_COLUMN);
+  size_t qual_3 = require_column(reader, QUAL_3_COLUMN);
+
+  std::vector<QualifyingRow> rows;
+  IdTable<size_t> row_indices{"qualifying"};
+  reader.for_each_row([&](const csv_row& row) {
+    add_row(
+        rows,
+        row_indices,
+        parse_id(row, qualifying_id, "qualifying"),
+        QualifyingRow{
+            .race = race_index.resolve(parse_int(row[race_id])),
+            .driver = id_maps.driver_map.at(parse_int(row[driver_id])),
+            .position = parse_int(row[position]),
+            .qual_1 = parse_optional_duration(row[qual_1]),
+            .qual_2 = parse_optional_duration(row[qual_2]),
+            .qual_3 = parse_optional_duration(row[qual_3])});
+  });
+  return rows;
+}
+
+std::vector<FinalsRow> join_finals(
+    const fs::path& path, const IdMaps& id_maps, RaceIndex& race_index) {
+  csv_reader reader = open_csv(path);
+  size_t result_id = require_column(reader, RESULT_ID_COLUMN);
+  size_t race_id = require_column(reader, RACE_ID_COLUMN);
+  size_t driver_id = require_column(reader, DRIVER_ID_COLUMN);
+  size_t starting_position = require_column(reader, STARTING_POSITION_COLUMN);
+  size_t final_position = require_column(reader, FINAL_POSITION_COLUMN);
+  size_t finals_lap_count = require_column(reader, FINALS_LAP_COUNT_COLUMN);
+  size_t finals_fastest_lap_time =
+      require_column(reader, FINALS_FASTEST_LAP_TIME_COLUMN);
+  size_t final_time = require_column(reader, FINAL_TIME_COLUMN);
+  size_t final_time_msec = require_column(reader, FINAL_TIME_MSEC_COLUMN);
+
+  std::vector<FinalsRow> rows;
+  IdTable<size_t> row_indices{"result"};
+  reader.for_each_row([&](const csv_row& row) {
+    std::optional<milliseconds> finals_time;
+    if (!row[final_time].empty() && row[final_time] != NULL_VALUE) {
+      finals_time = milliseconds(parse_int(row[final_time_msec]));
+    }
+    add_row(
+        rows,
+        row_indices,
+        parse_id(row, result_id, "result"),
+        FinalsRow{
+            .race = race_index.resolve(parse_int(row[race_id])),
+            .driver = id_maps.driver_map.at(parse_int(row[driver_id])),
+            .starting_position = parse_int(row[starting_position]),
+            .final_position = parse_int(row[final_position]),
+            .finals_lap_count = parse_int(row[finals_lap_count]),
+            .finals_fastest_lap_time =
+                parse_optional_duration(row[finals_fastest_lap_time]),
+            .finals_time = finals_time});
+  });
+  return rows;
+}
+
+// Lap times are far too many to store in race files, so each row of
+// lap_times.csv is resolved straight to a compact lap_record instead.
+std::vector<lap_record> join_lap_times(
+    const fs::path& path, const IdMaps& id_maps, const IdTable<Race>& races) {
+  csv_reader reader = open_csv(path);
+  size_t race_id = require_column(reader, RACE_ID_COLUMN);
+  size_t driver_id = require_column(reader, DRIVER_ID_COLUMN);
+  size_t lap = require_column(reader, LAP_COLUMN);
+  size_t position = require_column(reader, POSITION_COLUMN);
+  size_t lap_time_msec = require_column(reader, LAP_TIME_MSEC_COLUMN);
+
+  std::vector<lap_record> laps;
+  // Every cell used is an integer, so each row's are parsed in one batch.
+  std::array<std::string_view, 5> cells;
+  std::array<int, 5> values;
+  reader.for_each_row([&](const csv_row& row) {
+    cells = {
+        row[race_id],
+        row[driver_id],
+        row[lap],
+        row[position],
+        row[lap_time_msec]};
+    parse_ints(cells, values);
+    const Race& race = races.at(values[0]);
+    laps.push_back(
+        {.race_season = race.season,
+         .round = race.round,
+         .circuit = id_maps.circuit_map.at(race.circuit_id),
+         .driver = id_maps.driver_map.at(values[1]),
+         .lap = values[2],
+         .position = values[3],
+         .lap_time_ms = values[4]});
+  });
+  return laps;
 }
 
-void save_qualifying_results(
-    const std::unordered_map<std::string, std::string>& qual_results,
+// Running totals of one driver's pit stops in one race.
+struct PitStopTotals {
+  int count = 0;
+  int total_time_ms = 0;
+  int best_time_ms = std::numeric_limits<int>::max();
+};
+
+int median(std::vector<int>& values) {
+  size_t middle = values.size() / 2;
+  std::ranges::nth_element(values, values.begin() + middle);
+  if (values.size() % 2 == 1) return values[middle];
+  int upper = values[middle];
+  int lower = *std::max_element(values.begin(), values.begin() + middle);
+  return (lower + upper) / 2;
+}
+
+// Aggregates pit_stops.csv in one streaming pass. Only running totals per
+// driver and race are kept, plus the stop durations of each team in each race
+// for their median.
+pit_stop_table aggregate_pit_stops(
+    const fs::path& pit_stops_path,
+    const fs::path& results_path,
     const IdMaps& id_maps,
-    const std::unordered_map<std::string, std::string>& race,
-    const fs::path& results_file) {
-  f1_predict::DriverResult result;
-  if (fs::exists(results_file)) {
-    result = load_result(results_file);
-  } else {
-    fs::create_directories(results_file.parent_path());
-  }
-
-  result.set_race_season(parse_int(race.at(SEASON_COLUMN)));
-  result.set_circuit(
-      id_maps.circuit_map.at(parse_int(race.at(CIRCUIT_ID_COLUMN))));
-  result.set_driver(
-      id_maps.driver_map.at(parse_int(qual_results.at(DRIVER_ID_COLUMN))));
-  result.set_starting_position(parse_int(qual_results.at(POSITION_COLUMN)));
-
-  if (!qual_results.at(QUAL_1_COLUMN).empty() &&
-      qual_results.at(QUAL_1_COLUMN) != NULL_VALUE) {
+    const IdTable<Race>& races) {
+  // pit_stops.csv has no constructor column, so each driver's team comes from
+  // their row of results.csv.
+  std::map<std::pair<int, int>, f1_predict::constants::Team> teams;
+  {
+    csv_reader reader = open_csv(results_path);
+    size_t race_id = require_column(reader, RACE_ID_COLUMN);
+    size_t driver_id = require_column(reader, DRIVER_ID_COLUMN);
+    size_t constructor_id = require_column(reader, CONSTRUCTOR_ID_COLUMN);
+    reader.for_each_row([&](const csv_row& row) {
+      teams[{parse_int(row[race_id]), parse_int(row[driver_id])}] =
+          id_maps.team_map.at(parse_int(row[constructor_id]));
+    });
+  }
+
+  std::map<std::pair<int, int>, PitStopTotals> driver_totals;
+  std::map<std::pair<int, f1_predict::constants::Team>, std::vector<int>>
+      team_times;
+  csv_reader reader = open_csv(pit_stops_path);
+  size_t race_id = require_column(reader, RACE_ID_COLUMN);
+  size_t driver_id = require_column(reader, DRIVER_ID_COLUMN);
+  size_t time_msec = require_column(reader, PIT_STOP_MSEC_COLUMN);
+  reader.for_each_row([&](const csv_row& row) {
+    std::pair key{parse_int(row[race_id]), parse_int(row[driver_id])};
+    int time_ms = parse_int(row[time_msec]);
+    PitStopTotals& totals = driver_totals[key];
+    ++totals.count;
+    totals.total_time_ms += time_ms;
+    totals.best_time_ms = std::min(totals.best_time_ms, time_ms);
+    auto team = teams.find(key);
+    if (team == teams.end()) {
+      std::cerr << "No result for driver id " << key.second << " in race id "
+                << key.first << std::endl;
+      std::exit(1);
+    }
+    team_times[{key.first, team->second}].push_back(time_ms);
+  });
+
+  std::map<std::pair<int, f1_predict::constants::Team>, int> team_medians;
+  for (auto& [key, times] : team_times) team_medians[key] = median(times);
+
+  // Races held at the same circuit in one season share a key, so entries are
+  // ordered by round for the table to keep the last of them, like the race
+  // files do.
+  std::vector<std::pair<int, pit_stop_summary>> rounds;
+  rounds.reserve(driver_totals.size());
+  for (const auto& [key, totals] : driver_totals) {
+    const auto& [race_id, driver_id] = key;
+    const Race& race = races.at(race_id);
+    f1_predict::constants::Team team = teams.at(key);
+    rounds.emplace_back(
+        race.round,
+        pit_stop_summary{
+            .race_season = race.season,
+            .circuit = id_maps.circuit_map.at(race.circuit_id),
+            .driver = id_maps.driver_map.at(driver_id),
+            .team = team,
+            .stop_count = totals.count,
+            .total_time_ms = totals.total_time_ms,
+            .best_time_ms = totals.best_time_ms,
+            .team_median_time_ms = team_medians.at({race_id, team})});
+  }
+  std::ranges::stable_sort(rounds, {}, [](const auto& round) {
+    return std::pair{round.second.race_season, round.first};
+  });
+  std::vector<pit_stop_summary> entries;
+  entries.reserve(rounds.size());
+  for (const auto& [round, entry] : rounds) entries.push_back(entry);
+  return pit_stop_table{std::move(entries)};
+}
+
+f1_predict::save_summary write_races(
+    const std::vector<ImportedRace>& imported,
+    std::vector<f1_predict::RaceResult> races,
+    write_transaction& transaction) {
+  std::set<fs::path> season_dirs;
+  std::vector<std::pair<fs::path, f1_predict::RaceResult>> race_files;
+  race_files.reserve(races.size());
+  for (size_t i = 0; i < races.size(); ++i) {
+    season_dirs.insert(imported[i].path.parent_path());
+    race_files.emplace_back(imported[i].path, std::move(races[i]));
+  }
+  for (const fs::path& season_dir : season_dirs) {
+    fs::create_directories(season_dir);
+  }
+  return save_races(race_files, &transaction);
+}
+
+void apply_finals_results(
+    const FinalsRow& finals_result, f1_predict::RaceResult& race) {
+  f1_predict::DriverResult& result =
+      find_or_add_driver(race, finals_result.driver);
+  result.set_race_season(race.race_season());
+  result.set_circuit(race.circuit());
+  result.set_driver(finals_result.driver);
+  result.set_starting_position(finals_result.starting_position);
+  result.set_final_position(finals_result.final_position);
+  result.set_finals_lap_count(finals_result.finals_lap_count);
+
+  if (finals_result.finals_fastest_lap_time) {
+    *result.mutable_finals_fastest_lap_time() =
+        to_proto_duration(*finals_result.finals_fastest_lap_time);
+  }
+  if (finals_result.finals_time) {
+    *result.mutable_finals_time() =
+        to_proto_duration(*finals_result.finals_time);
+  }
+}
+
+void apply_qualifying_results(
+    const QualifyingRow& qual_results, f1_predict::RaceResult& race) {
+  f1_predict::DriverResult& result =
+      find_or_add_driver(race, qual_results.driver);
+  result.set_race_season(race.race_season());
+  result.set_circuit(race.circuit());
+  result.set_driver(qual_results.driver);
+  result.set_starting_position(qual_results.position);
+
+  if (qual_results.qual_1) {
     *result.mutable_qualification_time_1() =
-        to_proto_duration(parse_duration(qual_results.at(QUAL_1_COLUMN)));
+        to_proto_duration(*qual_results.qual_1);
   }
-  if (!qual_results.at(QUAL_2_COLUMN).empty() &&
-      qual_results.at(QUAL_2_COLUMN) != NULL_VALUE) {
+  if (qual_results.qual_2) {
     *result.mutable_qualification_time_2() =
-        to_proto_duration(parse_duration(qual_results.at(QUAL_2_COLUMN)));
+        to_proto_duration(*qual_results.qual_2);
   }
-  if (!qual_results.at(QUAL_3_COLUMN).empty() &&
-      qual_results.at(QUAL_3_COLUMN) != NULL_VALUE) {
+  if (qual_results.qual_3) {
     *result.mutable_qualification_time_3() =
-        to_proto_duration(parse_duration(qual_results.at(QUAL_3_COLUMN)));
+        to_proto_duration(*qual_results.qual_3);
   }
-
-  save_result(results_file, result);
 }
 
 int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
+  f1_predict::set_result_cache_dir(absl::GetFlag(FLAGS_result_cache_dir));
 
   if (absl::GetFlag(FLAGS_dir).empty()) {
     std::cerr << "dir is required." << std::endl;
     return 1;
   }
   fs::path output_dir = absl::GetFlag(FLAGS_output_dir);
-  if (output_dir.empty()) {
-    std::cerr << "Must specify output directory." << std::endl;
+  fs::path lap_store_path = absl::GetFlag(FLAGS_lap_store);
+  fs::path pit_stops_path = absl::GetFlag(FLAGS_pit_stops);
+  if (output_dir.empty() && lap_store_path.empty() && pit_stops_path.empty()) {
+    std::cerr << "Must specify output directory, lap store or pit stops."
+              << std::endl;
     return 1;
   }
+  if (!output_dir.empty()) recover_write_transaction(output_dir);
 
   const fs::path root = absl::GetFlag(FLAGS_dir);
   if (!fs::exists(root)) {
@@ -229,6 +627,8 @@ int main(int argc, char** argv) {
   fs::path qualifying_file = root / QUALIFYING_FILE;
   fs::path races_file = root / RACES_FILE;
   fs::path results_file = root / RESULTS_FILE;
+  fs::path lap_times_file = root / LAP_TIMES_FILE;
+  fs::path pit_stops_file = root / PIT_STOPS_FILE;
   if (!fs::exists(circuits_file)) {
     std::cerr << "Missing circuits CSV file." << std::endl;
     return 1;
@@ -241,7 +641,7 @@ int main(int argc, char** argv) {
     std::cerr << "Missing drivers CSV file." << std::endl;
     return 1;
   }
-  if (!fs::exists(qualifying_file)) {
+  if (!output_dir.empty() && !fs::exists(qualifying_file)) {
     std::cerr << "Missing qualifying CSV file." << std::endl;
     return 1;
   }
@@ -249,42 +649,95 @@ int main(int argc, char** argv) {
     std::cerr << "Missing races CSV file." << std::endl;
     return 1;
   }
-  if (!fs::exists(results_file)) {
+  if ((!output_dir.empty() || !pit_stops_path.empty()) &&
+      !fs::exists(results_file)) {
     std::cerr << "Missing results CSV file." << std::endl;
     return 1;
   }
-
-  auto circuits = load_data(circuits_file, CIRCUIT_ID_COLUMN);
-  auto constructors = load_data(constructors_file, CONSTRUCTOR_ID_COLUMN);
-  auto drivers = load_data(drivers_file, DRIVER_ID_COLUMN);
-  auto qualifying = load_data(qualifying_file, QUALIFYING_ID_COLUMN);
-  auto races = load_data(races_file, RACE_ID_COLUMN);
-  auto results = load_data(results_file, RESULT_ID_COLUMN);
+  if (!lap_store_path.empty() && !fs::exists(lap_times_file)) {
+    std::cerr << "Missing lap times CSV file." << std::endl;
+    return 1;
+  }
+  if (!pit_stops_path.empty() && !fs::exists(pit_stops_file)) {
+    std::cerr << "Missing pit stops CSV file." << std::endl;
+    return 1;
+  }
 
   IdMaps id_maps{
-      .circuit_map = to_constants(circuits, &lookup_circuit, "name"),
-      .team_map = to_constants(constructors, &lookup_team, "name"),
-      .driver_map =
-          to_constants(drivers, &lookup_driver, "forename", "surname")};
+      .circuit_map = load_constants(
+          circuits_file, CIRCUIT_ID_COLUMN, "circuit", &lookup_circuit, "name"),
+      .team_map = load_constants(
+          constructors_file,
+          CONSTRUCTOR_ID_COLUMN,
+          "constructor",
+          &lookup_team,
+          "name"),
+      .driver_map = load_constants(
+          drivers_file,
+          DRIVER_ID_COLUMN,
+          "driver",
+          &lookup_driver,
+          "forename",
+          "surname")};
+  IdTable<Race> races = load_race_table(races_file);
+
+  if (!lap_store_path.empty()) {
+    std::vector<lap_record> laps =
+        join_lap_times(lap_times_file, id_maps, races);
+    size_t lap_count = laps.size();
+    write_lap_store(lap_store_path, std::move(laps));
+    std::cout << "Imported " << lap_count << " lap times" << std::endl;
+  }
+  if (!pit_stops_path.empty()) {
+    pit_stop_table pit_stops =
+        aggregate_pit_stops(pit_stops_file, results_file, id_maps, races);
+    pit_stops.save(pit_stops_path);
+    std::cout << "Imported pit stops of " << pit_stops.entries().size()
+              << " drivers" << std::endl;
+  }
+  if (output_dir.empty()) return 0;
+
+  // Result rows are joined with their races and resolved to typed rows in one
+  // pass, so the races they belong to can be loaded in one batch. Qualifying
+  // and finals results are merged into the same races in memory, so each race
+  // file is read and written once.
+  RaceIndex race_index{output_dir, races, id_maps};
+  std::vector<QualifyingRow> qualifying =
+      join_qualifying(qualifying_file, id_maps, race_index);
+  std::vector<FinalsRow> results =
+      join_finals(results_file, id_maps, race_index);
 
-  for (const auto& [qual_id, qual_results] : qualifying) {
-    const auto& race = races.at(parse_int(qual_results.at(RACE_ID_COLUMN)));
-    const fs::path results_file =
-        results_file_path(output_dir, qual_results, id_maps, race);
+  const std::vector<ImportedRace>& imported = race_index.imported();
+  std::vector<fs::path> race_paths;
+  race_paths.reserve(imported.size());
+  for (const ImportedRace& race : imported) race_paths.push_back(race.path);
+  std::vector<f1_predict::RaceResult> loaded_races = load_races(race_paths);
+  for (size_t i = 0; i < loaded_races.size(); ++i) {
+    loaded_races[i].set_race_season(imported[i].season);
+    loaded_races[i].set_circuit(imported[i].circuit);
+  }
 
-    save_qualifying_results(qual_results, id_maps, race, results_file);
+  for (const QualifyingRow& qual_results : qualifying) {
+    apply_qualifying_results(qual_results, loaded_races[qual_results.race]);
   }
   std::cout << "Imported " << qualifying.size() << " qualifying results"
             << std::endl;
 
-  for (const auto& [result_id, finals_result] : results) {
-    const auto& race = races.at(parse_int(finals_result.at(RACE_ID_COLUMN)));
-    const fs::path results_file =
-        results_file_path(output_dir, finals_result, id_maps, race);
-
-    save_finals_results(finals_result, id_maps, race, results_file);
+  for (const FinalsRow& finals_result : results) {
+    apply_finals_results(finals_result, loaded_races[finals_result.race]);
   }
   std::cout << "Imported " << results.size() << " finals results" << std::endl;
 
+  // Every race file is replaced in one transaction, so an interrupted import
+  // leaves the results as they were before it started.
+  write_transaction transaction{output_dir};
+  f1_predict::save_summary summary =
+      write_races(imported, std::move(loaded_races), transaction);
+  transaction.commit();
+  update_manifest(output_dir, summary.written_paths);
+  std::cout << "Race files: " << summary.added << " added, "
+            << summary.changed << " changed, " << summary.unchanged
+            << " unchanged" << std::endl;
+
   return 0;
 }
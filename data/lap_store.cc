@@ -0,0 +1,214 @@
+#include "data/lap_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "data/constants.pb.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+constexpr size_t LAP_COLUMN_COUNT = 4;
+
+template <typename Value>
+void write_values(std::ofstream& out, std::span<const Value> values) {
+  out.write(
+      reinterpret_cast<const char*>(values.data()),
+      values.size() * sizeof(Value));
+}
+
+} // namespace
+
+std::optional<lap_store> lap_store::open(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open lap store " << path << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || file_stat.st_size < 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(lap_store_header)) {
+    std::cerr << "Lap store " << path << " is truncated." << std::endl;
+    ::close(fd);
+    return std::nullopt;
+  }
+  size_t size = file_stat.st_size;
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map lap store " << path << std::endl;
+    return std::nullopt;
+  }
+  lap_store store{data, size};
+
+  const char* bytes = static_cast<const char*>(data);
+  lap_store_header header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, LAP_STORE_MAGIC, sizeof(header.magic))) {
+    std::cerr << path << " is not a lap store." << std::endl;
+    return std::nullopt;
+  }
+  if (header.version != LAP_STORE_VERSION) {
+    std::cerr << "Unsupported lap store version " << header.version << " in "
+              << path << std::endl;
+    return std::nullopt;
+  }
+  size_t races_size = sizeof(lap_store_race) * header.race_count;
+  size_t lap_size = LAP_COLUMN_COUNT * sizeof(int32_t);
+  if (races_size > size - sizeof(header) ||
+      header.lap_count > size / lap_size ||
+      size - sizeof(header) - races_size != lap_size * header.lap_count) {
+    std::cerr << "Lap store " << path << " has the wrong size." << std::endl;
+    return std::nullopt;
+  }
+
+  // Every section starts at a multiple of its element size, because the
+  // header and race table are multiples of 8 bytes and the mapping is page
+  // aligned.
+  store._races = {
+      reinterpret_cast<const lap_store_race*>(bytes + sizeof(header)),
+      header.race_count};
+  const auto* columns = reinterpret_cast<const int32_t*>(
+      bytes + sizeof(header) + races_size);
+  size_t lap_count = header.lap_count;
+  store._driver = {columns, lap_count};
+  store._lap = {columns + lap_count, lap_count};
+  store._position = {columns + 2 * lap_count, lap_count};
+  store._lap_time_ms = {columns + 3 * lap_count, lap_count};
+  for (const lap_store_race& race : store._races) {
+    if (race.first_lap > lap_count ||
+        race.lap_count > lap_count - race.first_lap) {
+      std::cerr << "Lap store " << path << " has an out of range race."
+                << std::endl;
+      return std::nullopt;
+    }
+  }
+  return store;
+}
+
+lap_store::lap_store(void* data, size_t size) : _data{data}, _size{size} {}
+
+lap_store::lap_store(lap_store&& other) noexcept
+    : _data{std::exchange(other._data, nullptr)},
+      _size{std::exchange(other._size, 0)},
+      _races{std::exchange(other._races, {})},
+      _driver{std::exchange(other._driver, {})},
+      _lap{std::exchange(other._lap, {})},
+      _position{std::exchange(other._position, {})},
+      _lap_time_ms{std::exchange(other._lap_time_ms, {})} {}
+
+lap_store& lap_store::operator=(lap_store&& other) noexcept {
+  if (this != &other) {
+    if (_data) ::munmap(_data, _size);
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _races = std::exchange(other._races, {});
+    _driver = std::exchange(other._driver, {});
+    _lap = std::exchange(other._lap, {});
+    _position = std::exchange(other._position, {});
+    _lap_time_ms = std::exchange(other._lap_time_ms, {});
+  }
+  return *this;
+}
+
+lap_store::~lap_store() {
+  if (_data) ::munmap(_data, _size);
+}
+
+std::optional<size_t>
+lap_store::find_race(int season, constants::Circuit circuit) const {
+  auto season_end = std::ranges::upper_bound(
+      _races, season, {}, &lap_store_race::race_season);
+  for (auto itr = season_end; itr != _races.begin();) {
+    --itr;
+    if (itr->race_season != season) break;
+    if (itr->circuit == circuit) return itr - _races.begin();
+  }
+  return std::nullopt;
+}
+
+driver_laps lap_store::laps(size_t race, constants::Driver driver) const {
+  const lap_store_race& info = _races[race];
+  std::span<const int32_t> drivers =
+      _driver.subspan(info.first_lap, info.lap_count);
+  auto [begin, end] = std::ranges::equal_range(drivers, driver);
+  size_t first = info.first_lap + (begin - drivers.begin());
+  size_t count = end - begin;
+  return {
+      .lap = _lap.subspan(first, count),
+      .position = _position.subspan(first, count),
+      .lap_time_ms = _lap_time_ms.subspan(first, count)};
+}
+
+void write_lap_store(const fs::path& path, std::vector<lap_record> laps) {
+  std::ranges::sort(laps, [](const lap_record& a, const lap_record& b) {
+    return std::tie(a.race_season, a.round, a.driver, a.lap) <
+        std::tie(b.race_season, b.round, b.driver, b.lap);
+  });
+
+  std::vector<lap_store_race> races;
+  std::vector<int32_t> columns(LAP_COLUMN_COUNT * laps.size());
+  std::span<int32_t> driver = std::span{columns}.first(laps.size());
+  std::span<int32_t> lap = std::span{columns}.subspan(laps.size(), laps.size());
+  std::span<int32_t> position =
+      std::span{columns}.subspan(2 * laps.size(), laps.size());
+  std::span<int32_t> lap_time_ms = std::span{columns}.last(laps.size());
+  for (size_t i = 0; i < laps.size(); ++i) {
+    const lap_record& record = laps[i];
+    if (races.empty() || record.race_season != races.back().race_season ||
+        record.round != races.back().round) {
+      races.push_back(
+          {.race_season = record.race_season,
+           .round = record.round,
+           .circuit = record.circuit,
+           .lap_count = 0,
+           .first_lap = i});
+    }
+    ++races.back().lap_count;
+    driver[i] = record.driver;
+    lap[i] = record.lap;
+    position[i] = record.position;
+    lap_time_ms[i] = record.lap_time_ms;
+  }
+
+  lap_store_header header{
+      .version = LAP_STORE_VERSION,
+      .race_count = static_cast<uint32_t>(races.size()),
+      .lap_count = laps.size()};
+  std::memcpy(header.magic, LAP_STORE_MAGIC, sizeof(header.magic));
+
+  // Readers map the store, so it is replaced by a rename rather than being
+  // truncated under them.
+  fs::path temp_path = path;
+  temp_path += ".tmp";
+  {
+    std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_values<lap_store_race>(out, races);
+    write_values<int32_t>(out, columns);
+    out.close();
+    if (!out) {
+      std::cerr << "Failed to write lap store " << temp_path << std::endl;
+      std::exit(1);
+    }
+  }
+  fs::rename(temp_path, path);
+}
+
+} // namespace f1_predict
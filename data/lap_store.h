@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "data/constants.pb.h"
+
+namespace f1_predict {
+
+// A lap store holds the lap times of many races in columns that are read in
+// place from a memory-mapped file. The layout is:
+//
+//   lap_store_header
+//   lap_store_race[race_count]
+//   int32_t driver[lap_count]
+//   int32_t lap[lap_count]
+//   int32_t position[lap_count]
+//   int32_t lap_time_ms[lap_count]
+//
+// Races are sorted by season and round. The laps of each race are contiguous,
+// starting at the race's first_lap, and sorted by driver and then lap, so the
+// laps of one driver in one race are a contiguous range of every column. All
+// integers are stored in host byte order.
+
+constexpr char LAP_STORE_MAGIC[8] = {'F', '1', 'L', 'A', 'P', 'S', 0, 0};
+constexpr uint32_t LAP_STORE_VERSION = 1;
+inline constexpr char LAP_STORE_EXTENSION[] = ".f1laps";
+
+struct lap_store_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t race_count;
+  uint64_t lap_count;
+};
+
+struct lap_store_race {
+  int32_t race_season;
+  int32_t round;
+  int32_t circuit;
+  uint32_t lap_count;
+  uint64_t first_lap;
+};
+
+static_assert(sizeof(lap_store_header) == 24);
+static_assert(sizeof(lap_store_race) == 24);
+
+// One lap of one driver, as written into a lap store.
+struct lap_record {
+  int32_t race_season;
+  int32_t round;
+  constants::Circuit circuit;
+  constants::Driver driver;
+  int32_t lap;
+  int32_t position;
+  int32_t lap_time_ms;
+};
+
+// The laps of one driver in one race, sorted by lap. Element i of each span
+// belongs to the same lap.
+struct driver_laps {
+  std::span<const int32_t> lap;
+  std::span<const int32_t> position;
+  std::span<const int32_t> lap_time_ms;
+
+  size_t size() const { return lap.size(); }
+  bool empty() const { return lap.empty(); }
+};
+
+// Read-only, memory-mapped view of a lap store. Only the pages of the laps
+// that are read are ever loaded.
+class lap_store {
+public:
+  // Maps the given file and validates its header and race table. Returns
+  // nullopt and prints the reason to stderr if the file is not a valid lap
+  // store.
+  static std::optional<lap_store> open(const std::filesystem::path& path);
+
+  lap_store(const lap_store&) = delete;
+  lap_store& operator=(const lap_store&) = delete;
+  lap_store(lap_store&& other) noexcept;
+  lap_store& operator=(lap_store&& other) noexcept;
+  ~lap_store();
+
+  std::span<const lap_store_race> races() const { return _races; }
+  size_t lap_count() const { return _driver.size(); }
+
+  // Returns the index of the race held at `circuit` in `season`. When the
+  // circuit held more than one race that season, returns the last of them,
+  // like the race file whose results come from the last one imported.
+  std::optional<size_t>
+  find_race(int season, constants::Circuit circuit) const;
+
+  // Returns the laps `driver` completed in the race with the given index,
+  // which are empty if the driver did not take part.
+  driver_laps laps(size_t race, constants::Driver driver) const;
+
+private:
+  lap_store(void* data, size_t size);
+
+  void* _data = nullptr;
+  size_t _size = 0;
+  std::span<const lap_store_race> _races;
+  std::span<const int32_t> _driver;
+  std::span<const int32_t> _lap;
+  std::span<const int32_t> _position;
+  std::span<const int32_t> _lap_time_ms;
+};
+
+// Writes the given laps into a lap store at `path`, replacing any existing
+// file. Exits if the file cannot be written.
+void write_lap_store(
+    const std::filesystem::path& path, std::vector<lap_record> laps);
+
+} // namespace f1_predict
@@ -0,0 +1,107 @@
+#include "data/lap_store.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+lap_record make_lap(
+    int round,
+    constants::Circuit circuit,
+    constants::Driver driver,
+    int lap,
+    int position) {
+  return {
+      .race_season = 2024,
+      .round = round,
+      .circuit = circuit,
+      .driver = driver,
+      .lap = lap,
+      .position = position,
+      .lap_time_ms = 90000 + 100 * lap + position};
+}
+
+class LapStoreTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _path = fs::path{::testing::TempDir()} / "lap_store_test.f1laps";
+    write_lap_store(
+        _path,
+        {make_lap(8, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 2, 2),
+         make_lap(1, constants::BAHRAIN_CIRCUIT, constants::LANDO_NORRIS, 1, 6),
+         make_lap(8, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 1, 2),
+         make_lap(
+             8, constants::MONACO_CIRCUIT, constants::CHARLES_LECLERC, 1, 1),
+         make_lap(
+             9, constants::MONACO_CIRCUIT, constants::CHARLES_LECLERC, 1, 3)});
+  }
+
+  fs::path _path;
+};
+
+TEST_F(LapStoreTest, ReadsDriverLaps) {
+  std::optional<lap_store> store = lap_store::open(_path);
+  ASSERT_TRUE(store);
+  EXPECT_EQ(store->races().size(), 3);
+  EXPECT_EQ(store->lap_count(), 5);
+
+  std::optional<size_t> bahrain =
+      store->find_race(2024, constants::BAHRAIN_CIRCUIT);
+  ASSERT_TRUE(bahrain);
+  EXPECT_EQ(store->races()[*bahrain].round, 1);
+  driver_laps laps = store->laps(*bahrain, constants::LANDO_NORRIS);
+  ASSERT_EQ(laps.size(), 1);
+  EXPECT_EQ(laps.position[0], 6);
+  EXPECT_EQ(laps.lap_time_ms[0], 90106);
+  EXPECT_TRUE(store->laps(*bahrain, constants::CHARLES_LECLERC).empty());
+  EXPECT_FALSE(store->find_race(2023, constants::BAHRAIN_CIRCUIT));
+}
+
+TEST_F(LapStoreTest, FindsLastRaceAtCircuit) {
+  std::optional<lap_store> store = lap_store::open(_path);
+  ASSERT_TRUE(store);
+  std::optional<size_t> monaco =
+      store->find_race(2024, constants::MONACO_CIRCUIT);
+  ASSERT_TRUE(monaco);
+  EXPECT_EQ(store->races()[*monaco].round, 9);
+  EXPECT_TRUE(store->laps(*monaco, constants::LANDO_NORRIS).empty());
+
+  driver_laps laps = store->laps(*monaco - 1, constants::LANDO_NORRIS);
+  EXPECT_EQ(
+      std::vector<int32_t>(laps.lap.begin(), laps.lap.end()),
+      (std::vector<int32_t>{1, 2}));
+  EXPECT_EQ(
+      std::vector<int32_t>(laps.lap_time_ms.begin(), laps.lap_time_ms.end()),
+      (std::vector<int32_t>{90102, 90202}));
+}
+
+TEST_F(LapStoreTest, ReplacesStoreWithoutChangingOpenMappings) {
+  std::optional<lap_store> store = lap_store::open(_path);
+  ASSERT_TRUE(store);
+  write_lap_store(
+      _path,
+      {make_lap(1, constants::BAHRAIN_CIRCUIT, constants::LANDO_NORRIS, 1, 4)});
+  EXPECT_EQ(store->lap_count(), 5);
+  EXPECT_FALSE(fs::exists(fs::path{_path} += ".tmp"));
+
+  std::optional<lap_store> replaced = lap_store::open(_path);
+  ASSERT_TRUE(replaced);
+  EXPECT_EQ(replaced->lap_count(), 1);
+}
+
+TEST_F(LapStoreTest, RejectsTruncatedFile) {
+  fs::resize_file(_path, fs::file_size(_path) - sizeof(int32_t));
+  EXPECT_FALSE(lap_store::open(_path));
+}
+
+} // namespace
+} // namespace f1_predict
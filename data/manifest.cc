@@ -0,0 +1,47 @@
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "data/results_manifest.h"
+
+ABSL_FLAG(
+    std::string, results_dir, "", "Path to directory containing race results.");
+ABSL_FLAG(
+    bool,
+    rebuild,
+    false,
+    "Re-read every race instead of reusing entries from the existing "
+    "manifest.");
+
+namespace fs = ::std::filesystem;
+
+using ::f1_predict::manifest_summary;
+using ::f1_predict::results_manifest;
+
+// Creates or refreshes the manifest at the root of a results tree.
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  const fs::path results_dir = absl::GetFlag(FLAGS_results_dir);
+  if (results_dir.empty() || !fs::is_directory(results_dir)) {
+    std::cerr << "Must specify an existing --results_dir." << std::endl;
+    return 1;
+  }
+
+  std::optional<results_manifest> previous;
+  if (!absl::GetFlag(FLAGS_rebuild)) {
+    previous = results_manifest::load(results_dir);
+  }
+  results_manifest manifest = results_manifest::build(
+      results_dir, previous ? &*previous : nullptr);
+  manifest.save();
+
+  manifest_summary summary = manifest.summarize();
+  std::cout << "Indexed " << summary.result_count << " results from "
+            << summary.race_count << " races over " << summary.season_count
+            << " seasons." << std::endl;
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "data/results_manifest.h"
+
+ABSL_FLAG(
+    std::string, results_dir, "", "Path to directory containing race results.");
+
+namespace fs = ::std::filesystem;
+
+using ::f1_predict::list_race_files;
+using ::f1_predict::load_races;
+using ::f1_predict::save_races;
+using ::f1_predict::update_manifest;
+
+// Rewrites every race stored as one file per driver into a single race file.
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  const fs::path results_dir = absl::GetFlag(FLAGS_results_dir);
+  if (results_dir.empty() || !fs::is_directory(results_dir)) {
+    std::cerr << "Must specify an existing --results_dir." << std::endl;
+    return 1;
+  }
+
+  std::vector<fs::path> migrated_races;
+  for (const fs::path& race_path : list_race_files(results_dir)) {
+    fs::path legacy_dir = race_path;
+    legacy_dir.replace_extension();
+    if (fs::is_directory(legacy_dir)) migrated_races.push_back(race_path);
+  }
+
+  std::vector<f1_predict::RaceResult> races = load_races(migrated_races);
+  std::vector<std::pair<fs::path, f1_predict::RaceResult>> race_files;
+  race_files.reserve(races.size());
+  int result_count = 0;
+  for (size_t i = 0; i < races.size(); ++i) {
+    result_count += races[i].results_size();
+    race_files.emplace_back(migrated_races[i], std::move(races[i]));
+  }
+  save_races(race_files);
+  update_manifest(results_dir, migrated_races);
+
+  std::cout << "Migrated " << result_count << " results into "
+            << migrated_races.size() << " race files." << std::endl;
+  return 0;
+}
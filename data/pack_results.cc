@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "data/results_pack.h"
+
+ABSL_FLAG(
+    std::string, results_dir, "", "Path to directory containing race results.");
+ABSL_FLAG(std::string, output_file, "", "Path to write the results pack to.");
+
+namespace fs = ::std::filesystem;
+
+using ::f1_predict::list_race_files;
+using ::f1_predict::load_races;
+using ::f1_predict::write_results_pack;
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+
+  const fs::path results_dir = absl::GetFlag(FLAGS_results_dir);
+  if (results_dir.empty() || !fs::is_directory(results_dir)) {
+    std::cerr << "Must specify an existing --results_dir." << std::endl;
+    return 1;
+  }
+  const fs::path output_file = absl::GetFlag(FLAGS_output_file);
+  if (output_file.empty()) {
+    std::cerr << "Must specify --output_file." << std::endl;
+    return 1;
+  }
+
+  std::vector<f1_predict::DriverResult> results;
+  for (f1_predict::RaceResult& race :
+       load_races(list_race_files(results_dir))) {
+    std::ranges::move(*race.mutable_results(), std::back_inserter(results));
+  }
+  if (results.empty()) {
+    std::cerr << "No results found under " << results_dir << std::endl;
+    return 1;
+  }
+
+  if (output_file.has_parent_path()) {
+    fs::create_directories(output_file.parent_path());
+  }
+  write_results_pack(output_file, results);
+  std::cout << "Packed " << results.size() << " results into " << output_file
+            << std::endl;
+  return 0;
+}
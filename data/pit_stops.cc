@@ -0,0 +1,148 @@
+#include "data/pit_stops.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/csv.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+constexpr std::string_view SEASON_COLUMN = "season";
+constexpr std::string_view CIRCUIT_COLUMN = "circuit";
+constexpr std::string_view DRIVER_COLUMN = "driver";
+constexpr std::string_view TEAM_COLUMN = "team";
+constexpr std::string_view STOP_COUNT_COLUMN = "stop_count";
+constexpr std::string_view TOTAL_TIME_COLUMN = "total_time_msec";
+constexpr std::string_view BEST_TIME_COLUMN = "best_time_msec";
+constexpr std::string_view TEAM_MEDIAN_TIME_COLUMN = "team_median_time_msec";
+
+auto entry_key(const pit_stop_summary& entry) {
+  return std::tuple{entry.race_season, entry.circuit, entry.driver};
+}
+
+// Column indices of a pit stop table.
+struct pit_stop_columns {
+  size_t season;
+  size_t circuit;
+  size_t driver;
+  size_t team;
+  size_t stop_count;
+  size_t total_time;
+  size_t best_time;
+  size_t team_median_time;
+};
+
+std::optional<pit_stop_columns> find_columns(const csv_file& file) {
+  pit_stop_columns columns;
+  if (!file.find_columns(
+          {{SEASON_COLUMN, &columns.season},
+           {CIRCUIT_COLUMN, &columns.circuit},
+           {DRIVER_COLUMN, &columns.driver},
+           {TEAM_COLUMN, &columns.team},
+           {STOP_COUNT_COLUMN, &columns.stop_count},
+           {TOTAL_TIME_COLUMN, &columns.total_time},
+           {BEST_TIME_COLUMN, &columns.best_time},
+           {TEAM_MEDIAN_TIME_COLUMN, &columns.team_median_time}})) {
+    return std::nullopt;
+  }
+  return columns;
+}
+
+std::optional<pit_stop_summary>
+parse_entry(const csv_row& row, const pit_stop_columns& columns) {
+  pit_stop_summary entry;
+  if (!parse_csv_number(row[columns.season], entry.race_season) ||
+      !constants::Circuit_Parse(
+          std::string{row[columns.circuit]}, &entry.circuit) ||
+      !constants::Driver_Parse(
+          std::string{row[columns.driver]}, &entry.driver) ||
+      !constants::Team_Parse(std::string{row[columns.team]}, &entry.team) ||
+      !parse_csv_number(row[columns.stop_count], entry.stop_count) ||
+      !parse_csv_number(row[columns.total_time], entry.total_time_ms) ||
+      !parse_csv_number(row[columns.best_time], entry.best_time_ms) ||
+      !parse_csv_number(
+          row[columns.team_median_time], entry.team_median_time_ms)) {
+    return std::nullopt;
+  }
+  return entry;
+}
+
+} // namespace
+
+std::optional<pit_stop_table> pit_stop_table::load(const fs::path& path) {
+  std::optional<csv_file> file = csv_file::open(path);
+  if (!file) return std::nullopt;
+  std::optional<pit_stop_columns> columns = find_columns(*file);
+  if (!columns) {
+    std::cerr << "Pit stop table " << path << " is missing columns."
+              << std::endl;
+    return std::nullopt;
+  }
+
+  std::vector<pit_stop_summary> entries;
+  entries.reserve(file->size());
+  for (size_t i = 0; i < file->size(); ++i) {
+    std::optional<pit_stop_summary> entry = parse_entry((*file)[i], *columns);
+    if (!entry) {
+      std::cerr << "Pit stop table " << path << " has a malformed row."
+                << std::endl;
+      return std::nullopt;
+    }
+    entries.push_back(*entry);
+  }
+  return pit_stop_table{std::move(entries)};
+}
+
+pit_stop_table::pit_stop_table(std::vector<pit_stop_summary> entries)
+    : _entries{std::move(entries)} {
+  std::ranges::stable_sort(_entries, {}, &entry_key);
+  // Keeps the last of each run of equal keys.
+  auto last = std::ranges::unique(
+      _entries.rbegin(), _entries.rend(), {}, &entry_key);
+  _entries.erase(_entries.begin(), last.begin().base());
+}
+
+void pit_stop_table::save(const fs::path& path) const {
+  save_csv_file(
+      path,
+      {SEASON_COLUMN,
+       CIRCUIT_COLUMN,
+       DRIVER_COLUMN,
+       TEAM_COLUMN,
+       STOP_COUNT_COLUMN,
+       TOTAL_TIME_COLUMN,
+       BEST_TIME_COLUMN,
+       TEAM_MEDIAN_TIME_COLUMN},
+      [&](std::ostream& out) {
+        for (const pit_stop_summary& entry : _entries) {
+          out << entry.race_season << ','
+              << constants::Circuit_Name(entry.circuit) << ','
+              << constants::Driver_Name(entry.driver) << ','
+              << constants::Team_Name(entry.team) << ',' << entry.stop_count
+              << ',' << entry.total_time_ms << ',' << entry.best_time_ms << ','
+              << entry.team_median_time_ms << '\n';
+        }
+      });
+}
+
+const pit_stop_summary* pit_stop_table::find(
+    int season, constants::Circuit circuit, constants::Driver driver) const {
+  auto key = std::tuple{season, circuit, driver};
+  auto itr = std::ranges::lower_bound(_entries, key, {}, &entry_key);
+  if (itr == _entries.end() || entry_key(*itr) != key) return nullptr;
+  return &*itr;
+}
+
+} // namespace f1_predict
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "data/constants.pb.h"
+
+namespace f1_predict {
+
+// Pit stop aggregates live in a CSV table beside the race results, with one
+// row per driver per race, keyed like the results by season, circuit and
+// driver. Durations are whole milliseconds.
+inline const std::string PIT_STOPS_FILE_NAME = "pit_stops.csv";
+
+struct pit_stop_summary {
+  int race_season;
+  constants::Circuit circuit;
+  constants::Driver driver;
+  constants::Team team;
+  int stop_count;
+  int total_time_ms;
+  int best_time_ms;
+  // Median duration of every stop the driver's team made in the race.
+  int team_median_time_ms;
+};
+
+class pit_stop_table {
+public:
+  // Reads the table at `path`. Returns nullopt and prints the reason to stderr
+  // if it cannot be read or parsed.
+  static std::optional<pit_stop_table>
+  load(const std::filesystem::path& path);
+
+  pit_stop_table() = default;
+  // Sorts the entries by season, circuit and driver. When several entries
+  // share all three, the last one wins.
+  explicit pit_stop_table(std::vector<pit_stop_summary> entries);
+
+  // Writes the table to `path`, replacing any existing file. Exits if the
+  // file cannot be written.
+  void save(const std::filesystem::path& path) const;
+
+  std::span<const pit_stop_summary> entries() const { return _entries; }
+  // Returns the driver's stops in the race, or null if there were none.
+  const pit_stop_summary* find(
+      int season, constants::Circuit circuit, constants::Driver driver) const;
+
+private:
+  std::vector<pit_stop_summary> _entries;
+};
+
+} // namespace f1_predict
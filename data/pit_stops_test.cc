@@ -0,0 +1,67 @@
+#include "data/pit_stops.h"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+pit_stop_summary make_summary(
+    constants::Circuit circuit, constants::Driver driver, int stop_count) {
+  return {
+      .race_season = 2024,
+      .circuit = circuit,
+      .driver = driver,
+      .team = constants::FERRARI,
+      .stop_count = stop_count,
+      .total_time_ms = 2400 * stop_count,
+      .best_time_ms = 2300,
+      .team_median_time_ms = 2450};
+}
+
+TEST(PitStopTableTest, KeepsLastEntryOfEachKey) {
+  pit_stop_table table{
+      {make_summary(constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 1),
+       make_summary(constants::BAHRAIN_CIRCUIT, constants::LANDO_NORRIS, 2),
+       make_summary(constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 3)}};
+  EXPECT_EQ(table.entries().size(), 2);
+  const pit_stop_summary* monaco = table.find(
+      2024, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS);
+  ASSERT_NE(monaco, nullptr);
+  EXPECT_EQ(monaco->stop_count, 3);
+  EXPECT_EQ(
+      table.find(2024, constants::MONACO_CIRCUIT, constants::MAX_VERSTAPPEN),
+      nullptr);
+  EXPECT_EQ(
+      table.find(2023, constants::BAHRAIN_CIRCUIT, constants::LANDO_NORRIS),
+      nullptr);
+}
+
+TEST(PitStopTableTest, SavesAndLoads) {
+  fs::path path = fs::path{::testing::TempDir()} / PIT_STOPS_FILE_NAME;
+  pit_stop_table{
+      {make_summary(constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 1),
+       make_summary(constants::MONACO_CIRCUIT, constants::CHARLES_LECLERC, 2)}}
+      .save(path);
+
+  std::optional<pit_stop_table> table = pit_stop_table::load(path);
+  ASSERT_TRUE(table);
+  ASSERT_EQ(table->entries().size(), 2);
+  const pit_stop_summary* leclerc = table->find(
+      2024, constants::MONACO_CIRCUIT, constants::CHARLES_LECLERC);
+  ASSERT_NE(leclerc, nullptr);
+  EXPECT_EQ(leclerc->team, constants::FERRARI);
+  EXPECT_EQ(leclerc->stop_count, 2);
+  EXPECT_EQ(leclerc->total_time_ms, 4800);
+  EXPECT_EQ(leclerc->best_time_ms, 2300);
+  EXPECT_EQ(leclerc->team_median_time_ms, 2450);
+}
+
+} // namespace
+} // namespace f1_predict
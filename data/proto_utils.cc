@@ -1,14 +1,35 @@
 #include "data/proto_utils.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "data/batch_io.h"
+#include "data/checksum.h"
+#include "data/constants.pb.h"
 #include "data/race_results.pb.h"
+#include "data/result_text_format.h"
 #include "google/protobuf/duration.pb.h"
-#include "google/protobuf/text_format.h"
+#include "google/protobuf/message.h"
 #include "google/protobuf/util/time_util.h"
 
 namespace f1_predict {
@@ -16,25 +37,21 @@ namespace {
 
 namespace fs = ::std::filesystem;
 
-using ::google::protobuf::TextFormat;
 using ::google::protobuf::util::TimeUtil;
 
+const std::string CACHE_EXTENSION = ".binpb";
+const fs::path RESULT_EXTENSION = ".textproto";
+
+fs::path& result_cache_dir() {
+  static fs::path cache_dir;
+  return cache_dir;
+}
+
 bool zero_duration(const google::protobuf::Duration& duration) {
   return duration.seconds() == 0 && duration.nanos() == 0;
 }
 
-} // namespace
-
-f1_predict::DriverResult load_result(const fs::path& file_path) {
-  std::ifstream stream(file_path);
-  std::stringstream data;
-  data << stream.rdbuf();
-  f1_predict::DriverResult result;
-  if (!TextFormat::ParseFromString(data.str(), &result)) {
-    std::cerr << "Failed to parse result from " << file_path << std::endl;
-    std::exit(1);
-  }
-
+void normalize_result(DriverResult& result) {
   if (result.has_qualification_time_1() &&
       zero_duration(result.qualification_time_1())) {
     result.clear_qualification_time_1();
@@ -58,18 +75,508 @@ f1_predict::DriverResult load_result(const fs::path& file_path) {
       zero_duration(result.finals_fastest_lap_time())) {
     result.clear_finals_fastest_lap_time();
   }
+}
 
-  return result;
+// Returns the cache entry for the current version of `file_path`. The entry
+// name covers the absolute path, size and modification time, so any change to
+// the source file produces a different entry.
+std::optional<fs::path> cache_entry_path(const fs::path& file_path) {
+  if (result_cache_dir().empty()) return std::nullopt;
+  std::error_code error;
+  fs::path absolute_path = fs::absolute(file_path, error);
+  if (error) return std::nullopt;
+  struct stat file_stat;
+  if (::stat(absolute_path.c_str(), &file_stat) != 0) return std::nullopt;
+  if (!S_ISREG(file_stat.st_mode)) return std::nullopt;
+
+  return result_cache_dir() /
+      absl::StrCat(
+             absl::Hex(fnv1a_hash(absolute_path.string()), absl::kZeroPad16),
+             "_",
+             file_stat.st_size,
+             "_",
+             file_stat.st_mtim.tv_sec,
+             ".",
+             file_stat.st_mtim.tv_nsec,
+             CACHE_EXTENSION);
 }
 
-void save_result(const fs::path& file_path, const DriverResult& results) {
-  std::string output;
-  if (!TextFormat::PrintToString(results, &output)) {
-    std::cerr << "Failed to print out race results.";
+void write_cache_entry(
+    const fs::path& entry_path, const google::protobuf::Message& message) {
+  // Write to a per-thread temporary file and rename it into place so
+  // concurrent loaders never observe a partially written entry.
+  fs::path temp_path = entry_path;
+  temp_path += absl::StrCat(
+      ".", std::hash<std::thread::id>{}(std::this_thread::get_id()), ".tmp");
+  {
+    std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+    if (!message.SerializeToOstream(&out)) return;
+  }
+  std::error_code error;
+  fs::rename(temp_path, entry_path, error);
+  if (error) fs::remove(temp_path, error);
+}
+
+void normalize_race(RaceResult& race) {
+  for (DriverResult& result : *race.mutable_results()) normalize_result(result);
+}
+
+// Parses each file into the matching caller-owned message. Returns whether
+// each file loaded.
+template <typename Message>
+std::vector<char> parse_text_protos(
+    std::span<const fs::path> file_paths,
+    std::span<Message* const> messages,
+    void (*normalize)(Message&),
+    int thread_count) {
+  std::vector<char> loaded(file_paths.size());
+  std::vector<std::optional<fs::path>> entry_paths(file_paths.size());
+  std::vector<fs::path> cached_paths;
+  std::vector<size_t> cached_indices;
+  for (size_t i = 0; i < file_paths.size(); ++i) {
+    entry_paths[i] = cache_entry_path(file_paths[i]);
+    if (entry_paths[i]) {
+      cached_paths.push_back(*entry_paths[i]);
+      cached_indices.push_back(i);
+    }
+  }
+  if (!cached_paths.empty()) {
+    std::vector<std::optional<std::string>> cached = read_files(cached_paths);
+    parallel_for(cached.size(), thread_count, [&](size_t j) {
+      size_t i = cached_indices[j];
+      loaded[i] = cached[j] && messages[i]->ParseFromString(*cached[j]);
+    });
+  }
+
+  std::vector<fs::path> text_paths;
+  std::vector<size_t> text_indices;
+  for (size_t i = 0; i < file_paths.size(); ++i) {
+    if (loaded[i]) continue;
+    text_paths.push_back(file_paths[i]);
+    text_indices.push_back(i);
+  }
+  std::vector<std::optional<std::string>> contents = read_files(text_paths);
+  parallel_for(contents.size(), thread_count, [&](size_t j) {
+    size_t i = text_indices[j];
+    if (!contents[j] || !parse_text_format(*contents[j], *messages[i])) {
+      return;
+    }
+    normalize(*messages[i]);
+    if (entry_paths[i]) write_cache_entry(*entry_paths[i], *messages[i]);
+    loaded[i] = true;
+  });
+  return loaded;
+}
+
+template <typename Message>
+std::vector<std::optional<Message>> load_text_protos(
+    std::span<const fs::path> file_paths,
+    void (*normalize)(Message&),
+    int thread_count) {
+  std::vector<Message> storage(file_paths.size());
+  std::vector<Message*> pointers;
+  pointers.reserve(storage.size());
+  for (Message& message : storage) pointers.push_back(&message);
+  std::vector<char> loaded =
+      parse_text_protos<Message>(file_paths, pointers, normalize, thread_count);
+
+  std::vector<std::optional<Message>> messages(file_paths.size());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    if (loaded[i]) messages[i] = std::move(storage[i]);
+  }
+  return messages;
+}
+
+// Writes each message whose printed form differs from its file's current
+// contents, or stages it in `transaction` if one is given.
+template <typename Message>
+save_summary save_text_protos(
+    std::span<const std::pair<fs::path, Message>> files,
+    void (*normalize)(Message&),
+    write_transaction* transaction) {
+  std::vector<fs::path> file_paths;
+  file_paths.reserve(files.size());
+  for (const auto& [file_path, message] : files) {
+    file_paths.push_back(file_path);
+  }
+  std::vector<std::optional<std::string>> existing = read_files(file_paths);
+
+  std::vector<std::string> printed(files.size());
+  parallel_for(files.size(), 0, [&](size_t i) {
+    printed[i] = print_text_format(files[i].second);
+  });
+
+  save_summary summary;
+  std::vector<size_t> written;
+  std::vector<std::pair<fs::path, std::string>> outputs;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!existing[i]) {
+      ++summary.added;
+    } else if (*existing[i] != printed[i]) {
+      ++summary.changed;
+    } else {
+      ++summary.unchanged;
+      continue;
+    }
+    written.push_back(i);
+    summary.written_paths.push_back(file_paths[i]);
+    outputs.emplace_back(file_paths[i], std::move(printed[i]));
+  }
+
+  std::vector<std::optional<fs::path>> stale_entry_paths;
+  stale_entry_paths.reserve(written.size());
+  for (size_t i : written) {
+    stale_entry_paths.push_back(cache_entry_path(file_paths[i]));
+  }
+  if (transaction) {
+    transaction->stage(outputs);
+  } else {
+    std::vector<fs::path> failed_paths = write_files(outputs);
+    if (!failed_paths.empty()) {
+      for (const fs::path& file_path : failed_paths) {
+        std::cerr << "Failed to write " << file_path << std::endl;
+      }
+      std::exit(1);
+    }
+  }
+  if (result_cache_dir().empty()) return summary;
+
+  // Cache entries of unchanged files are still valid. Staged files get no new
+  // entries, since their modification times are not known until they are
+  // renamed into place.
+  parallel_for(written.size(), 0, [&](size_t j) {
+    std::error_code error;
+    if (stale_entry_paths[j]) fs::remove(*stale_entry_paths[j], error);
+    if (transaction) return;
+    const auto& [file_path, message] = files[written[j]];
+    std::optional<fs::path> entry_path = cache_entry_path(file_path);
+    if (entry_path) {
+      Message normalized = message;
+      normalize(normalized);
+      write_cache_entry(*entry_path, normalized);
+    }
+  });
+  return summary;
+}
+
+// Per-driver results for a race used to live in a directory named after the
+// race file, minus its extension.
+fs::path legacy_race_dir(const fs::path& race_path) {
+  fs::path race_dir = race_path;
+  race_dir.replace_extension();
+  return race_dir;
+}
+
+// Saves races that were given no transaction through one per results
+// directory, so a crash between writing a race file and deleting the
+// old-layout files it replaces cannot lose results.
+save_summary save_races_in_own_transactions(
+    std::span<const std::pair<fs::path, RaceResult>> races) {
+  // Race files live in <results_dir>/<season>/, and the transactions work on
+  // absolute paths.
+  std::vector<fs::path> results_dirs;
+  std::vector<std::vector<std::pair<fs::path, RaceResult>>> groups;
+  std::map<fs::path, fs::path> given_paths;
+  for (const auto& [race_path, race] : races) {
+    fs::path absolute_path = fs::absolute(race_path).lexically_normal();
+    fs::path results_dir = absolute_path.parent_path().parent_path();
+    auto group = std::ranges::find(results_dirs, results_dir);
+    if (group == results_dirs.end()) {
+      results_dirs.push_back(results_dir);
+      groups.emplace_back();
+      group = results_dirs.end() - 1;
+    }
+    groups[group - results_dirs.begin()].emplace_back(absolute_path, race);
+    given_paths.emplace(std::move(absolute_path), race_path);
+  }
+
+  save_summary summary;
+  for (size_t i = 0; i < groups.size(); ++i) {
+    recover_write_transaction(results_dirs[i]);
+    write_transaction transaction{results_dirs[i]};
+    save_summary saved = save_races(groups[i], &transaction);
+    transaction.commit();
+    summary.added += saved.added;
+    summary.changed += saved.changed;
+    summary.unchanged += saved.unchanged;
+    for (const fs::path& written_path : saved.written_paths) {
+      summary.written_paths.push_back(given_paths.at(written_path));
+    }
+  }
+  return summary;
+}
+
+} // namespace
+
+void set_result_cache_dir(const fs::path& cache_dir) {
+  if (!cache_dir.empty()) fs::create_directories(cache_dir);
+  result_cache_dir() = cache_dir;
+}
+
+f1_predict::DriverResult load_result(const fs::path& file_path) {
+  std::optional<f1_predict::DriverResult> result = try_load_result(file_path);
+  if (!result) {
+    std::cerr << "Failed to parse result from " << file_path << std::endl;
     std::exit(1);
   }
-  std::ofstream out_stream{file_path};
-  out_stream << output;
+  return *std::move(result);
+}
+
+std::optional<f1_predict::DriverResult>
+try_load_result(const fs::path& file_path) {
+  return std::move(load_results({&file_path, 1}).front());
+}
+
+std::vector<std::optional<DriverResult>>
+load_results(std::span<const fs::path> file_paths, int thread_count) {
+  return load_text_protos<DriverResult>(
+      file_paths, &normalize_result, thread_count);
+}
+
+void save_result(const fs::path& file_path, const DriverResult& results) {
+  std::pair<fs::path, DriverResult> file{file_path, results};
+  save_results({&file, 1});
+}
+
+save_summary save_results(
+    std::span<const std::pair<fs::path, DriverResult>> results,
+    write_transaction* transaction) {
+  return save_text_protos(results, &normalize_result, transaction);
+}
+
+fs::path race_file_path(
+    const fs::path& results_dir, int season, constants::Circuit circuit) {
+  fs::path race_path =
+      results_dir / std::to_string(season) / constants::Circuit_Name(circuit);
+  race_path += RESULT_EXTENSION;
+  return race_path;
+}
+
+std::vector<fs::path> list_race_files(const fs::path& results_dir) {
+  std::set<fs::path> race_paths;
+  for (const fs::directory_entry& season :
+       fs::directory_iterator(results_dir)) {
+    if (!season.is_directory()) continue;
+    for (const fs::directory_entry& race : fs::directory_iterator(season)) {
+      if (race.is_directory()) {
+        fs::path race_path = race.path();
+        race_path += RESULT_EXTENSION;
+        race_paths.insert(std::move(race_path));
+      } else if (race.path().extension() == RESULT_EXTENSION) {
+        race_paths.insert(race.path());
+      }
+    }
+  }
+  return {race_paths.begin(), race_paths.end()};
+}
+
+bool race_exists(const fs::path& race_path) {
+  return fs::is_regular_file(race_path) ||
+      fs::is_directory(legacy_race_dir(race_path));
+}
+
+bool is_legacy_result_file(const fs::path& file_path) {
+  fs::path race_dir = file_path.parent_path();
+  constants::Circuit circuit;
+  int season = 0;
+  return file_path.extension() == RESULT_EXTENSION &&
+      constants::Circuit_Parse(race_dir.filename().string(), &circuit) &&
+      absl::SimpleAtoi(race_dir.parent_path().filename().string(), &season);
+}
+
+RaceResult load_race(const fs::path& race_path) {
+  return std::move(load_races({&race_path, 1}).front());
+}
+
+std::vector<RaceResult>
+load_races(std::span<const fs::path> race_paths, int thread_count) {
+  std::vector<std::optional<RaceResult>> loaded =
+      try_load_races(race_paths, thread_count);
+  std::vector<RaceResult> races;
+  races.reserve(loaded.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    if (!loaded[i]) {
+      std::cerr << "Failed to parse race from " << race_paths[i] << std::endl;
+      std::exit(1);
+    }
+    races.push_back(*std::move(loaded[i]));
+  }
+  return races;
+}
+
+std::vector<fs::path> race_source_files(const fs::path& race_path) {
+  std::vector<fs::path> source_files;
+  if (fs::is_regular_file(race_path)) source_files.push_back(race_path);
+
+  fs::path legacy_dir = legacy_race_dir(race_path);
+  if (!fs::is_directory(legacy_dir)) return source_files;
+
+  std::vector<fs::path> driver_paths;
+  for (const fs::directory_entry& entry : fs::directory_iterator(legacy_dir)) {
+    if (entry.path().extension() == RESULT_EXTENSION) {
+      driver_paths.push_back(entry.path());
+    }
+  }
+  std::ranges::sort(driver_paths);
+  std::ranges::move(driver_paths, std::back_inserter(source_files));
+  return source_files;
+}
+
+std::optional<RaceResult> try_load_race(const fs::path& race_path) {
+  return std::move(try_load_races({&race_path, 1}).front());
+}
+
+std::vector<std::optional<RaceResult>>
+try_load_races(std::span<const fs::path> race_paths, int thread_count) {
+  std::vector<RaceResult> storage(race_paths.size());
+  std::vector<RaceResult*> pointers;
+  pointers.reserve(storage.size());
+  for (RaceResult& race : storage) pointers.push_back(&race);
+  std::vector<size_t> failed =
+      load_races_into(race_paths, pointers, thread_count);
+
+  std::vector<std::optional<RaceResult>> races(race_paths.size());
+  for (size_t i = 0; i < races.size(); ++i) races[i] = std::move(storage[i]);
+  for (size_t i : failed) races[i].reset();
+  return races;
+}
+
+std::vector<size_t> load_races_into(
+    std::span<const fs::path> race_paths,
+    std::span<RaceResult* const> races,
+    int thread_count) {
+  // Gather the files of every race first so they can all be read in one
+  // batch per message type.
+  std::vector<fs::path> race_files;
+  std::vector<RaceResult*> race_file_messages;
+  std::vector<size_t> race_file_races;
+  std::vector<fs::path> driver_files;
+  std::vector<size_t> driver_file_races;
+  std::vector<char> failed(race_paths.size());
+  for (size_t i = 0; i < race_paths.size(); ++i) {
+    for (fs::path& source_file : race_source_files(race_paths[i])) {
+      if (source_file == race_paths[i]) {
+        race_files.push_back(std::move(source_file));
+        race_file_messages.push_back(races[i]);
+        race_file_races.push_back(i);
+      } else {
+        driver_files.push_back(std::move(source_file));
+        driver_file_races.push_back(i);
+      }
+    }
+  }
+  std::vector<char> loaded_races = parse_text_protos<RaceResult>(
+      race_files, race_file_messages, &normalize_race, thread_count);
+  for (size_t j = 0; j < race_files.size(); ++j) {
+    if (!loaded_races[j]) failed[race_file_races[j]] = true;
+  }
+
+  // Driver files are sorted within each race, and results already in the race
+  // file take precedence over them.
+  std::vector<std::optional<DriverResult>> loaded_results =
+      load_results(driver_files, thread_count);
+  for (size_t j = 0; j < driver_files.size(); ++j) {
+    size_t i = driver_file_races[j];
+    if (!loaded_results[j]) failed[i] = true;
+    if (failed[i]) continue;
+    RaceResult& race = *races[i];
+    bool has_driver = std::ranges::any_of(
+        race.results(), [&](const DriverResult& existing) {
+          return existing.driver() == loaded_results[j]->driver();
+        });
+    if (!has_driver) *race.add_results() = *std::move(loaded_results[j]);
+  }
+
+  std::vector<size_t> failed_races;
+  for (size_t i = 0; i < race_paths.size(); ++i) {
+    if (failed[i]) {
+      failed_races.push_back(i);
+      continue;
+    }
+    RaceResult& race = *races[i];
+    if (!race.results().empty()) {
+      if (!race.circuit()) race.set_circuit(race.results(0).circuit());
+      if (!race.race_season()) {
+        race.set_race_season(race.results(0).race_season());
+      }
+    }
+  }
+  return failed_races;
+}
+
+void save_race(const fs::path& race_path, const RaceResult& race) {
+  std::pair<fs::path, RaceResult> file{race_path, race};
+  save_races({&file, 1});
+}
+
+save_summary save_races(
+    std::span<const std::pair<fs::path, RaceResult>> races,
+    write_transaction* transaction) {
+  if (!transaction) return save_races_in_own_transactions(races);
+
+  std::vector<std::pair<fs::path, RaceResult>> sorted_races(
+      races.begin(), races.end());
+  for (auto& [race_path, race] : sorted_races) {
+    std::ranges::sort(
+        *race.mutable_results(),
+        [](const DriverResult& a, const DriverResult& b) {
+          return a.driver() < b.driver();
+        });
+  }
+  save_summary summary =
+      save_text_protos<RaceResult>(sorted_races, &normalize_race, transaction);
+
+  // An old-layout file is deleted only if it holds a driver the saved race
+  // has. Loading lets the race file take precedence over it, so deleting it
+  // cannot change what the race loads as, even if the caller built the race
+  // without loading it. Files that do not parse are kept.
+  std::vector<fs::path> legacy_files;
+  std::vector<size_t> legacy_file_races;
+  for (size_t i = 0; i < races.size(); ++i) {
+    for (fs::path& source_file : race_source_files(races[i].first)) {
+      if (source_file == races[i].first) continue;
+      legacy_files.push_back(std::move(source_file));
+      legacy_file_races.push_back(i);
+    }
+  }
+  std::vector<std::optional<DriverResult>> legacy_results =
+      load_results(legacy_files);
+  std::vector<char> removed(races.size());
+  for (size_t j = 0; j < legacy_files.size(); ++j) {
+    size_t i = legacy_file_races[j];
+    if (!legacy_results[j]) continue;
+    bool merged = std::ranges::any_of(
+        races[i].second.results(), [&](const DriverResult& result) {
+          return result.driver() == legacy_results[j]->driver();
+        });
+    if (!merged) continue;
+    transaction->remove_on_commit(legacy_files[j]);
+    removed[i] = true;
+  }
+
+  std::set<fs::path> written(
+      summary.written_paths.begin(), summary.written_paths.end());
+  for (size_t i = 0; i < races.size(); ++i) {
+    if (!removed[i]) continue;
+    const fs::path& race_path = races[i].first;
+    // Only goes once nothing else is left in it.
+    transaction->remove_on_commit(legacy_race_dir(race_path));
+    if (!written.contains(race_path)) {
+      --summary.unchanged;
+      ++summary.changed;
+      summary.written_paths.push_back(race_path);
+    }
+  }
+  return summary;
+}
+
+DriverResult& find_or_add_driver(RaceResult& race, constants::Driver driver) {
+  for (DriverResult& result : *race.mutable_results()) {
+    if (result.driver() == driver) return result;
+  }
+  DriverResult& result = *race.add_results();
+  result.set_driver(driver);
+  return result;
 }
 
 google::protobuf::Duration
@@ -1,17 +1,124 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
 
+#include "data/constants.pb.h"
 #include "data/race_results.pb.h"
+#include "data/write_transaction.h"
 #include "google/protobuf/duration.pb.h"
 
 namespace f1_predict {
 
+// Enables a cache of parsed results under `cache_dir`. Once set, load_result()
+// stores each parsed textproto as a binary proto keyed by the file's path, size
+// and modification time, and later loads of an unchanged file read the binary
+// copy instead. save_result() refreshes the entry for the file it writes. An
+// empty path disables the cache. Must not be called while loads are running.
+void set_result_cache_dir(const std::filesystem::path& cache_dir);
+
 DriverResult load_result(const std::filesystem::path& file_path);
+// Like load_result, but returns nullopt instead of exiting when the file cannot
+// be read or parsed. Safe to call concurrently.
+std::optional<DriverResult>
+try_load_result(const std::filesystem::path& file_path);
 void save_result(
     const std::filesystem::path& file_path, const DriverResult& results);
 
+// What a bulk save did with each file. Files whose contents would not change
+// are left untouched, so their modification times, and anything keyed on
+// them, stay valid.
+struct save_summary {
+  size_t added = 0;
+  size_t changed = 0;
+  size_t unchanged = 0;
+  // The files that were added or changed.
+  std::vector<std::filesystem::path> written_paths;
+};
+
+// Bulk versions of try_load_result and save_result. All files are read or
+// written in batches through batch_io, and parsed or printed on up to
+// `thread_count` threads, with 0 meaning one per core. save_results exits if
+// any file cannot be written. Given a transaction, the files are staged in it
+// instead, and are only replaced when the caller commits it.
+std::vector<std::optional<DriverResult>> load_results(
+    std::span<const std::filesystem::path> file_paths, int thread_count = 0);
+save_summary save_results(
+    std::span<const std::pair<std::filesystem::path, DriverResult>> results,
+    write_transaction* transaction = nullptr);
+
+// Results are stored as one RaceResult per race, in
+// <results_dir>/<season>/<CIRCUIT>.textproto. Older trees kept one DriverResult
+// per driver in <results_dir>/<season>/<CIRCUIT>/<DRIVER>.textproto; the race
+// functions below treat such a directory as part of the race file it is named
+// after.
+
+std::filesystem::path race_file_path(
+    const std::filesystem::path& results_dir,
+    int season,
+    constants::Circuit circuit);
+
+// Lists every race under `results_dir` in either layout, sorted by path.
+std::vector<std::filesystem::path>
+list_race_files(const std::filesystem::path& results_dir);
+
+bool race_exists(const std::filesystem::path& race_path);
+
+// Whether the path names a per-driver file in the old layout, which holds a
+// DriverResult rather than a race.
+bool is_legacy_result_file(const std::filesystem::path& file_path);
+
+// Returns the files load_race reads for the race, in the order it reads them:
+// the race file if it exists, then any old-layout per-driver files.
+std::vector<std::filesystem::path>
+race_source_files(const std::filesystem::path& race_path);
+
+// Loads the race file together with any per-driver files in the old layout.
+// Results from the race file take precedence. A race that does not exist yet
+// loads as an empty RaceResult.
+RaceResult load_race(const std::filesystem::path& race_path);
+// Like load_race, but returns nullopt instead of exiting when a file fails to
+// parse. Safe to call concurrently.
+std::optional<RaceResult>
+try_load_race(const std::filesystem::path& race_path);
+
+// Bulk versions of load_race and try_load_race that read the files of every
+// race in batches; see load_results.
+std::vector<RaceResult> load_races(
+    std::span<const std::filesystem::path> race_paths, int thread_count = 0);
+std::vector<std::optional<RaceResult>> try_load_races(
+    std::span<const std::filesystem::path> race_paths, int thread_count = 0);
+// Like try_load_races, but loads each race into the matching caller-owned
+// message. Returns the indices of the races that failed to load; their
+// messages are left in an unspecified state.
+std::vector<size_t> load_races_into(
+    std::span<const std::filesystem::path> race_paths,
+    std::span<RaceResult* const> races,
+    int thread_count = 0);
+
+// Saves the race with its results sorted by driver, then deletes the race's
+// old-layout files of drivers the race has, which load_race would only have
+// let the race file override. Other files, and the old-layout directory if
+// any remain in it, are kept.
+void save_race(const std::filesystem::path& race_path, const RaceResult& race);
+// Bulk version of save_race that writes every race file in batches. A race
+// counts as changed if old-layout files were deleted, even when its race file
+// was not rewritten. Given a transaction, the race files are staged in it and
+// the old-layout files deleted when it commits. Without one, the races are
+// saved in a transaction per results directory, which is committed before
+// returning.
+save_summary save_races(
+    std::span<const std::pair<std::filesystem::path, RaceResult>> races,
+    write_transaction* transaction = nullptr);
+
+// Returns the race's result for `driver`, adding an empty one if needed.
+DriverResult& find_or_add_driver(RaceResult& race, constants::Driver driver);
+
 google::protobuf::Duration
 to_proto_duration(std::chrono::milliseconds duration);
 
@@ -0,0 +1,107 @@
+#include "data/proto_utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "data/write_transaction.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+RaceResult make_race(constants::Circuit circuit, int final_position) {
+  RaceResult race;
+  race.set_race_season(2024);
+  race.set_circuit(circuit);
+  DriverResult& result = find_or_add_driver(race, constants::MAX_VERSTAPPEN);
+  result.set_race_season(2024);
+  result.set_circuit(circuit);
+  result.set_final_position(final_position);
+  return race;
+}
+
+TEST(SaveRacesTest, SkipsUnchangedFiles) {
+  fs::path results_dir = fs::path{::testing::TempDir()} / "save_races_test";
+  fs::remove_all(results_dir);
+  fs::create_directories(results_dir / "2024");
+  fs::path monaco =
+      race_file_path(results_dir, 2024, constants::MONACO_CIRCUIT);
+  fs::path bahrain =
+      race_file_path(results_dir, 2024, constants::BAHRAIN_CIRCUIT);
+
+  std::vector<std::pair<fs::path, RaceResult>> races = {
+      {monaco, make_race(constants::MONACO_CIRCUIT, 1)},
+      {bahrain, make_race(constants::BAHRAIN_CIRCUIT, 2)}};
+  save_summary summary = save_races(races);
+  EXPECT_EQ(summary.added, 2);
+  EXPECT_EQ(summary.changed, 0);
+  EXPECT_EQ(summary.unchanged, 0);
+  EXPECT_EQ(summary.written_paths, (std::vector<fs::path>{monaco, bahrain}));
+
+  fs::file_time_type monaco_written_at = fs::last_write_time(monaco);
+  races[1].second = make_race(constants::BAHRAIN_CIRCUIT, 3);
+  summary = save_races(races);
+  EXPECT_EQ(summary.added, 0);
+  EXPECT_EQ(summary.changed, 1);
+  EXPECT_EQ(summary.unchanged, 1);
+  EXPECT_EQ(summary.written_paths, (std::vector<fs::path>{bahrain}));
+  EXPECT_EQ(fs::last_write_time(monaco), monaco_written_at);
+  EXPECT_EQ(load_race(bahrain).results(0).final_position(), 3);
+}
+
+TEST(SaveRacesTest, DeletesOnlyMergedLegacyFiles) {
+  fs::path results_dir = fs::path{::testing::TempDir()} / "save_legacy_test";
+  fs::remove_all(results_dir);
+  fs::path race_path =
+      race_file_path(results_dir, 2024, constants::MONACO_CIRCUIT);
+  fs::path legacy_dir = results_dir / "2024/MONACO_CIRCUIT";
+  fs::create_directories(legacy_dir);
+  DriverResult verstappen;
+  verstappen.set_driver(constants::MAX_VERSTAPPEN);
+  verstappen.set_final_position(5);
+  save_result(legacy_dir / "MAX_VERSTAPPEN.textproto", verstappen);
+  DriverResult hamilton;
+  hamilton.set_driver(constants::LEWIS_HAMILTON);
+  hamilton.set_final_position(2);
+  save_result(legacy_dir / "LEWIS_HAMILTON.textproto", hamilton);
+  std::ofstream{legacy_dir / "notes.txt"} << "kept";
+
+  // A race built from scratch rather than loaded, with only one of the
+  // drivers.
+  save_race(race_path, make_race(constants::MONACO_CIRCUIT, 1));
+  EXPECT_FALSE(fs::exists(legacy_dir / "MAX_VERSTAPPEN.textproto"));
+  EXPECT_TRUE(fs::exists(legacy_dir / "LEWIS_HAMILTON.textproto"));
+  EXPECT_TRUE(fs::exists(legacy_dir / "notes.txt"));
+  EXPECT_FALSE(fs::exists(results_dir / WRITE_JOURNAL_NAME));
+  RaceResult race = load_race(race_path);
+  ASSERT_EQ(race.results_size(), 2);
+  EXPECT_EQ(race.results(0).final_position(), 1);
+  EXPECT_EQ(race.results(1).driver(), constants::LEWIS_HAMILTON);
+
+  fs::remove(legacy_dir / "notes.txt");
+  save_race(race_path, race);
+  EXPECT_FALSE(fs::exists(legacy_dir));
+  EXPECT_EQ(load_race(race_path).results_size(), 2);
+}
+
+TEST(RaceLayoutTest, RecognizesLegacyResultFiles) {
+  fs::path results_dir = "results";
+  EXPECT_TRUE(is_legacy_result_file(
+      results_dir / "2024/MONACO_CIRCUIT/MAX_VERSTAPPEN.textproto"));
+  EXPECT_FALSE(is_legacy_result_file(
+      race_file_path(results_dir, 2024, constants::MONACO_CIRCUIT)));
+  EXPECT_FALSE(is_legacy_result_file(
+      results_dir / "2024/MONACO_CIRCUIT/notes.txt"));
+  EXPECT_FALSE(is_legacy_result_file(
+      results_dir / "latest/MONACO_CIRCUIT/MAX_VERSTAPPEN.textproto"));
+}
+
+} // namespace
+} // namespace f1_predict
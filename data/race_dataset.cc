@@ -0,0 +1,41 @@
+#include "data/race_dataset.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+namespace fs = ::std::filesystem;
+
+std::vector<size_t> race_dataset::load_races(
+    std::span<const fs::path> race_paths, int thread_count) {
+  std::vector<RaceResult*> races;
+  races.reserve(race_paths.size());
+  for (size_t i = 0; i < race_paths.size(); ++i) {
+    races.push_back(&_races.emplace_back());
+  }
+  std::vector<size_t> failed =
+      load_races_into(race_paths, races, thread_count);
+
+  for (size_t i = 0; i < races.size(); ++i) {
+    if (std::ranges::binary_search(failed, i)) continue;
+    for (const DriverResult& result : races[i]->results()) {
+      _results.push_back(&result);
+    }
+  }
+  return failed;
+}
+
+DriverResult& race_dataset::add_result() {
+  DriverResult& result = _added_results.emplace_back();
+  _results.push_back(&result);
+  return result;
+}
+
+} // namespace f1_predict
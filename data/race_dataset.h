@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// Owns a set of driver results, kept in the races they were loaded with, so
+// later stages read them through pointers rather than copying them out.
+class race_dataset {
+public:
+  race_dataset() = default;
+
+  race_dataset(const race_dataset&) = delete;
+  race_dataset& operator=(const race_dataset&) = delete;
+  race_dataset(race_dataset&&) = default;
+  race_dataset& operator=(race_dataset&&) = default;
+
+  // Loads the given races and adds their results in order. Returns the
+  // indices of the races that failed to load, whose results are left out.
+  std::vector<size_t> load_races(
+      std::span<const std::filesystem::path> race_paths, int thread_count = 0);
+
+  // Adds an empty result to the dataset.
+  DriverResult& add_result();
+
+  std::span<const DriverResult* const> results() const { return _results; }
+  size_t size() const { return _results.size(); }
+
+private:
+  // Deques, so that adding to them keeps the results' addresses.
+  std::deque<RaceResult> _races;
+  std::deque<DriverResult> _added_results;
+  std::vector<const DriverResult*> _results;
+};
+
+} // namespace f1_predict
@@ -0,0 +1,46 @@
+#include "data/race_dataset.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+TEST(RaceDatasetTest, LoadsResultsAndReportsFailures) {
+  fs::path results_dir = fs::path{::testing::TempDir()} / "race_dataset_test";
+  fs::remove_all(results_dir);
+  fs::path race_path =
+      race_file_path(results_dir, 2024, constants::MONACO_CIRCUIT);
+  fs::create_directories(race_path.parent_path());
+  RaceResult race;
+  race.set_race_season(2024);
+  race.set_circuit(constants::MONACO_CIRCUIT);
+  find_or_add_driver(race, constants::CHARLES_LECLERC).set_final_position(1);
+  find_or_add_driver(race, constants::OSCAR_PIASTRI).set_final_position(2);
+  save_race(race_path, race);
+  fs::path broken_path =
+      race_file_path(results_dir, 2024, constants::BAHRAIN_CIRCUIT);
+  std::ofstream{broken_path} << "not a race";
+
+  race_dataset data;
+  std::vector<fs::path> race_paths = {broken_path, race_path};
+  EXPECT_EQ(data.load_races(race_paths), std::vector<size_t>{0});
+  data.add_result().set_driver(constants::MAX_VERSTAPPEN);
+
+  ASSERT_EQ(data.size(), 3);
+  EXPECT_EQ(data.results()[0]->driver(), constants::CHARLES_LECLERC);
+  EXPECT_EQ(data.results()[1]->final_position(), 2);
+  EXPECT_EQ(data.results()[2]->driver(), constants::MAX_VERSTAPPEN);
+}
+
+} // namespace
+} // namespace f1_predict
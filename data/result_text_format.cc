@@ -0,0 +1,478 @@
+#include "data/result_text_format.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/duration.pb.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/text_format.h"
+
+namespace f1_predict {
+namespace {
+
+using ::google::protobuf::Descriptor;
+using ::google::protobuf::Duration;
+using ::google::protobuf::EnumDescriptor;
+using ::google::protobuf::Message;
+using ::google::protobuf::TextFormat;
+
+// Enum names by number and numbers by name. When several names share a
+// number, the first one declared is printed, as in TextFormat.
+class enum_table {
+public:
+  explicit enum_table(const EnumDescriptor* descriptor) {
+    for (int i = 0; i < descriptor->value_count(); ++i) {
+      std::string_view name = descriptor->value(i)->name();
+      int number = descriptor->value(i)->number();
+      _numbers.emplace(name, number);
+      if (number < 0) continue;
+      if (static_cast<size_t>(number) >= _names.size()) {
+        _names.resize(number + 1);
+      }
+      if (_names[number].empty()) _names[number] = name;
+    }
+  }
+
+  // Returns an empty name for numbers the enum does not define.
+  std::string_view name(int number) const {
+    if (number < 0 || static_cast<size_t>(number) >= _names.size()) return {};
+    return _names[number];
+  }
+
+  bool number(std::string_view name, int& number) const {
+    auto found = _numbers.find(name);
+    if (found == _numbers.end()) return false;
+    number = found->second;
+    return true;
+  }
+
+private:
+  std::vector<std::string_view> _names;
+  std::unordered_map<std::string_view, int> _numbers;
+};
+
+const enum_table& circuit_table() {
+  static const enum_table table{constants::Circuit_descriptor()};
+  return table;
+}
+
+const enum_table& team_table() {
+  static const enum_table table{constants::Team_descriptor()};
+  return table;
+}
+
+const enum_table& driver_table() {
+  static const enum_table table{constants::Driver_descriptor()};
+  return table;
+}
+
+std::unordered_map<std::string_view, int>
+field_numbers(const Descriptor* descriptor) {
+  std::unordered_map<std::string_view, int> numbers;
+  for (int i = 0; i < descriptor->field_count(); ++i) {
+    numbers.emplace(
+        descriptor->field(i)->name(), descriptor->field(i)->number());
+  }
+  return numbers;
+}
+
+const std::unordered_map<std::string_view, int>& result_fields() {
+  static const std::unordered_map<std::string_view, int> fields =
+      field_numbers(DriverResult::descriptor());
+  return fields;
+}
+
+const std::unordered_map<std::string_view, int>& race_fields() {
+  static const std::unordered_map<std::string_view, int> fields =
+      field_numbers(RaceResult::descriptor());
+  return fields;
+}
+
+bool is_whitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+      c == '\f';
+}
+
+bool is_identifier_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+      (c >= '0' && c <= '9') || c == '_';
+}
+
+class text_reader {
+public:
+  explicit text_reader(std::string_view text) : _text{text} {}
+
+  bool at_end() {
+    skip_whitespace();
+    return _text.empty();
+  }
+
+  bool consume(char c) {
+    skip_whitespace();
+    if (!_text.starts_with(c)) return false;
+    _text.remove_prefix(1);
+    return true;
+  }
+
+  // Reads a field name, or returns an empty one if there is none.
+  std::string_view identifier() {
+    skip_whitespace();
+    if (_text.empty() || (_text.front() >= '0' && _text.front() <= '9')) {
+      return {};
+    }
+    size_t size = 0;
+    while (size < _text.size() && is_identifier_char(_text[size])) ++size;
+    return take(size);
+  }
+
+  // Reads an enum name or decimal number. The value must be followed by
+  // whitespace, a closing brace or the end of the input, leaving separators
+  // and the like to TextFormat. Returns an empty value otherwise.
+  std::string_view value() {
+    skip_whitespace();
+    size_t size = 0;
+    while (size < _text.size() &&
+           (is_identifier_char(_text[size]) || _text[size] == '-')) {
+      ++size;
+    }
+    if (size < _text.size() && !is_whitespace(_text[size]) &&
+        _text[size] != '}') {
+      return {};
+    }
+    return take(size);
+  }
+
+private:
+  void skip_whitespace() {
+    while (!_text.empty() && is_whitespace(_text.front())) {
+      _text.remove_prefix(1);
+    }
+  }
+
+  std::string_view take(size_t size) {
+    std::string_view token = _text.substr(0, size);
+    _text.remove_prefix(size);
+    return token;
+  }
+
+  std::string_view _text;
+};
+
+template <typename Int>
+bool parse_decimal(std::string_view token, Int& value) {
+  std::string_view digits = token.starts_with('-') ? token.substr(1) : token;
+  // TextFormat reads a leading zero as the start of an octal or hex number.
+  if (digits.size() > 1 && digits.front() == '0') return false;
+  const char* end = token.data() + token.size();
+  auto [ptr, error] = std::from_chars(token.data(), end, value);
+  return error == std::errc{} && ptr == end;
+}
+
+template <typename Int>
+bool parse_int(text_reader& reader, Int& value) {
+  return reader.consume(':') && parse_decimal(reader.value(), value);
+}
+
+bool parse_enum(text_reader& reader, const enum_table& table, int& number) {
+  return reader.consume(':') && table.number(reader.value(), number);
+}
+
+bool parse_duration(text_reader& reader, Duration& duration) {
+  if (!reader.consume('{')) return false;
+  bool has_seconds = false;
+  bool has_nanos = false;
+  while (!reader.consume('}')) {
+    std::string_view name = reader.identifier();
+    if (name == "seconds" && !has_seconds) {
+      int64_t seconds = 0;
+      if (!parse_int(reader, seconds)) return false;
+      duration.set_seconds(seconds);
+      has_seconds = true;
+    } else if (name == "nanos" && !has_nanos) {
+      int32_t nanos = 0;
+      if (!parse_int(reader, nanos)) return false;
+      duration.set_nanos(nanos);
+      has_nanos = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parse_result_field(text_reader& reader, int number, DriverResult& result) {
+  int value = 0;
+  switch (number) {
+  case DriverResult::kCircuitFieldNumber:
+    if (!parse_enum(reader, circuit_table(), value)) return false;
+    result.set_circuit(static_cast<constants::Circuit>(value));
+    return true;
+  case DriverResult::kRaceSeasonFieldNumber:
+    if (!parse_int(reader, value)) return false;
+    result.set_race_season(value);
+    return true;
+  case DriverResult::kTeamFieldNumber:
+    if (!parse_enum(reader, team_table(), value)) return false;
+    result.set_team(static_cast<constants::Team>(value));
+    return true;
+  case DriverResult::kDriverFieldNumber:
+    if (!parse_enum(reader, driver_table(), value)) return false;
+    result.set_driver(static_cast<constants::Driver>(value));
+    return true;
+  case DriverResult::kQualificationTime1FieldNumber:
+    return parse_duration(reader, *result.mutable_qualification_time_1());
+  case DriverResult::kQualificationTime2FieldNumber:
+    return parse_duration(reader, *result.mutable_qualification_time_2());
+  case DriverResult::kQualificationTime3FieldNumber:
+    return parse_duration(reader, *result.mutable_qualification_time_3());
+  case DriverResult::kQualificationFastestLapTimeFieldNumber:
+    return parse_duration(
+        reader, *result.mutable_qualification_fastest_lap_time());
+  case DriverResult::kStartingPositionFieldNumber:
+    if (!parse_int(reader, value)) return false;
+    result.set_starting_position(value);
+    return true;
+  case DriverResult::kFinalsTimeFieldNumber:
+    return parse_duration(reader, *result.mutable_finals_time());
+  case DriverResult::kFinalPositionFieldNumber:
+    if (!parse_int(reader, value)) return false;
+    result.set_final_position(value);
+    return true;
+  case DriverResult::kFinalsLapCountFieldNumber:
+    if (!parse_int(reader, value)) return false;
+    result.set_finals_lap_count(value);
+    return true;
+  case DriverResult::kFinalsFastestLapTimeFieldNumber:
+    return parse_duration(reader, *result.mutable_finals_fastest_lap_time());
+  }
+  return false;
+}
+
+// Parses fields up to the closing brace of a nested result, or to the end of
+// the input for a top-level one.
+bool parse_result_fields(
+    text_reader& reader, DriverResult& result, bool nested) {
+  uint32_t seen_fields = 0;
+  while (nested ? !reader.consume('}') : !reader.at_end()) {
+    auto field = result_fields().find(reader.identifier());
+    if (field == result_fields().end()) return false;
+    // Let TextFormat decide what a repeated field means.
+    uint32_t field_bit = uint32_t{1} << field->second;
+    if (seen_fields & field_bit) return false;
+    seen_fields |= field_bit;
+    if (!parse_result_field(reader, field->second, result)) return false;
+  }
+  return true;
+}
+
+bool parse_race_fields(text_reader& reader, RaceResult& race) {
+  bool has_circuit = false;
+  bool has_race_season = false;
+  while (!reader.at_end()) {
+    auto field = race_fields().find(reader.identifier());
+    if (field == race_fields().end()) return false;
+    int value = 0;
+    switch (field->second) {
+    case RaceResult::kCircuitFieldNumber:
+      if (has_circuit || !parse_enum(reader, circuit_table(), value)) {
+        return false;
+      }
+      race.set_circuit(static_cast<constants::Circuit>(value));
+      has_circuit = true;
+      break;
+    case RaceResult::kRaceSeasonFieldNumber:
+      if (has_race_season || !parse_int(reader, value)) return false;
+      race.set_race_season(value);
+      has_race_season = true;
+      break;
+    case RaceResult::kResultsFieldNumber:
+      if (!reader.consume('{') ||
+          !parse_result_fields(reader, *race.add_results(), true)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+bool has_unknown_fields(const Message& message) {
+  return !message.GetReflection()->GetUnknownFields(message).empty();
+}
+
+bool has_unknown_fields(const DriverResult& result) {
+  if (has_unknown_fields(static_cast<const Message&>(result))) return true;
+  for (const Duration* duration :
+       {&result.qualification_time_1(),
+        &result.qualification_time_2(),
+        &result.qualification_time_3(),
+        &result.qualification_fastest_lap_time(),
+        &result.finals_time(),
+        &result.finals_fastest_lap_time()}) {
+    if (has_unknown_fields(*duration)) return true;
+  }
+  return false;
+}
+
+bool has_unknown_fields(const RaceResult& race) {
+  if (has_unknown_fields(static_cast<const Message&>(race))) return true;
+  for (const DriverResult& result : race.results()) {
+    if (has_unknown_fields(result)) return true;
+  }
+  return false;
+}
+
+// Writes fields the way TextFormat does for proto3: zero scalars and absent
+// messages are skipped, and nested messages are indented by two spaces.
+class text_writer {
+public:
+  void int_field(std::string_view name, int64_t value) {
+    if (value == 0) return;
+    begin_field(name);
+    append_int(value);
+    _text += '\n';
+  }
+
+  void enum_field(std::string_view name, const enum_table& table, int value) {
+    if (value == 0) return;
+    begin_field(name);
+    std::string_view value_name = table.name(value);
+    if (value_name.empty()) {
+      append_int(value);
+    } else {
+      _text += value_name;
+    }
+    _text += '\n';
+  }
+
+  void duration_field(
+      std::string_view name, bool present, const Duration& duration) {
+    if (!present) return;
+    begin_message(name);
+    int_field("seconds", duration.seconds());
+    int_field("nanos", duration.nanos());
+    end_message();
+  }
+
+  void result_fields(const DriverResult& result) {
+    enum_field("circuit", circuit_table(), result.circuit());
+    int_field("race_season", result.race_season());
+    enum_field("team", team_table(), result.team());
+    enum_field("driver", driver_table(), result.driver());
+    duration_field(
+        "qualification_time_1",
+        result.has_qualification_time_1(),
+        result.qualification_time_1());
+    duration_field(
+        "qualification_time_2",
+        result.has_qualification_time_2(),
+        result.qualification_time_2());
+    duration_field(
+        "qualification_time_3",
+        result.has_qualification_time_3(),
+        result.qualification_time_3());
+    duration_field(
+        "qualification_fastest_lap_time",
+        result.has_qualification_fastest_lap_time(),
+        result.qualification_fastest_lap_time());
+    int_field("starting_position", result.starting_position());
+    duration_field(
+        "finals_time", result.has_finals_time(), result.finals_time());
+    int_field("final_position", result.final_position());
+    int_field("finals_lap_count", result.finals_lap_count());
+    duration_field(
+        "finals_fastest_lap_time",
+        result.has_finals_fastest_lap_time(),
+        result.finals_fastest_lap_time());
+  }
+
+  void begin_message(std::string_view name) {
+    _text.append(_indent, ' ');
+    _text += name;
+    _text += " {\n";
+    _indent += 2;
+  }
+
+  void end_message() {
+    _indent -= 2;
+    _text.append(_indent, ' ');
+    _text += "}\n";
+  }
+
+  std::string& text() { return _text; }
+
+private:
+  void begin_field(std::string_view name) {
+    _text.append(_indent, ' ');
+    _text += name;
+    _text += ": ";
+  }
+
+  void append_int(int64_t value) {
+    char buffer[24];
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    _text.append(buffer, end);
+  }
+
+  std::string _text;
+  size_t _indent = 0;
+};
+
+} // namespace
+
+bool parse_text_format(std::string_view text, DriverResult& result) {
+  result.Clear();
+  text_reader reader{text};
+  if (parse_result_fields(reader, result, false)) return true;
+  return TextFormat::ParseFromString(std::string{text}, &result);
+}
+
+bool parse_text_format(std::string_view text, RaceResult& race) {
+  race.Clear();
+  text_reader reader{text};
+  if (parse_race_fields(reader, race)) return true;
+  return TextFormat::ParseFromString(std::string{text}, &race);
+}
+
+std::string print_text_format(const DriverResult& result) {
+  std::string text;
+  if (has_unknown_fields(result)) {
+    TextFormat::PrintToString(result, &text);
+    return text;
+  }
+  text_writer writer;
+  writer.result_fields(result);
+  return std::move(writer.text());
+}
+
+std::string print_text_format(const RaceResult& race) {
+  std::string text;
+  if (has_unknown_fields(race)) {
+    TextFormat::PrintToString(race, &text);
+    return text;
+  }
+  text_writer writer;
+  writer.enum_field("circuit", circuit_table(), race.circuit());
+  writer.int_field("race_season", race.race_season());
+  for (const DriverResult& result : race.results()) {
+    writer.begin_message("results");
+    writer.result_fields(result);
+    writer.end_message();
+  }
+  return std::move(writer.text());
+}
+
+} // namespace f1_predict
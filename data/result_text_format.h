@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// Text format codec specialised for the result files.
+//
+// The parsers read the layout the printers write, plus any spacing, with a
+// hand-written parser and hand everything else (comments, octal numbers, enum
+// numbers, ...) to TextFormat, so they accept exactly what TextFormat accepts.
+// The printers produce the same bytes as TextFormat::PrintToString.
+bool parse_text_format(std::string_view text, DriverResult& result);
+bool parse_text_format(std::string_view text, RaceResult& race);
+
+std::string print_text_format(const DriverResult& result);
+std::string print_text_format(const RaceResult& race);
+
+} // namespace f1_predict
@@ -0,0 +1,161 @@
+#include "data/result_text_format.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "google/protobuf/duration.pb.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+using ::google::protobuf::Duration;
+using ::google::protobuf::TextFormat;
+
+// Mostly small, realistic values, with the occasional zero, negative, extreme
+// or undefined enum value.
+int32_t random_int(std::mt19937& random, int32_t typical_max) {
+  switch (std::uniform_int_distribution{0, 9}(random)) {
+  case 0:
+    return 0;
+  case 1:
+    return std::uniform_int_distribution<int32_t>{}(random) *
+        (random() % 2 ? 1 : -1);
+  default:
+    return std::uniform_int_distribution{1, typical_max}(random);
+  }
+}
+
+DriverResult random_result(std::mt19937& random) {
+  DriverResult result;
+  result.set_circuit(static_cast<constants::Circuit>(random_int(random, 80)));
+  result.set_race_season(random_int(random, 2030));
+  result.set_team(static_cast<constants::Team>(random_int(random, 130)));
+  result.set_driver(static_cast<constants::Driver>(random_int(random, 900)));
+  for (Duration* duration :
+       {result.mutable_qualification_time_1(),
+        result.mutable_qualification_time_2(),
+        result.mutable_qualification_time_3(),
+        result.mutable_qualification_fastest_lap_time(),
+        result.mutable_finals_time(),
+        result.mutable_finals_fastest_lap_time()}) {
+    if (random() % 4 == 0) continue;
+    duration->set_seconds(random_int(random, 9000));
+    duration->set_nanos(random_int(random, 999999999));
+  }
+  if (random() % 4 == 0) result.clear_qualification_time_1();
+  if (random() % 4 == 0) result.clear_finals_time();
+  result.set_starting_position(random_int(random, 30));
+  result.set_final_position(random_int(random, 30));
+  result.set_finals_lap_count(random_int(random, 80));
+  return result;
+}
+
+RaceResult random_race(std::mt19937& random) {
+  RaceResult race;
+  race.set_circuit(static_cast<constants::Circuit>(random_int(random, 80)));
+  race.set_race_season(random_int(random, 2030));
+  int result_count = random() % 4;
+  for (int i = 0; i < result_count; ++i) {
+    *race.add_results() = random_result(random);
+  }
+  return race;
+}
+
+// Returns `text` with a few random bytes replaced, inserted or removed.
+std::string mutate(std::mt19937& random, std::string text) {
+  const std::string_view alphabet = " \n{}:-#;0123456789_aeinrsCMO";
+  int mutation_count = 1 + random() % 3;
+  for (int i = 0; i < mutation_count && !text.empty(); ++i) {
+    size_t position = random() % text.size();
+    char c = alphabet[random() % alphabet.size()];
+    switch (random() % 3) {
+    case 0:
+      text[position] = c;
+      break;
+    case 1:
+      text.insert(position, 1, c);
+      break;
+    default:
+      text.erase(position, 1);
+      break;
+    }
+  }
+  return text;
+}
+
+template <typename Message>
+void expect_parses_like_text_format(std::string_view text) {
+  Message expected;
+  bool expected_ok = TextFormat::ParseFromString(std::string{text}, &expected);
+  Message parsed;
+  ASSERT_EQ(parse_text_format(text, parsed), expected_ok) << text;
+  if (expected_ok) {
+    EXPECT_EQ(parsed.SerializeAsString(), expected.SerializeAsString())
+        << text;
+  }
+}
+
+TEST(ResultTextFormatTest, PrintsLikeTextFormat) {
+  std::mt19937 random{42};
+  for (int i = 0; i < 1000; ++i) {
+    DriverResult result = random_result(random);
+    std::string expected;
+    ASSERT_TRUE(TextFormat::PrintToString(result, &expected));
+    ASSERT_EQ(print_text_format(result), expected);
+
+    RaceResult race = random_race(random);
+    ASSERT_TRUE(TextFormat::PrintToString(race, &expected));
+    ASSERT_EQ(print_text_format(race), expected);
+  }
+}
+
+TEST(ResultTextFormatTest, RoundTrips) {
+  std::mt19937 random{42};
+  for (int i = 0; i < 1000; ++i) {
+    RaceResult race = random_race(random);
+    RaceResult parsed;
+    ASSERT_TRUE(parse_text_format(print_text_format(race), parsed));
+    ASSERT_EQ(parsed.SerializeAsString(), race.SerializeAsString());
+  }
+}
+
+TEST(ResultTextFormatTest, ParsesLikeTextFormat) {
+  std::mt19937 random{42};
+  for (int i = 0; i < 3000; ++i) {
+    std::string result_text;
+    TextFormat::PrintToString(random_result(random), &result_text);
+    expect_parses_like_text_format<DriverResult>(mutate(random, result_text));
+
+    std::string race_text;
+    TextFormat::PrintToString(random_race(random), &race_text);
+    expect_parses_like_text_format<RaceResult>(mutate(random, race_text));
+  }
+}
+
+TEST(ResultTextFormatTest, FallsBackToTextFormat) {
+  expect_parses_like_text_format<DriverResult>(
+      "# comment\n"
+      "circuit: 17\n"
+      "race_season: 0x7e8;\n"
+      "qualification_time_1: < seconds: 010 >\n"
+      "driver: MAX_VERSTAPPEN");
+  expect_parses_like_text_format<DriverResult>(
+      "race_season: 1 race_season: 2");
+  expect_parses_like_text_format<DriverResult>("unknown_field: 1");
+
+  DriverResult result;
+  result.set_race_season(2024);
+  result.GetReflection()->MutableUnknownFields(&result)->AddVarint(100, 1);
+  std::string expected;
+  TextFormat::PrintToString(result, &expected);
+  EXPECT_EQ(print_text_format(result), expected);
+}
+
+} // namespace
+} // namespace f1_predict
@@ -0,0 +1,355 @@
+#include "data/results_manifest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "data/batch_io.h"
+#include "data/checksum.h"
+#include "data/constants.pb.h"
+#include "data/csv.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+constexpr std::string_view SEASON_COLUMN = "season";
+constexpr std::string_view CIRCUIT_COLUMN = "circuit";
+constexpr std::string_view DRIVER_COLUMN = "driver";
+constexpr std::string_view PATH_COLUMN = "path";
+constexpr std::string_view SIZE_COLUMN = "size";
+constexpr std::string_view HASH_COLUMN = "hash";
+
+// Column indices of a manifest file.
+struct manifest_columns {
+  size_t season;
+  size_t circuit;
+  size_t driver;
+  size_t path;
+  size_t size;
+  size_t hash;
+};
+
+std::optional<manifest_columns> find_columns(const csv_file& file) {
+  manifest_columns columns;
+  if (!file.find_columns(
+          {{SEASON_COLUMN, &columns.season},
+           {CIRCUIT_COLUMN, &columns.circuit},
+           {DRIVER_COLUMN, &columns.driver},
+           {PATH_COLUMN, &columns.path},
+           {SIZE_COLUMN, &columns.size},
+           {HASH_COLUMN, &columns.hash}})) {
+    return std::nullopt;
+  }
+  return columns;
+}
+
+std::optional<manifest_entry>
+parse_entry(const csv_row& row, const manifest_columns& columns) {
+  manifest_entry entry;
+  if (!row.has(columns.season) || !row.has(columns.circuit) ||
+      !row.has(columns.driver) || !row.has(columns.path) ||
+      !row.has(columns.size) || !row.has(columns.hash)) {
+    return std::nullopt;
+  }
+  if (!parse_csv_number(row[columns.season], entry.race_season) ||
+      !constants::Circuit_Parse(
+          std::string{row[columns.circuit]}, &entry.circuit) ||
+      !constants::Driver_Parse(
+          std::string{row[columns.driver]}, &entry.driver) ||
+      !parse_csv_number(row[columns.size], entry.size) ||
+      !parse_csv_number(row[columns.hash], entry.hash, 16)) {
+    return std::nullopt;
+  }
+  entry.path = row[columns.path];
+  return entry;
+}
+
+struct race_fingerprint {
+  uint64_t size = 0;
+  uint64_t hash = FNV_OFFSET_BASIS;
+};
+
+race_fingerprint
+fingerprint_files(std::span<const std::optional<std::string>> contents) {
+  race_fingerprint fingerprint;
+  for (const std::optional<std::string>& file_contents : contents) {
+    if (!file_contents) continue;
+    fingerprint.size += file_contents->size();
+    fingerprint.hash = fnv1a_hash(*file_contents, fingerprint.hash);
+  }
+  return fingerprint;
+}
+
+// Returns whether none of the source files changed since `written_at`, judged
+// by their modification times and total size.
+bool unchanged_since(
+    std::span<const fs::path> source_files,
+    fs::file_time_type written_at,
+    uint64_t size) {
+  uint64_t total_size = 0;
+  for (const fs::path& file_path : source_files) {
+    std::error_code error;
+    fs::file_time_type modified_at = fs::last_write_time(file_path, error);
+    if (error || modified_at >= written_at) return false;
+    total_size += fs::file_size(file_path, error);
+    if (error) return false;
+  }
+  return total_size == size;
+}
+
+auto entry_key(const manifest_entry& entry) {
+  return std::tie(entry.path, entry.driver);
+}
+
+} // namespace
+
+bool race_filter::matches_season(int season) const {
+  return season >= first_season && season <= last_season;
+}
+
+bool race_filter::matches(int season, constants::Circuit circuit) const {
+  if (!matches_season(season)) return false;
+  return circuits.empty() ||
+      std::ranges::find(circuits, circuit) != circuits.end();
+}
+
+bool race_filter::matches(const fs::path& race_path) const {
+  int season = 0;
+  constants::Circuit circuit;
+  return parse_csv_number(
+             race_path.parent_path().filename().string(), season) &&
+      constants::Circuit_Parse(race_path.stem().string(), &circuit) &&
+      matches(season, circuit);
+}
+
+bool parse_season_range(std::string_view text, race_filter& filter) {
+  size_t dash = text.find('-');
+  std::string_view first = text.substr(0, dash);
+  std::string_view last =
+      dash == std::string_view::npos ? first : text.substr(dash + 1);
+  if (first.empty() && last.empty()) return false;
+
+  race_filter parsed;
+  if (!first.empty() && !parse_csv_number(first, parsed.first_season)) {
+    return false;
+  }
+  if (!last.empty() && !parse_csv_number(last, parsed.last_season)) {
+    return false;
+  }
+  if (parsed.first_season > parsed.last_season) return false;
+  filter.first_season = parsed.first_season;
+  filter.last_season = parsed.last_season;
+  return true;
+}
+
+std::optional<results_manifest>
+results_manifest::load(const fs::path& results_dir) {
+  fs::path manifest_path = results_dir / MANIFEST_FILE_NAME;
+  std::error_code error;
+  fs::file_time_type written_at = fs::last_write_time(manifest_path, error);
+  if (error) return std::nullopt;
+  std::optional<csv_file> file = csv_file::open(manifest_path);
+  if (!file) return std::nullopt;
+  std::optional<manifest_columns> columns = find_columns(*file);
+  if (!columns) {
+    std::cerr << "Manifest " << manifest_path << " is missing columns."
+              << std::endl;
+    return std::nullopt;
+  }
+
+  results_manifest manifest{results_dir};
+  manifest._written_at = written_at;
+  manifest._entries.reserve(file->size());
+  for (size_t i = 0; i < file->size(); ++i) {
+    std::optional<manifest_entry> entry = parse_entry((*file)[i], *columns);
+    if (!entry) {
+      std::cerr << "Manifest " << manifest_path << " has a malformed row."
+                << std::endl;
+      return std::nullopt;
+    }
+    manifest._entries.push_back(*std::move(entry));
+  }
+  manifest.sort_entries();
+  return manifest;
+}
+
+results_manifest results_manifest::build(
+    const fs::path& results_dir, const results_manifest* previous) {
+  std::map<fs::path, std::span<const manifest_entry>> previous_races;
+  if (previous && previous->_written_at) {
+    std::span<const manifest_entry> entries = previous->_entries;
+    while (!entries.empty()) {
+      size_t race_size = 1;
+      while (race_size < entries.size() &&
+             entries[race_size].path == entries.front().path) {
+        ++race_size;
+      }
+      previous_races[entries.front().path] = entries.first(race_size);
+      entries = entries.subspan(race_size);
+    }
+  }
+
+  results_manifest manifest{results_dir};
+  std::vector<fs::path> changed_races;
+  for (const fs::path& race_path : list_race_files(results_dir)) {
+    auto previous_race =
+        previous_races.find(race_path.lexically_relative(results_dir));
+    if (previous_race != previous_races.end() &&
+        unchanged_since(
+            race_source_files(race_path),
+            *previous->_written_at,
+            previous_race->second.front().size)) {
+      manifest._entries.insert(
+          manifest._entries.end(),
+          previous_race->second.begin(),
+          previous_race->second.end());
+      continue;
+    }
+    changed_races.push_back(race_path);
+  }
+  manifest.add_races(changed_races);
+  manifest.sort_entries();
+  return manifest;
+}
+
+void results_manifest::save() const {
+  save_csv_file(
+      _results_dir / MANIFEST_FILE_NAME,
+      {SEASON_COLUMN,
+       CIRCUIT_COLUMN,
+       DRIVER_COLUMN,
+       PATH_COLUMN,
+       SIZE_COLUMN,
+       HASH_COLUMN},
+      [&](std::ostream& out) {
+        for (const manifest_entry& entry : _entries) {
+          out << entry.race_season << ','
+              << constants::Circuit_Name(entry.circuit) << ','
+              << constants::Driver_Name(entry.driver) << ','
+              << entry.path.generic_string() << ',' << entry.size << ','
+              << absl::StrCat(absl::Hex(entry.hash, absl::kZeroPad16))
+              << '\n';
+        }
+      });
+}
+
+void results_manifest::update_races(std::span<const fs::path> race_paths) {
+  std::set<fs::path> relative_paths;
+  for (const fs::path& race_path : race_paths) {
+    relative_paths.insert(race_path.lexically_relative(_results_dir));
+  }
+  std::erase_if(_entries, [&](const manifest_entry& entry) {
+    return relative_paths.contains(entry.path);
+  });
+  std::vector<fs::path> changed_races;
+  for (const fs::path& relative_path : relative_paths) {
+    changed_races.push_back(_results_dir / relative_path);
+  }
+  add_races(changed_races);
+  sort_entries();
+}
+
+std::vector<fs::path>
+results_manifest::race_files(const race_filter& filter) const {
+  std::vector<fs::path> race_paths;
+  for (const manifest_entry& entry : _entries) {
+    if (!filter.matches(entry.race_season, entry.circuit)) continue;
+    fs::path race_path = _results_dir / entry.path;
+    if (race_paths.empty() || race_paths.back() != race_path) {
+      race_paths.push_back(std::move(race_path));
+    }
+  }
+  return race_paths;
+}
+
+bool results_manifest::lists_every_race() const {
+  // Both lists are sorted by path.
+  return race_files() == list_race_files(_results_dir);
+}
+
+manifest_summary results_manifest::summarize(const race_filter& filter) const {
+  manifest_summary summary;
+  const manifest_entry* previous = nullptr;
+  std::set<int> seasons;
+  for (const manifest_entry& entry : _entries) {
+    if (!filter.matches(entry.race_season, entry.circuit)) continue;
+    ++summary.result_count;
+    if (previous == nullptr || previous->path != entry.path) {
+      ++summary.race_count;
+    }
+    seasons.insert(entry.race_season);
+    previous = &entry;
+  }
+  summary.season_count = seasons.size();
+  return summary;
+}
+
+void results_manifest::add_races(std::span<const fs::path> race_paths) {
+  std::vector<fs::path> source_files;
+  std::vector<size_t> race_source_ends;
+  for (const fs::path& race_path : race_paths) {
+    std::ranges::move(
+        race_source_files(race_path), std::back_inserter(source_files));
+    race_source_ends.push_back(source_files.size());
+  }
+  std::vector<std::optional<std::string>> contents = read_files(source_files);
+  std::vector<RaceResult> races = load_races(race_paths);
+
+  size_t source_begin = 0;
+  for (size_t i = 0; i < race_paths.size(); ++i) {
+    race_fingerprint fingerprint = fingerprint_files(
+        std::span{contents}.subspan(
+            source_begin, race_source_ends[i] - source_begin));
+    source_begin = race_source_ends[i];
+    fs::path relative_path = race_paths[i].lexically_relative(_results_dir);
+    for (const DriverResult& result : races[i].results()) {
+      _entries.push_back(
+          {.race_season = races[i].race_season(),
+           .circuit = races[i].circuit(),
+           .driver = result.driver(),
+           .path = relative_path,
+           .size = fingerprint.size,
+           .hash = fingerprint.hash});
+    }
+  }
+}
+
+void results_manifest::sort_entries() {
+  std::ranges::sort(_entries, [](const auto& a, const auto& b) {
+    return entry_key(a) < entry_key(b);
+  });
+}
+
+void update_manifest(
+    const fs::path& results_dir, std::span<const fs::path> race_paths) {
+  if (race_paths.empty() && fs::exists(results_dir / MANIFEST_FILE_NAME)) {
+    return;
+  }
+  std::optional<results_manifest> manifest =
+      results_manifest::load(results_dir);
+  if (manifest) {
+    manifest->update_races(race_paths);
+  } else {
+    manifest = results_manifest::build(results_dir);
+  }
+  manifest->save();
+}
+
+} // namespace f1_predict
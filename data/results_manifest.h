@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "data/constants.pb.h"
+
+namespace f1_predict {
+
+// The manifest is a CSV file at the root of a results tree with one row per
+// driver result. Each row names the race file holding the result, relative to
+// the results directory, together with the total size and FNV-1a hash of the
+// files load_race reads for that race. Tools use it to count and select races
+// without walking or parsing the tree.
+inline const std::string MANIFEST_FILE_NAME = "manifest.csv";
+
+struct manifest_entry {
+  int race_season;
+  constants::Circuit circuit;
+  constants::Driver driver;
+  std::filesystem::path path;
+  uint64_t size;
+  uint64_t hash;
+};
+
+// Selects races by an inclusive season range and, optionally, a set of
+// circuits. The default filter matches every race.
+struct race_filter {
+  int first_season = std::numeric_limits<int>::min();
+  int last_season = std::numeric_limits<int>::max();
+  // Empty matches every circuit.
+  std::vector<constants::Circuit> circuits;
+
+  bool matches_season(int season) const;
+  bool matches(int season, constants::Circuit circuit) const;
+  // Matches a path produced by race_file_path().
+  bool matches(const std::filesystem::path& race_path) const;
+};
+
+// Parses "2014-2024", "2014-", "-2010", or "2020" into the filter's season
+// range. Returns false if the text is not a valid range, or if it ends before
+// it starts.
+bool parse_season_range(std::string_view text, race_filter& filter);
+
+struct manifest_summary {
+  size_t result_count = 0;
+  size_t race_count = 0;
+  size_t season_count = 0;
+};
+
+class results_manifest {
+public:
+  // Reads the manifest stored in `results_dir`. Returns nullopt if there is
+  // none, and also prints the reason to stderr if it cannot be parsed.
+  static std::optional<results_manifest>
+  load(const std::filesystem::path& results_dir);
+
+  // Scans `results_dir` and lists every race in it. Races whose files are no
+  // newer than `previous` and still add up to the same size keep their entries
+  // instead of being read again.
+  static results_manifest build(
+      const std::filesystem::path& results_dir,
+      const results_manifest* previous = nullptr);
+
+  // Writes the manifest into its results directory, replacing the old one.
+  void save() const;
+
+  // Re-reads the given races and replaces their entries. Races that no longer
+  // exist are dropped.
+  void update_races(std::span<const std::filesystem::path> race_paths);
+
+  const std::filesystem::path& results_dir() const { return _results_dir; }
+  std::span<const manifest_entry> entries() const { return _entries; }
+
+  // Returns the full path of every race matching the filter, sorted by path.
+  std::vector<std::filesystem::path>
+  race_files(const race_filter& filter = {}) const;
+
+  manifest_summary summarize(const race_filter& filter = {}) const;
+
+  // Returns whether the manifest lists exactly the races in its results
+  // directory, so it is not stale. Lists the directory but reads no races.
+  bool lists_every_race() const;
+
+private:
+  explicit results_manifest(std::filesystem::path results_dir)
+      : _results_dir{std::move(results_dir)} {}
+
+  void add_races(std::span<const std::filesystem::path> race_paths);
+  void sort_entries();
+
+  std::filesystem::path _results_dir;
+  // Sorted by path, then driver.
+  std::vector<manifest_entry> _entries;
+  // Modification time of the manifest file this was loaded from.
+  std::optional<std::filesystem::file_time_type> _written_at;
+};
+
+// Brings the manifest in `results_dir` up to date after the given races were
+// written, creating it from a full scan if it does not exist yet. An existing
+// manifest is left untouched when no races were written.
+void update_manifest(
+    const std::filesystem::path& results_dir,
+    std::span<const std::filesystem::path> race_paths);
+
+} // namespace f1_predict
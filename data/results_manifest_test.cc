@@ -0,0 +1,150 @@
+#include "data/results_manifest.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+void write_race(
+    const fs::path& results_dir,
+    int season,
+    constants::Circuit circuit,
+    const std::vector<constants::Driver>& drivers) {
+  RaceResult race;
+  race.set_race_season(season);
+  race.set_circuit(circuit);
+  for (constants::Driver driver : drivers) {
+    DriverResult& result = find_or_add_driver(race, driver);
+    result.set_race_season(season);
+    result.set_circuit(circuit);
+    result.set_final_position(race.results_size());
+  }
+  fs::path race_path = race_file_path(results_dir, season, circuit);
+  fs::create_directories(race_path.parent_path());
+  save_race(race_path, race);
+}
+
+class ResultsManifestTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _results_dir = fs::path{::testing::TempDir()} / "results_manifest_test";
+    fs::remove_all(_results_dir);
+    write_race(
+        _results_dir,
+        2023,
+        constants::MONACO_CIRCUIT,
+        {constants::MAX_VERSTAPPEN, constants::LEWIS_HAMILTON});
+    write_race(
+        _results_dir,
+        2024,
+        constants::MONACO_CIRCUIT,
+        {constants::LANDO_NORRIS, constants::CHARLES_LECLERC});
+    write_race(
+        _results_dir,
+        2024,
+        constants::BAHRAIN_CIRCUIT,
+        {constants::MAX_VERSTAPPEN});
+  }
+
+  fs::path _results_dir;
+};
+
+TEST_F(ResultsManifestTest, RoundTripsThroughFile) {
+  results_manifest::build(_results_dir).save();
+
+  std::optional<results_manifest> manifest =
+      results_manifest::load(_results_dir);
+  ASSERT_TRUE(manifest.has_value());
+  ASSERT_EQ(manifest->entries().size(), 5);
+  EXPECT_EQ(
+      manifest->entries()[0].path, fs::path{"2023/MONACO_CIRCUIT.textproto"});
+  EXPECT_EQ(manifest->entries()[0].race_season, 2023);
+  EXPECT_EQ(manifest->entries()[0].circuit, constants::MONACO_CIRCUIT);
+  EXPECT_NE(manifest->entries()[0].hash, 0);
+
+  manifest_summary summary = manifest->summarize();
+  EXPECT_EQ(summary.result_count, 5);
+  EXPECT_EQ(summary.race_count, 3);
+  EXPECT_EQ(summary.season_count, 2);
+}
+
+TEST_F(ResultsManifestTest, DetectsStaleManifest) {
+  results_manifest::build(_results_dir).save();
+  std::optional<results_manifest> manifest =
+      results_manifest::load(_results_dir);
+  ASSERT_TRUE(manifest.has_value());
+  EXPECT_TRUE(manifest->lists_every_race());
+
+  write_race(
+      _results_dir, 2024, constants::SPAIN_CIRCUIT, {constants::LANDO_NORRIS});
+  EXPECT_FALSE(manifest->lists_every_race());
+  fs::remove(race_file_path(_results_dir, 2024, constants::SPAIN_CIRCUIT));
+  fs::remove(race_file_path(_results_dir, 2023, constants::MONACO_CIRCUIT));
+  EXPECT_FALSE(manifest->lists_every_race());
+}
+
+TEST_F(ResultsManifestTest, SelectsRacesByFilter) {
+  results_manifest manifest = results_manifest::build(_results_dir);
+
+  race_filter filter;
+  ASSERT_TRUE(parse_season_range("2024-", filter));
+  EXPECT_EQ(
+      manifest.race_files(filter),
+      (std::vector<fs::path>{
+          race_file_path(_results_dir, 2024, constants::BAHRAIN_CIRCUIT),
+          race_file_path(_results_dir, 2024, constants::MONACO_CIRCUIT)}));
+
+  filter.circuits = {constants::MONACO_CIRCUIT};
+  EXPECT_EQ(
+      manifest.race_files(filter),
+      (std::vector<fs::path>{
+          race_file_path(_results_dir, 2024, constants::MONACO_CIRCUIT)}));
+  EXPECT_TRUE(filter.matches(
+      race_file_path(_results_dir, 2024, constants::MONACO_CIRCUIT)));
+  EXPECT_FALSE(filter.matches(
+      race_file_path(_results_dir, 2023, constants::MONACO_CIRCUIT)));
+}
+
+TEST_F(ResultsManifestTest, UpdatesChangedRaces) {
+  update_manifest(_results_dir, {});
+  write_race(
+      _results_dir,
+      2024,
+      constants::BAHRAIN_CIRCUIT,
+      {constants::MAX_VERSTAPPEN, constants::LEWIS_HAMILTON});
+  fs::path race_path =
+      race_file_path(_results_dir, 2024, constants::BAHRAIN_CIRCUIT);
+  update_manifest(_results_dir, {&race_path, 1});
+
+  std::optional<results_manifest> manifest =
+      results_manifest::load(_results_dir);
+  ASSERT_TRUE(manifest.has_value());
+  EXPECT_EQ(manifest->summarize().result_count, 6);
+  EXPECT_EQ(
+      results_manifest::build(_results_dir).entries().size(),
+      manifest->entries().size());
+}
+
+TEST(ParseSeasonRangeTest, RejectsInvalidRanges) {
+  race_filter filter;
+  EXPECT_FALSE(parse_season_range("", filter));
+  EXPECT_FALSE(parse_season_range("-", filter));
+  EXPECT_FALSE(parse_season_range("20x4", filter));
+  EXPECT_FALSE(parse_season_range("2016-2014", filter));
+  ASSERT_TRUE(parse_season_range("2020", filter));
+  EXPECT_EQ(filter.first_season, 2020);
+  EXPECT_EQ(filter.last_season, 2020);
+}
+
+} // namespace
+} // namespace f1_predict
@@ -0,0 +1,239 @@
+#include "data/results_pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "data/checksum.h"
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "google/protobuf/duration.pb.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+constexpr int64_t NANOS_PER_SECOND = 1'000'000'000;
+
+int64_t to_nanos(const google::protobuf::Duration& duration) {
+  return duration.seconds() * NANOS_PER_SECOND + duration.nanos();
+}
+
+void set_duration(int64_t nanos, google::protobuf::Duration& duration) {
+  duration.set_seconds(nanos / NANOS_PER_SECOND);
+  duration.set_nanos(static_cast<int32_t>(nanos % NANOS_PER_SECOND));
+}
+
+std::string_view as_bytes(const void* data, size_t size) {
+  return {static_cast<const char*>(data), size};
+}
+
+} // namespace
+
+packed_result packed_result::from_proto(const DriverResult& result) {
+  return {
+      .race_season = result.race_season(),
+      .circuit = result.circuit(),
+      .team = result.team(),
+      .driver = result.driver(),
+      .starting_position = result.starting_position(),
+      .final_position = result.final_position(),
+      .finals_lap_count = result.finals_lap_count(),
+      .reserved = 0,
+      .qualification_time_1_ns = to_nanos(result.qualification_time_1()),
+      .qualification_time_2_ns = to_nanos(result.qualification_time_2()),
+      .qualification_time_3_ns = to_nanos(result.qualification_time_3()),
+      .qualification_fastest_lap_time_ns =
+          to_nanos(result.qualification_fastest_lap_time()),
+      .finals_time_ns = to_nanos(result.finals_time()),
+      .finals_fastest_lap_time_ns = to_nanos(result.finals_fastest_lap_time())};
+}
+
+DriverResult packed_result::to_proto() const {
+  DriverResult result;
+  to_proto(result);
+  return result;
+}
+
+void packed_result::to_proto(DriverResult& result) const {
+  result.set_race_season(race_season);
+  result.set_circuit(static_cast<constants::Circuit>(circuit));
+  result.set_team(static_cast<constants::Team>(team));
+  result.set_driver(static_cast<constants::Driver>(driver));
+  result.set_starting_position(starting_position);
+  result.set_final_position(final_position);
+  result.set_finals_lap_count(finals_lap_count);
+  if (qualification_time_1_ns) {
+    set_duration(
+        qualification_time_1_ns, *result.mutable_qualification_time_1());
+  }
+  if (qualification_time_2_ns) {
+    set_duration(
+        qualification_time_2_ns, *result.mutable_qualification_time_2());
+  }
+  if (qualification_time_3_ns) {
+    set_duration(
+        qualification_time_3_ns, *result.mutable_qualification_time_3());
+  }
+  if (qualification_fastest_lap_time_ns) {
+    set_duration(
+        qualification_fastest_lap_time_ns,
+        *result.mutable_qualification_fastest_lap_time());
+  }
+  if (finals_time_ns) {
+    set_duration(finals_time_ns, *result.mutable_finals_time());
+  }
+  if (finals_fastest_lap_time_ns) {
+    set_duration(
+        finals_fastest_lap_time_ns, *result.mutable_finals_fastest_lap_time());
+  }
+}
+
+std::optional<results_pack> results_pack::open(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open results pack " << path << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || file_stat.st_size < 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(results_pack_header)) {
+    std::cerr << "Results pack " << path << " is truncated." << std::endl;
+    ::close(fd);
+    return std::nullopt;
+  }
+  size_t size = file_stat.st_size;
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map results pack " << path << std::endl;
+    return std::nullopt;
+  }
+  results_pack pack{data, size};
+
+  const auto& header = *static_cast<const results_pack_header*>(data);
+  if (std::memcmp(header.magic, RESULTS_PACK_MAGIC, sizeof(header.magic))) {
+    std::cerr << path << " is not a results pack." << std::endl;
+    return std::nullopt;
+  }
+  if (header.version != RESULTS_PACK_VERSION) {
+    std::cerr << "Unsupported results pack version " << header.version
+              << " in " << path << std::endl;
+    return std::nullopt;
+  }
+  size_t expected_size = sizeof(results_pack_header) +
+      header.race_count * sizeof(results_pack_race) +
+      header.record_count * sizeof(packed_result);
+  if (size != expected_size) {
+    std::cerr << "Results pack " << path << " has " << size
+              << " bytes, expected " << expected_size << std::endl;
+    return std::nullopt;
+  }
+  const char* body = static_cast<const char*>(data) + sizeof(header);
+  if (fnv1a_hash(as_bytes(body, size - sizeof(header))) != header.checksum) {
+    std::cerr << "Results pack " << path << " failed checksum." << std::endl;
+    return std::nullopt;
+  }
+
+  pack._races = {
+      reinterpret_cast<const results_pack_race*>(body), header.race_count};
+  pack._records = {
+      reinterpret_cast<const packed_result*>(
+          body + header.race_count * sizeof(results_pack_race)),
+      header.record_count};
+  for (const results_pack_race& race : pack._races) {
+    if (race.first_record + race.record_count > header.record_count) {
+      std::cerr << "Results pack " << path << " has an out of range race."
+                << std::endl;
+      return std::nullopt;
+    }
+  }
+  return pack;
+}
+
+results_pack::results_pack(void* data, size_t size)
+    : _data{data}, _size{size} {}
+
+results_pack::results_pack(results_pack&& other) noexcept
+    : _data{std::exchange(other._data, nullptr)},
+      _size{std::exchange(other._size, 0)},
+      _races{std::exchange(other._races, {})},
+      _records{std::exchange(other._records, {})} {}
+
+results_pack& results_pack::operator=(results_pack&& other) noexcept {
+  if (this != &other) {
+    if (_data) ::munmap(_data, _size);
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _races = std::exchange(other._races, {});
+    _records = std::exchange(other._records, {});
+  }
+  return *this;
+}
+
+results_pack::~results_pack() {
+  if (_data) ::munmap(_data, _size);
+}
+
+void write_results_pack(
+    const fs::path& path, std::span<const DriverResult> results) {
+  std::vector<packed_result> records;
+  records.reserve(results.size());
+  for (const DriverResult& result : results) {
+    records.push_back(packed_result::from_proto(result));
+  }
+  std::ranges::sort(records, [](const auto& a, const auto& b) {
+    return std::tie(a.race_season, a.circuit, a.driver) <
+        std::tie(b.race_season, b.circuit, b.driver);
+  });
+
+  std::vector<results_pack_race> races;
+  for (uint32_t i = 0; i < records.size(); ++i) {
+    if (races.empty() || races.back().race_season != records[i].race_season ||
+        races.back().circuit != records[i].circuit) {
+      races.push_back(
+          {.race_season = records[i].race_season,
+           .circuit = records[i].circuit,
+           .first_record = i,
+           .record_count = 0});
+    }
+    ++races.back().record_count;
+  }
+
+  std::string_view races_bytes =
+      as_bytes(races.data(), races.size() * sizeof(results_pack_race));
+  std::string_view records_bytes =
+      as_bytes(records.data(), records.size() * sizeof(packed_result));
+  results_pack_header header{
+      .version = RESULTS_PACK_VERSION,
+      .race_count = static_cast<uint32_t>(races.size()),
+      .record_count = static_cast<uint32_t>(records.size()),
+      .reserved = 0,
+      .checksum = fnv1a_hash(records_bytes, fnv1a_hash(races_bytes))};
+  std::memcpy(header.magic, RESULTS_PACK_MAGIC, sizeof(header.magic));
+
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(races_bytes.data(), races_bytes.size());
+  out.write(records_bytes.data(), records_bytes.size());
+  if (!out) {
+    std::cerr << "Failed to write results pack " << path << std::endl;
+    std::exit(1);
+  }
+}
+
+} // namespace f1_predict
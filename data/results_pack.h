@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// A results pack is a single binary file holding every DriverResult from a
+// results tree. The layout is:
+//
+//   results_pack_header
+//   results_pack_race[race_count]
+//   packed_result[record_count]
+//
+// Races are sorted by (season, circuit) and records within a race by driver.
+// All integers are stored in host byte order.
+
+constexpr char RESULTS_PACK_MAGIC[8] = {'F', '1', 'R', 'P', 'A', 'C', 'K', 0};
+constexpr uint32_t RESULTS_PACK_VERSION = 1;
+
+struct results_pack_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t race_count;
+  uint32_t record_count;
+  uint32_t reserved;
+  // FNV-1a hash of everything following the header.
+  uint64_t checksum;
+};
+
+struct results_pack_race {
+  int32_t race_season;
+  int32_t circuit;
+  uint32_t first_record;
+  uint32_t record_count;
+};
+
+// Fixed-layout copy of a DriverResult. Durations are stored as nanoseconds,
+// with 0 meaning the field is unset just like load_result() normalizes them.
+struct packed_result {
+  int32_t race_season;
+  int32_t circuit;
+  int32_t team;
+  int32_t driver;
+  int32_t starting_position;
+  int32_t final_position;
+  int32_t finals_lap_count;
+  int32_t reserved;
+  int64_t qualification_time_1_ns;
+  int64_t qualification_time_2_ns;
+  int64_t qualification_time_3_ns;
+  int64_t qualification_fastest_lap_time_ns;
+  int64_t finals_time_ns;
+  int64_t finals_fastest_lap_time_ns;
+
+  static packed_result from_proto(const DriverResult& result);
+  DriverResult to_proto() const;
+  // Fills in an existing, empty result.
+  void to_proto(DriverResult& result) const;
+};
+
+static_assert(sizeof(results_pack_header) == 32);
+static_assert(sizeof(results_pack_race) == 16);
+static_assert(sizeof(packed_result) == 80);
+
+// Read-only, memory-mapped view of a results pack file.
+class results_pack {
+public:
+  // Maps the given file and validates its header and checksum. Returns nullopt
+  // and prints the reason to stderr if the file is not a valid pack.
+  static std::optional<results_pack> open(const std::filesystem::path& path);
+
+  results_pack(const results_pack&) = delete;
+  results_pack& operator=(const results_pack&) = delete;
+  results_pack(results_pack&& other) noexcept;
+  results_pack& operator=(results_pack&& other) noexcept;
+  ~results_pack();
+
+  std::span<const results_pack_race> races() const { return _races; }
+  std::span<const packed_result> records() const { return _records; }
+  std::span<const packed_result>
+  race_records(const results_pack_race& race) const {
+    return _records.subspan(race.first_record, race.record_count);
+  }
+
+private:
+  results_pack(void* data, size_t size);
+
+  void* _data = nullptr;
+  size_t _size = 0;
+  std::span<const results_pack_race> _races;
+  std::span<const packed_result> _records;
+};
+
+// Packs the given results into a file at `path`, replacing any existing file.
+void write_results_pack(
+    const std::filesystem::path& path, std::span<const DriverResult> results);
+
+} // namespace f1_predict
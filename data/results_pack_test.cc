@@ -0,0 +1,82 @@
+#include "data/results_pack.h"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "data/test_results.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+DriverResult make_result(
+    int season,
+    constants::Circuit circuit,
+    constants::Driver driver,
+    int final_position) {
+  return make_test_result(season, circuit, driver, final_position, 83516);
+}
+
+class ResultsPackTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _path = fs::path{::testing::TempDir()} / "results_pack_test.pack";
+    fs::remove(_path);
+  }
+
+  fs::path _path;
+};
+
+TEST_F(ResultsPackTest, RoundTripsResults) {
+  std::vector<DriverResult> results = {
+      make_result(2024, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 4),
+      make_result(2023, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 9),
+      make_result(
+          2024, constants::MONACO_CIRCUIT, constants::CHARLES_LECLERC, 1)};
+  write_results_pack(_path, results);
+
+  std::optional<results_pack> pack = results_pack::open(_path);
+  ASSERT_TRUE(pack.has_value());
+  ASSERT_EQ(pack->races().size(), 2);
+  ASSERT_EQ(pack->records().size(), 3);
+
+  EXPECT_EQ(pack->races()[0].race_season, 2023);
+  EXPECT_EQ(pack->races()[0].record_count, 1);
+  EXPECT_EQ(pack->races()[1].race_season, 2024);
+  EXPECT_EQ(pack->races()[1].record_count, 2);
+
+  auto race = pack->race_records(pack->races()[1]);
+  ASSERT_EQ(race.size(), 2);
+  EXPECT_EQ(race[0].driver, constants::CHARLES_LECLERC);
+  EXPECT_EQ(race[1].driver, constants::LANDO_NORRIS);
+
+  DriverResult round_trip = race[1].to_proto();
+  EXPECT_EQ(round_trip.SerializeAsString(), results[0].SerializeAsString());
+  EXPECT_FALSE(round_trip.has_qualification_time_2());
+}
+
+TEST_F(ResultsPackTest, RejectsCorruptedPack) {
+  std::vector<DriverResult> results = {
+      make_result(2024, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 4)};
+  write_results_pack(_path, results);
+  {
+    std::fstream file{
+        _path, std::ios::in | std::ios::out | std::ios::binary};
+    file.seekp(-1, std::ios::end);
+    file.put('\x7f');
+  }
+  EXPECT_FALSE(results_pack::open(_path).has_value());
+}
+
+TEST_F(ResultsPackTest, RejectsMissingFile) {
+  EXPECT_FALSE(results_pack::open(_path).has_value());
+}
+
+} // namespace
+} // namespace f1_predict
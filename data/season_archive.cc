@@ -0,0 +1,561 @@
+#include "data/season_archive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "data/checksum.h"
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "google/protobuf/duration.pb.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+using ::google::protobuf::Duration;
+
+constexpr int64_t NANOS_PER_SECOND = 1'000'000'000;
+
+constexpr size_t RACE_COLUMN_COUNT = 2;
+
+bool is_race_column(archive_column column) {
+  return static_cast<size_t>(column) < RACE_COLUMN_COUNT;
+}
+
+int64_t to_nanos(bool present, const Duration& duration) {
+  return present ? duration.seconds() * NANOS_PER_SECOND + duration.nanos()
+                 : 0;
+}
+
+void set_duration(int64_t nanos, Duration& duration) {
+  duration.set_seconds(nanos / NANOS_PER_SECOND);
+  duration.set_nanos(static_cast<int32_t>(nanos % NANOS_PER_SECOND));
+}
+
+// Returns the number of bits needed to store values in [0, range].
+uint8_t bits_for(uint64_t range) { return std::bit_width(range); }
+
+class bit_writer {
+public:
+  explicit bit_writer(std::string& bytes) : _bytes{bytes} {}
+
+  void write(uint64_t value, int width) {
+    for (int written = 0; written < width;) {
+      if (_used == 8) {
+        _bytes.push_back(0);
+        _used = 0;
+      }
+      int take = std::min(width - written, 8 - _used);
+      uint64_t bits = (value >> written) & ((uint64_t{1} << take) - 1);
+      _bytes.back() = static_cast<char>(
+          static_cast<uint8_t>(_bytes.back()) | (bits << _used));
+      _used += take;
+      written += take;
+    }
+  }
+
+private:
+  std::string& _bytes;
+  int _used = 8;
+};
+
+class bit_reader {
+public:
+  explicit bit_reader(std::string_view bytes) : _bytes{bytes} {}
+
+  // Returns false if the values would run past the end of the bytes.
+  bool has(size_t count, int width) const {
+    return _position + count * width <= _bytes.size() * 8;
+  }
+
+  uint64_t read(int width) {
+    uint64_t value = 0;
+    for (int read = 0; read < width;) {
+      size_t byte = _position / 8;
+      int offset = _position % 8;
+      int take = std::min(width - read, 8 - offset);
+      uint64_t bits = (static_cast<uint8_t>(_bytes[byte]) >> offset) &
+          ((uint64_t{1} << take) - 1);
+      value |= bits << read;
+      _position += take;
+      read += take;
+    }
+    return value;
+  }
+
+private:
+  std::string_view _bytes;
+  size_t _position = 0;
+};
+
+struct encoded_column {
+  season_archive_column info{};
+  std::string bytes;
+};
+
+encoded_column encode_bit_packed(std::span<const int64_t> values) {
+  encoded_column column;
+  column.info.encoding = archive_encoding::bit_packed;
+  column.info.unit = 1;
+  if (values.empty()) return column;
+  auto [min, max] = std::ranges::minmax(values);
+  column.info.min = min;
+  column.info.max = max;
+  column.info.bit_width = bits_for(max - min);
+  bit_writer writer{column.bytes};
+  for (int64_t value : values) writer.write(value - min, column.info.bit_width);
+  return column;
+}
+
+encoded_column encode_dictionary(std::span<const int64_t> values) {
+  std::vector<int32_t> dictionary(values.begin(), values.end());
+  std::ranges::sort(dictionary);
+  dictionary.erase(std::ranges::unique(dictionary).begin(), dictionary.end());
+
+  encoded_column column;
+  column.info.encoding = archive_encoding::dictionary;
+  column.info.unit = 1;
+  if (!dictionary.empty()) {
+    column.info.min = dictionary.front();
+    column.info.max = dictionary.back();
+    column.info.bit_width = bits_for(dictionary.size() - 1);
+  }
+  uint32_t dictionary_size = dictionary.size();
+  column.bytes.append(
+      reinterpret_cast<const char*>(&dictionary_size), sizeof(uint32_t));
+  column.bytes.append(
+      reinterpret_cast<const char*>(dictionary.data()),
+      dictionary.size() * sizeof(int32_t));
+  bit_writer writer{column.bytes};
+  for (int64_t value : values) {
+    writer.write(
+        std::ranges::lower_bound(dictionary, value) - dictionary.begin(),
+        column.info.bit_width);
+  }
+  return column;
+}
+
+// `race_ends` holds the index one past each race's last record.
+encoded_column encode_race_delta(
+    std::span<const int64_t> values, std::span<const size_t> race_ends) {
+  encoded_column column;
+  column.info.encoding = archive_encoding::race_delta;
+  column.info.unit = 1;
+
+  std::vector<int64_t> race_bases;
+  size_t race_begin = 0;
+  bool has_values = false;
+  for (size_t race_end : race_ends) {
+    int64_t base = 0;
+    for (size_t i = race_begin; i < race_end; ++i) {
+      if (values[i] == 0) continue;
+      base = base == 0 ? values[i] : std::min(base, values[i]);
+    }
+    race_bases.push_back(base);
+    if (base != 0) {
+      column.info.min = has_values ? std::min(column.info.min, base) : base;
+      has_values = true;
+    }
+    race_begin = race_end;
+  }
+  for (int64_t value : values) {
+    if (value != 0) column.info.max = std::max(column.info.max, value);
+  }
+  if (has_values) {
+    // Store times in their largest common unit, e.g. whole milliseconds.
+    uint64_t unit = 0;
+    for (int64_t value : values) {
+      if (value != 0) unit = std::gcd(unit, value - column.info.min);
+    }
+    column.info.unit = unit == 0 ? 1 : unit;
+  }
+
+  auto scaled = [&](int64_t nanos, int64_t base) -> uint64_t {
+    return (nanos - base) / column.info.unit;
+  };
+  uint64_t base_range = 0;
+  uint64_t delta_range = 0;
+  race_begin = 0;
+  for (size_t race = 0; race < race_ends.size(); ++race) {
+    if (race_bases[race] == 0) continue;
+    base_range =
+        std::max(base_range, scaled(race_bases[race], column.info.min));
+    for (size_t i = race_begin; i < race_ends[race]; ++i) {
+      if (values[i] == 0) continue;
+      delta_range =
+          std::max(delta_range, scaled(values[i], race_bases[race]) + 1);
+    }
+    race_begin = race_ends[race];
+  }
+  column.info.base_bit_width = bits_for(base_range);
+  column.info.bit_width = bits_for(delta_range);
+
+  bit_writer writer{column.bytes};
+  for (int64_t base : race_bases) {
+    writer.write(
+        base == 0 ? 0 : scaled(base, column.info.min),
+        column.info.base_bit_width);
+  }
+  race_begin = 0;
+  for (size_t race = 0; race < race_ends.size(); ++race) {
+    for (size_t i = race_begin; i < race_ends[race]; ++i) {
+      writer.write(
+          values[i] == 0 ? 0 : scaled(values[i], race_bases[race]) + 1,
+          column.info.bit_width);
+    }
+    race_begin = race_ends[race];
+  }
+  return column;
+}
+
+std::string_view as_bytes(const void* data, size_t size) {
+  return {static_cast<const char*>(data), size};
+}
+
+} // namespace
+
+std::optional<season_archive> season_archive::open(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open season archive " << path << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || file_stat.st_size < 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(season_archive_trailer)) {
+    std::cerr << "Season archive " << path << " is truncated." << std::endl;
+    ::close(fd);
+    return std::nullopt;
+  }
+  size_t size = file_stat.st_size;
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map season archive " << path << std::endl;
+    return std::nullopt;
+  }
+  season_archive archive{data, size};
+  archive._path = path;
+
+  const char* bytes = static_cast<const char*>(data);
+  season_archive_trailer& trailer = archive._trailer;
+  std::memcpy(&trailer, bytes + size - sizeof(trailer), sizeof(trailer));
+  if (std::memcmp(trailer.magic, SEASON_ARCHIVE_MAGIC, sizeof(trailer.magic))) {
+    std::cerr << path << " is not a season archive." << std::endl;
+    return std::nullopt;
+  }
+  if (trailer.version != SEASON_ARCHIVE_VERSION) {
+    std::cerr << "Unsupported season archive version " << trailer.version
+              << " in " << path << std::endl;
+    return std::nullopt;
+  }
+  size_t directory_size = sizeof(season_archive_column) * ARCHIVE_COLUMN_COUNT;
+  if (trailer.column_count != ARCHIVE_COLUMN_COUNT ||
+      size < sizeof(trailer) + directory_size) {
+    std::cerr << "Season archive " << path << " has a bad column directory."
+              << std::endl;
+    return std::nullopt;
+  }
+  size_t data_size = size - sizeof(trailer) - directory_size;
+  std::memcpy(archive._columns.data(), bytes + data_size, directory_size);
+  for (const season_archive_column& column : archive._columns) {
+    if (column.offset > data_size || column.size > data_size - column.offset ||
+        column.bit_width > 64 || column.base_bit_width > 64 ||
+        column.unit <= 0) {
+      std::cerr << "Season archive " << path << " has an out of range column."
+                << std::endl;
+      return std::nullopt;
+    }
+  }
+  return archive;
+}
+
+season_archive::season_archive(void* data, size_t size)
+    : _data{data}, _size{size} {}
+
+season_archive::season_archive(season_archive&& other) noexcept
+    : _data{std::exchange(other._data, nullptr)},
+      _size{std::exchange(other._size, 0)},
+      _path{std::move(other._path)},
+      _trailer{other._trailer},
+      _columns{other._columns} {}
+
+season_archive& season_archive::operator=(season_archive&& other) noexcept {
+  if (this != &other) {
+    if (_data) ::munmap(_data, _size);
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _path = std::move(other._path);
+    _trailer = other._trailer;
+    _columns = other._columns;
+  }
+  return *this;
+}
+
+season_archive::~season_archive() {
+  if (_data) ::munmap(_data, _size);
+}
+
+size_t season_archive::column_size(archive_column column) const {
+  return is_race_column(column) ? race_count() : record_count();
+}
+
+bool season_archive::read_column(
+    archive_column column, std::span<int64_t> values) const {
+  const season_archive_column& info = column_info(column);
+  std::string_view bytes =
+      as_bytes(static_cast<const char*>(_data) + info.offset, info.size);
+  auto corrupt = [&] {
+    std::cerr << "Season archive " << _path << " has a corrupt column "
+              << static_cast<uint32_t>(column) << std::endl;
+    return false;
+  };
+  if (values.size() != column_size(column) ||
+      fnv1a_hash(bytes) != info.checksum) {
+    return corrupt();
+  }
+
+  switch (info.encoding) {
+  case archive_encoding::bit_packed: {
+    bit_reader reader{bytes};
+    if (!reader.has(values.size(), info.bit_width)) return corrupt();
+    for (int64_t& value : values) {
+      value = info.min + static_cast<int64_t>(reader.read(info.bit_width));
+    }
+    return true;
+  }
+  case archive_encoding::dictionary: {
+    uint32_t dictionary_size = 0;
+    if (bytes.size() < sizeof(dictionary_size)) return corrupt();
+    std::memcpy(&dictionary_size, bytes.data(), sizeof(dictionary_size));
+    bytes.remove_prefix(sizeof(dictionary_size));
+    if (bytes.size() / sizeof(int32_t) < dictionary_size) return corrupt();
+    std::vector<int32_t> dictionary(dictionary_size);
+    std::memcpy(
+        dictionary.data(), bytes.data(), dictionary_size * sizeof(int32_t));
+    bit_reader reader{bytes.substr(dictionary_size * sizeof(int32_t))};
+    if (!reader.has(values.size(), info.bit_width)) return corrupt();
+    for (int64_t& value : values) {
+      uint64_t index = reader.read(info.bit_width);
+      if (index >= dictionary.size()) return corrupt();
+      value = dictionary[index];
+    }
+    return true;
+  }
+  case archive_encoding::race_delta: {
+    std::vector<int64_t> race_ends(race_count());
+    if (!read_column(archive_column::race_record_count, race_ends)) {
+      return false;
+    }
+    // A negative count would make the race ends go backwards.
+    if (std::ranges::any_of(
+            race_ends, [](int64_t count) { return count < 0; })) {
+      return corrupt();
+    }
+    std::partial_sum(race_ends.begin(), race_ends.end(), race_ends.begin());
+    // The races must cover every record, including when there are none.
+    int64_t last_end = race_ends.empty() ? 0 : race_ends.back();
+    if (static_cast<size_t>(last_end) != values.size()) return corrupt();
+    bit_reader reader{bytes};
+    if (!reader.has(race_ends.size(), info.base_bit_width)) return corrupt();
+    std::vector<int64_t> race_bases(race_ends.size());
+    for (int64_t& base : race_bases) {
+      base = info.min +
+          static_cast<int64_t>(reader.read(info.base_bit_width)) * info.unit;
+    }
+    if (!reader.has(values.size(), info.bit_width)) return corrupt();
+    size_t race = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+      while (static_cast<int64_t>(i) >= race_ends[race]) ++race;
+      uint64_t delta = reader.read(info.bit_width);
+      values[i] = delta == 0
+          ? 0
+          : race_bases[race] + static_cast<int64_t>(delta - 1) * info.unit;
+    }
+    return true;
+  }
+  }
+  return corrupt();
+}
+
+std::optional<std::vector<DriverResult>> season_archive::read_results() const {
+  std::array<std::vector<int64_t>, ARCHIVE_COLUMN_COUNT> columns;
+  for (size_t i = 0; i < ARCHIVE_COLUMN_COUNT; ++i) {
+    auto column = static_cast<archive_column>(i);
+    columns[i].resize(column_size(column));
+    if (!read_column(column, columns[i])) return std::nullopt;
+  }
+  auto values = [&](archive_column column) -> const std::vector<int64_t>& {
+    return columns[static_cast<size_t>(column)];
+  };
+
+  std::vector<DriverResult> results(record_count());
+  size_t record = 0;
+  for (size_t race = 0; race < race_count(); ++race) {
+    auto circuit = static_cast<constants::Circuit>(
+        values(archive_column::race_circuit)[race]);
+    size_t race_end = record + values(archive_column::race_record_count)[race];
+    if (race_end > results.size()) {
+      std::cerr << "Season archive " << _path << " has an out of range race."
+                << std::endl;
+      return std::nullopt;
+    }
+    for (; record < race_end; ++record) {
+      DriverResult& result = results[record];
+      result.set_race_season(race_season());
+      result.set_circuit(circuit);
+      result.set_team(static_cast<constants::Team>(
+          values(archive_column::team)[record]));
+      result.set_driver(static_cast<constants::Driver>(
+          values(archive_column::driver)[record]));
+      result.set_starting_position(
+          values(archive_column::starting_position)[record]);
+      result.set_final_position(
+          values(archive_column::final_position)[record]);
+      result.set_finals_lap_count(
+          values(archive_column::finals_lap_count)[record]);
+      auto time = [&](archive_column column) {
+        return values(column)[record];
+      };
+      if (int64_t nanos = time(archive_column::qualification_time_1)) {
+        set_duration(nanos, *result.mutable_qualification_time_1());
+      }
+      if (int64_t nanos = time(archive_column::qualification_time_2)) {
+        set_duration(nanos, *result.mutable_qualification_time_2());
+      }
+      if (int64_t nanos = time(archive_column::qualification_time_3)) {
+        set_duration(nanos, *result.mutable_qualification_time_3());
+      }
+      if (int64_t nanos =
+              time(archive_column::qualification_fastest_lap_time)) {
+        set_duration(nanos, *result.mutable_qualification_fastest_lap_time());
+      }
+      if (int64_t nanos = time(archive_column::finals_time)) {
+        set_duration(nanos, *result.mutable_finals_time());
+      }
+      if (int64_t nanos = time(archive_column::finals_fastest_lap_time)) {
+        set_duration(nanos, *result.mutable_finals_fastest_lap_time());
+      }
+    }
+  }
+  return results;
+}
+
+void write_season_archive(
+    const fs::path& path, std::span<const DriverResult* const> results) {
+  std::vector<const DriverResult*> sorted(results.begin(), results.end());
+  std::ranges::sort(sorted, [](const auto* a, const auto* b) {
+    return std::pair{a->circuit(), a->driver()} <
+        std::pair{b->circuit(), b->driver()};
+  });
+
+  std::array<std::vector<int64_t>, ARCHIVE_COLUMN_COUNT> values;
+  auto column_values = [&](archive_column column) -> std::vector<int64_t>& {
+    return values[static_cast<size_t>(column)];
+  };
+  std::vector<size_t> race_ends;
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    const DriverResult& result = *sorted[i];
+    if (race_ends.empty() || result.circuit() != sorted[i - 1]->circuit()) {
+      column_values(archive_column::race_circuit).push_back(result.circuit());
+      column_values(archive_column::race_record_count).push_back(0);
+      race_ends.push_back(i);
+    }
+    ++column_values(archive_column::race_record_count).back();
+    ++race_ends.back();
+    column_values(archive_column::team).push_back(result.team());
+    column_values(archive_column::driver).push_back(result.driver());
+    column_values(archive_column::starting_position)
+        .push_back(result.starting_position());
+    column_values(archive_column::final_position)
+        .push_back(result.final_position());
+    column_values(archive_column::finals_lap_count)
+        .push_back(result.finals_lap_count());
+    column_values(archive_column::qualification_time_1)
+        .push_back(to_nanos(
+            result.has_qualification_time_1(), result.qualification_time_1()));
+    column_values(archive_column::qualification_time_2)
+        .push_back(to_nanos(
+            result.has_qualification_time_2(), result.qualification_time_2()));
+    column_values(archive_column::qualification_time_3)
+        .push_back(to_nanos(
+            result.has_qualification_time_3(), result.qualification_time_3()));
+    column_values(archive_column::qualification_fastest_lap_time)
+        .push_back(to_nanos(
+            result.has_qualification_fastest_lap_time(),
+            result.qualification_fastest_lap_time()));
+    column_values(archive_column::finals_time)
+        .push_back(to_nanos(result.has_finals_time(), result.finals_time()));
+    column_values(archive_column::finals_fastest_lap_time)
+        .push_back(to_nanos(
+            result.has_finals_fastest_lap_time(),
+            result.finals_fastest_lap_time()));
+  }
+
+  std::string data;
+  std::array<season_archive_column, ARCHIVE_COLUMN_COUNT> directory;
+  for (size_t i = 0; i < ARCHIVE_COLUMN_COUNT; ++i) {
+    auto column = static_cast<archive_column>(i);
+    encoded_column encoded;
+    switch (column) {
+    case archive_column::race_circuit:
+    case archive_column::team:
+    case archive_column::driver:
+      encoded = encode_dictionary(values[i]);
+      break;
+    case archive_column::race_record_count:
+    case archive_column::starting_position:
+    case archive_column::final_position:
+    case archive_column::finals_lap_count:
+      encoded = encode_bit_packed(values[i]);
+      break;
+    default:
+      encoded = encode_race_delta(values[i], race_ends);
+      break;
+    }
+    encoded.info.offset = data.size();
+    encoded.info.size = encoded.bytes.size();
+    encoded.info.checksum = fnv1a_hash(encoded.bytes);
+    directory[i] = encoded.info;
+    data += encoded.bytes;
+  }
+
+  season_archive_trailer trailer{
+      .race_season = sorted.empty() ? 0 : sorted.front()->race_season(),
+      .version = SEASON_ARCHIVE_VERSION,
+      .race_count = static_cast<uint32_t>(race_ends.size()),
+      .record_count = static_cast<uint32_t>(sorted.size()),
+      .column_count = ARCHIVE_COLUMN_COUNT,
+      .reserved = 0};
+  std::memcpy(trailer.magic, SEASON_ARCHIVE_MAGIC, sizeof(trailer.magic));
+
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out.write(data.data(), data.size());
+  out.write(
+      reinterpret_cast<const char*>(directory.data()),
+      directory.size() * sizeof(season_archive_column));
+  out.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+  if (!out) {
+    std::cerr << "Failed to write season archive " << path << std::endl;
+    std::exit(1);
+  }
+}
+
+} // namespace f1_predict
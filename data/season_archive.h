@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// A season archive is a compact, column-oriented file holding every result of
+// one season. The layout is:
+//
+//   column data, one block per archive_column
+//   season_archive_column[ARCHIVE_COLUMN_COUNT]
+//   season_archive_trailer
+//
+// Races are sorted by circuit and records within a race by driver. Race
+// columns hold one value per race, the others one value per record. Columns
+// are encoded as follows, with all packed values written least significant
+// bit first:
+//
+//   bit_packed  Each value minus the column minimum, in `bit_width` bits.
+//   dictionary  A uint32_t count and that many int32_t distinct values in
+//               ascending order, then each value's index in `bit_width` bits.
+//   race_delta  Durations in nanoseconds, stored in multiples of `unit`. First
+//               each race's fastest time minus the column minimum, in
+//               `base_bit_width` bits, then each record's time minus its
+//               race's fastest plus one, in `bit_width` bits, with 0 meaning
+//               unset.
+//
+// The trailer and column directory sit at the end so a reader can map the file
+// and decode only the columns it needs. All integers are stored in host byte
+// order.
+
+constexpr char SEASON_ARCHIVE_MAGIC[8] = {'F', '1', 'S', 'E', 'A', 'S', 'N', 0};
+constexpr uint32_t SEASON_ARCHIVE_VERSION = 1;
+inline constexpr char SEASON_ARCHIVE_EXTENSION[] = ".f1season";
+
+enum class archive_column : uint32_t {
+  // Race columns.
+  race_circuit,
+  race_record_count,
+  // Record columns.
+  team,
+  driver,
+  starting_position,
+  final_position,
+  finals_lap_count,
+  qualification_time_1,
+  qualification_time_2,
+  qualification_time_3,
+  qualification_fastest_lap_time,
+  finals_time,
+  finals_fastest_lap_time,
+};
+
+inline constexpr size_t ARCHIVE_COLUMN_COUNT = 13;
+
+enum class archive_encoding : uint8_t {
+  bit_packed,
+  dictionary,
+  race_delta,
+};
+
+struct season_archive_column {
+  uint64_t offset;
+  uint32_t size;
+  archive_encoding encoding;
+  uint8_t bit_width;
+  uint8_t base_bit_width;
+  uint8_t reserved;
+  // Smallest and largest value in the column, ignoring unset durations. Both
+  // are 0 if the column has no values.
+  int64_t min;
+  int64_t max;
+  int64_t unit;
+  // FNV-1a hash of the column's block.
+  uint64_t checksum;
+};
+
+struct season_archive_trailer {
+  int32_t race_season;
+  uint32_t version;
+  uint32_t race_count;
+  uint32_t record_count;
+  uint32_t column_count;
+  uint32_t reserved;
+  char magic[8];
+};
+
+static_assert(sizeof(season_archive_column) == 48);
+static_assert(sizeof(season_archive_trailer) == 32);
+
+// Read-only, memory-mapped view of a season archive. Columns are decoded on
+// request, so the pages of columns that are never read are never loaded.
+class season_archive {
+public:
+  // Maps the given file and validates its trailer and column directory.
+  // Returns nullopt and prints the reason to stderr if the file is not a
+  // valid archive.
+  static std::optional<season_archive>
+  open(const std::filesystem::path& path);
+
+  season_archive(const season_archive&) = delete;
+  season_archive& operator=(const season_archive&) = delete;
+  season_archive(season_archive&& other) noexcept;
+  season_archive& operator=(season_archive&& other) noexcept;
+  ~season_archive();
+
+  int race_season() const { return _trailer.race_season; }
+  size_t race_count() const { return _trailer.race_count; }
+  size_t record_count() const { return _trailer.record_count; }
+  const season_archive_column& column_info(archive_column column) const {
+    return _columns[static_cast<size_t>(column)];
+  }
+  // Number of values in the column: one per race or one per record.
+  size_t column_size(archive_column column) const;
+
+  // Decodes a column into `values`, which must hold column_size(column)
+  // values. Durations come out in nanoseconds, with 0 meaning unset. Returns
+  // false and prints the reason to stderr if the column is corrupt.
+  bool read_column(archive_column column, std::span<int64_t> values) const;
+
+  // Decodes the whole season into results, ordered like the archive.
+  std::optional<std::vector<DriverResult>> read_results() const;
+
+private:
+  season_archive(void* data, size_t size);
+
+  void* _data = nullptr;
+  size_t _size = 0;
+  std::filesystem::path _path;
+  season_archive_trailer _trailer{};
+  std::array<season_archive_column, ARCHIVE_COLUMN_COUNT> _columns{};
+};
+
+// Writes the given results, which must all be from one season, into an
+// archive at `path`, replacing any existing file.
+void write_season_archive(
+    const std::filesystem::path& path,
+    std::span<const DriverResult* const> results);
+
+} // namespace f1_predict
@@ -0,0 +1,123 @@
+#include "data/season_archive.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "data/test_results.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+class SeasonArchiveTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _path = fs::path{::testing::TempDir()} / "season_archive_test";
+    _path += SEASON_ARCHIVE_EXTENSION;
+    _results = {
+        make_test_result(
+            2024, constants::MONACO_CIRCUIT, constants::LANDO_NORRIS, 2),
+        make_test_result(
+            2024,
+            constants::BAHRAIN_CIRCUIT,
+            constants::LANDO_NORRIS,
+            6,
+            90123),
+        make_test_result(
+            2024,
+            constants::MONACO_CIRCUIT,
+            constants::CHARLES_LECLERC,
+            1,
+            70270),
+        make_test_result(
+            2024,
+            constants::BAHRAIN_CIRCUIT,
+            constants::MAX_VERSTAPPEN,
+            1,
+            89179)};
+    std::vector<const DriverResult*> results;
+    for (const DriverResult& result : _results) results.push_back(&result);
+    write_season_archive(_path, results);
+  }
+
+  fs::path _path;
+  std::vector<DriverResult> _results;
+};
+
+TEST_F(SeasonArchiveTest, RoundTripsResults) {
+  std::optional<season_archive> archive = season_archive::open(_path);
+  ASSERT_TRUE(archive.has_value());
+  EXPECT_EQ(archive->race_season(), 2024);
+  EXPECT_EQ(archive->race_count(), 2);
+  ASSERT_EQ(archive->record_count(), 4);
+
+  std::optional<std::vector<DriverResult>> results = archive->read_results();
+  ASSERT_TRUE(results.has_value());
+  // Sorted by circuit, then driver.
+  for (auto [archived, original] :
+       {std::pair{0, 1}, std::pair{1, 3}, std::pair{2, 2}, std::pair{3, 0}}) {
+    EXPECT_EQ(
+        (*results)[archived].SerializeAsString(),
+        _results[original].SerializeAsString())
+        << archived;
+  }
+}
+
+TEST_F(SeasonArchiveTest, ReadsSingleColumnsWithStats) {
+  std::optional<season_archive> archive = season_archive::open(_path);
+  ASSERT_TRUE(archive.has_value());
+
+  std::vector<int64_t> positions(4);
+  ASSERT_TRUE(
+      archive->read_column(archive_column::final_position, positions));
+  EXPECT_EQ(positions, (std::vector<int64_t>{6, 1, 1, 2}));
+  const season_archive_column& info =
+      archive->column_info(archive_column::qualification_time_1);
+  EXPECT_EQ(info.encoding, archive_encoding::race_delta);
+  EXPECT_EQ(info.min, 70'270'000'000);
+  EXPECT_EQ(info.max, 90'123'000'000);
+  EXPECT_EQ(info.unit, 1'000'000);
+}
+
+TEST_F(SeasonArchiveTest, RejectsCorruptColumns) {
+  {
+    std::fstream file{
+        _path, std::ios::in | std::ios::out | std::ios::binary};
+    file.seekp(0);
+    file.put('\x7f');
+  }
+  std::optional<season_archive> archive = season_archive::open(_path);
+  ASSERT_TRUE(archive.has_value());
+  std::vector<int64_t> circuits(2);
+  EXPECT_FALSE(archive->read_column(archive_column::race_circuit, circuits));
+  EXPECT_FALSE(archive->read_results().has_value());
+}
+
+TEST_F(SeasonArchiveTest, RejectsRecordsWithoutRaces) {
+  {
+    std::fstream file{_path, std::ios::in | std::ios::out | std::ios::binary};
+    file.seekp(
+        -static_cast<std::streamoff>(sizeof(season_archive_trailer)) +
+            offsetof(season_archive_trailer, race_count),
+        std::ios::end);
+    uint32_t race_count = 0;
+    file.write(reinterpret_cast<const char*>(&race_count), sizeof(race_count));
+  }
+  std::optional<season_archive> archive = season_archive::open(_path);
+  ASSERT_TRUE(archive.has_value());
+  EXPECT_EQ(archive->race_count(), 0);
+  std::vector<int64_t> times(archive->record_count());
+  EXPECT_FALSE(
+      archive->read_column(archive_column::qualification_time_1, times));
+}
+
+} // namespace
+} // namespace f1_predict
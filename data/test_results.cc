@@ -0,0 +1,35 @@
+#include "data/test_results.h"
+
+#include <cstdint>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+DriverResult make_test_result(
+    int season,
+    constants::Circuit circuit,
+    constants::Driver driver,
+    int final_position,
+    int64_t qualification_millis) {
+  DriverResult result;
+  result.set_race_season(season);
+  result.set_circuit(circuit);
+  result.set_driver(driver);
+  result.set_team(constants::FERRARI);
+  result.set_starting_position(final_position + 1);
+  result.set_final_position(final_position);
+  result.set_finals_lap_count(58);
+  if (qualification_millis) {
+    result.mutable_qualification_time_1()->set_seconds(
+        qualification_millis / 1000);
+    result.mutable_qualification_time_1()->set_nanos(
+        qualification_millis % 1000 * 1000000);
+  }
+  result.mutable_finals_time()->set_seconds(5243 + final_position);
+  result.mutable_finals_time()->set_nanos(138000000);
+  return result;
+}
+
+} // namespace f1_predict
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// A finished Ferrari result for tests, with a full race distance and a finals
+// time that grows with the final position. The first qualifying time is only
+// set if `qualification_millis` is not 0.
+DriverResult make_test_result(
+    int season,
+    constants::Circuit circuit,
+    constants::Driver driver,
+    int final_position,
+    int64_t qualification_millis = 0);
+
+} // namespace f1_predict
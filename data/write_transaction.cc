@@ -0,0 +1,277 @@
+#include "data/write_transaction.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "data/batch_io.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+constexpr std::string_view STAGED_STATE = "staged";
+constexpr std::string_view COMMITTED_STATE = "committed";
+constexpr std::string_view WRITE_ENTRY = "write ";
+constexpr std::string_view REMOVE_ENTRY = "remove ";
+
+constexpr int NEW_FILE_MODE = 0666;
+
+fs::path journal_path(const fs::path& root) {
+  return root / WRITE_JOURNAL_NAME;
+}
+
+fs::path staged_path(const fs::path& path) {
+  fs::path staged = path;
+  staged += STAGED_EXTENSION;
+  return staged;
+}
+
+// Flushes the file or directory at `path` to disk.
+bool sync_path(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  bool synced = ::fsync(fd) == 0;
+  return ::close(fd) == 0 && synced;
+}
+
+// Flushes every file on the filesystem holding `path`, which is one call
+// however many files were written.
+bool sync_filesystem(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  bool synced = ::syncfs(fd) == 0;
+  return ::close(fd) == 0 && synced;
+}
+
+bool write_file(const fs::path& path, std::string_view contents, bool sync) {
+  int fd = ::open(
+      path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, NEW_FILE_MODE);
+  if (fd < 0) return false;
+  size_t done = 0;
+  while (done < contents.size()) {
+    ssize_t result =
+        ::write(fd, contents.data() + done, contents.size() - done);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) {
+      ::close(fd);
+      return false;
+    }
+    done += result;
+  }
+  if (sync && ::fsync(fd) != 0) {
+    ::close(fd);
+    return false;
+  }
+  return ::close(fd) == 0;
+}
+
+struct Journal {
+  bool committed = false;
+  std::vector<fs::path> writes;
+  std::vector<fs::path> removals;
+};
+
+std::optional<Journal> read_journal(const fs::path& path) {
+  std::ifstream input{path};
+  std::string line;
+  if (!std::getline(input, line)) return std::nullopt;
+  Journal journal;
+  if (line == COMMITTED_STATE) {
+    journal.committed = true;
+  } else if (line != STAGED_STATE) {
+    return std::nullopt;
+  }
+  while (std::getline(input, line)) {
+    if (line.starts_with(WRITE_ENTRY)) {
+      journal.writes.emplace_back(line.substr(WRITE_ENTRY.size()));
+    } else if (line.starts_with(REMOVE_ENTRY)) {
+      journal.removals.emplace_back(line.substr(REMOVE_ENTRY.size()));
+    } else {
+      return std::nullopt;
+    }
+  }
+  return journal;
+}
+
+void fail(std::string_view action, const fs::path& path) {
+  std::cerr << "Failed to " << action << " " << path << std::endl;
+  std::exit(1);
+}
+
+// Renames every staged file that still exists into place, deletes the removed
+// paths in order, leaving any directory that is not empty, and flushes the
+// directories involved. Safe to repeat after a crash.
+void roll_forward(
+    const fs::path& root,
+    std::span<const fs::path> writes,
+    std::span<const fs::path> removals) {
+  std::set<fs::path> directories;
+  for (const fs::path& write : writes) {
+    fs::path path = root / write;
+    std::error_code error;
+    fs::rename(staged_path(path), path, error);
+    if (error && error != std::errc::no_such_file_or_directory) {
+      fail("rename into place", path);
+    }
+    directories.insert(path.parent_path());
+  }
+  for (const fs::path& removal : removals) {
+    fs::path path = root / removal;
+    std::error_code error;
+    fs::remove(path, error);
+    if (error && error != std::errc::directory_not_empty) fail("remove", path);
+    directories.insert(path.parent_path());
+  }
+  for (const fs::path& directory : directories) {
+    // A directory removed here is flushed by syncing its parent instead.
+    if (!fs::exists(directory)) continue;
+    if (!sync_path(directory)) fail("sync", directory);
+  }
+}
+
+void remove_staged_files(
+    const fs::path& root, std::span<const fs::path> writes) {
+  for (const fs::path& write : writes) {
+    std::error_code error;
+    fs::remove(staged_path(root / write), error);
+  }
+}
+
+void remove_journal(const fs::path& root) {
+  std::error_code error;
+  fs::remove(journal_path(root), error);
+  if (error) fail("remove", journal_path(root));
+}
+
+} // namespace
+
+write_transaction::write_transaction(fs::path root)
+    : _root{std::move(root).lexically_normal()} {}
+
+write_transaction::~write_transaction() {
+  if (!empty()) roll_back();
+}
+
+void write_transaction::stage(
+    std::span<const std::pair<fs::path, std::string>> files) {
+  if (files.empty()) return;
+  std::vector<std::pair<fs::path, std::string>> staged_files;
+  staged_files.reserve(files.size());
+  for (const auto& [path, contents] : files) {
+    fs::path relative = path.lexically_normal().lexically_relative(_root);
+    if (relative.empty() || *relative.begin() == "..") {
+      std::cerr << path << " is outside of " << _root << std::endl;
+      std::exit(1);
+    }
+    _writes.push_back(std::move(relative));
+    staged_files.emplace_back(staged_path(path), contents);
+  }
+  // The journal lists the staged files before they exist, so a crash while
+  // writing them leaves nothing that recovery does not know to delete.
+  write_journal(false);
+  std::vector<fs::path> failed_paths = write_files(staged_files);
+  if (!failed_paths.empty()) {
+    for (const fs::path& path : failed_paths) {
+      std::cerr << "Failed to write " << path << std::endl;
+    }
+    std::exit(1);
+  }
+}
+
+void write_transaction::remove_on_commit(const fs::path& path) {
+  fs::path relative = path.lexically_normal().lexically_relative(_root);
+  if (relative.empty() || *relative.begin() == "..") {
+    std::cerr << path << " is outside of " << _root << std::endl;
+    std::exit(1);
+  }
+  // Removals only happen once the transaction commits, so they reach the
+  // journal with the committed state rather than by rewriting it here.
+  _removals.push_back(std::move(relative));
+}
+
+void write_transaction::commit() {
+  if (empty()) return;
+  if (!sync_filesystem(_root)) fail("sync", _root);
+  // Once the committed journal is durable, the transaction happens even if
+  // this process does not finish it.
+  write_journal(true);
+  roll_forward(_root, _writes, _removals);
+  remove_journal(_root);
+  _writes.clear();
+  _removals.clear();
+}
+
+void write_transaction::roll_back() {
+  remove_staged_files(_root, _writes);
+  remove_journal(_root);
+  _writes.clear();
+  _removals.clear();
+}
+
+void write_transaction::write_journal(bool committed) const {
+  std::ostringstream journal;
+  journal << (committed ? COMMITTED_STATE : STAGED_STATE) << "\n";
+  for (const fs::path& write : _writes) {
+    journal << WRITE_ENTRY << write.string() << "\n";
+  }
+  for (const fs::path& removal : _removals) {
+    journal << REMOVE_ENTRY << removal.string() << "\n";
+  }
+
+  // Replaces the journal atomically, so it is never seen half written.
+  fs::path path = journal_path(_root);
+  fs::path new_path = path;
+  new_path += ".new";
+  if (!write_file(new_path, journal.str(), committed)) {
+    fail("write", new_path);
+  }
+  std::error_code error;
+  fs::rename(new_path, path, error);
+  if (error) fail("write", path);
+  if (committed && !sync_path(_root)) fail("sync", _root);
+}
+
+void recover_write_transaction(const fs::path& root) {
+  fs::path path = journal_path(root);
+  fs::path new_path = path;
+  new_path += ".new";
+  std::error_code error;
+  fs::remove(new_path, error);
+  if (!fs::exists(path)) return;
+
+  std::optional<Journal> journal = read_journal(path);
+  if (!journal) {
+    std::cerr << "Failed to read write journal " << path << std::endl;
+    std::exit(1);
+  }
+  if (journal->committed) {
+    std::cerr << "Completing an interrupted write of "
+              << journal->writes.size() << " files under " << root
+              << std::endl;
+    roll_forward(root, journal->writes, journal->removals);
+  } else {
+    std::cerr << "Discarding an interrupted write of "
+              << journal->writes.size() << " files under " << root
+              << std::endl;
+    remove_staged_files(root, journal->writes);
+  }
+  remove_journal(root);
+}
+
+} // namespace f1_predict
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace f1_predict {
+
+// Replaces a set of files under one root directory all at once, so a crash
+// never leaves a mix of old and new files or a half-written one.
+//
+// Staged files are written next to their targets with STAGED_EXTENSION
+// appended, and listed in a journal at <root>/WRITE_JOURNAL_NAME that starts
+// with the line "staged". Committing flushes all staged files with a single
+// syncfs, atomically replaces the journal with one that starts with
+// "committed", renames the staged files into place, performs any deletions,
+// and then removes the journal. Each following line of the journal is
+// "write <path>" or "remove <path>", with paths relative to the root.
+//
+// After a crash, recover_write_transaction rolls a committed journal forward
+// and deletes the staged files of one that was never committed.
+
+inline constexpr char WRITE_JOURNAL_NAME[] = ".write_journal";
+inline constexpr char STAGED_EXTENSION[] = ".staged";
+
+class write_transaction {
+public:
+  // Starts a transaction for files under `root`. Any interrupted transaction
+  // under `root` must already have been recovered.
+  explicit write_transaction(std::filesystem::path root);
+
+  write_transaction(const write_transaction&) = delete;
+  write_transaction& operator=(const write_transaction&) = delete;
+  // Rolls back anything staged but not committed.
+  ~write_transaction();
+
+  // Writes each file's contents to its staging file. Exits if a path is not
+  // under the root or a file cannot be written.
+  void stage(std::span<const std::pair<std::filesystem::path, std::string>>
+                 files);
+  // Deletes `path`, a file or directory under the root, once the staged
+  // files are in place. Removals happen in the order they were added, and a
+  // directory that is not empty by then is left in place. Only recorded in
+  // memory until the commit writes the journal, so it is cheap to call once
+  // per path.
+  void remove_on_commit(const std::filesystem::path& path);
+
+  // Moves every staged file into place and performs the deletions. Exits if
+  // the transaction cannot be made durable; it is then rolled forward or back
+  // by the next recovery.
+  void commit();
+  // Deletes the staged files and leaves their targets untouched.
+  void roll_back();
+
+  bool empty() const { return _writes.empty() && _removals.empty(); }
+
+private:
+  void write_journal(bool committed) const;
+
+  std::filesystem::path _root;
+  // Paths relative to the root.
+  std::vector<std::filesystem::path> _writes;
+  std::vector<std::filesystem::path> _removals;
+};
+
+// Completes or undoes a transaction under `root` that was interrupted. Call
+// before reading or writing files under `root`. Exits if the journal cannot be
+// read or applied.
+void recover_write_transaction(const std::filesystem::path& root);
+
+} // namespace f1_predict
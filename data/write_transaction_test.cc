@@ -0,0 +1,125 @@
+#include "data/write_transaction.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+std::string read_file(const fs::path& path) {
+  std::ifstream input{path};
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+void write_file(const fs::path& path, const std::string& contents) {
+  std::ofstream{path} << contents;
+}
+
+class WriteTransactionTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    _root = fs::path{::testing::TempDir()} / "write_transaction_test";
+    fs::remove_all(_root);
+    fs::create_directories(_root / "2024");
+  }
+
+  fs::path _root;
+};
+
+TEST_F(WriteTransactionTest, CommitReplacesFiles) {
+  write_file(_root / "2024/a", "old");
+  fs::create_directories(_root / "2024/legacy");
+  {
+    write_transaction transaction{_root};
+    std::vector<std::pair<fs::path, std::string>> files = {
+        {_root / "2024/a", "new a"}, {_root / "2024/b", "new b"}};
+    transaction.stage(files);
+    transaction.remove_on_commit(_root / "2024/legacy");
+    EXPECT_EQ(read_file(_root / "2024/a"), "old");
+    EXPECT_TRUE(fs::exists(_root / WRITE_JOURNAL_NAME));
+    transaction.commit();
+  }
+  EXPECT_EQ(read_file(_root / "2024/a"), "new a");
+  EXPECT_EQ(read_file(_root / "2024/b"), "new b");
+  EXPECT_FALSE(fs::exists(_root / "2024/legacy"));
+  EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+  EXPECT_FALSE(fs::exists(_root / "2024/a.staged"));
+}
+
+TEST_F(WriteTransactionTest, CommitsRemovalsWithoutStagedFiles) {
+  write_file(_root / "2024/a", "old");
+  write_file(_root / "2024/b", "old");
+  {
+    write_transaction transaction{_root};
+    transaction.remove_on_commit(_root / "2024/a");
+    transaction.remove_on_commit(_root / "2024/b");
+    // Removals are kept in memory until the commit journals them.
+    EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+    EXPECT_TRUE(fs::exists(_root / "2024/a"));
+    transaction.commit();
+  }
+  EXPECT_FALSE(fs::exists(_root / "2024/a"));
+  EXPECT_FALSE(fs::exists(_root / "2024/b"));
+  EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+}
+
+TEST_F(WriteTransactionTest, RollsBackUncommittedChanges) {
+  write_file(_root / "2024/a", "old");
+  {
+    write_transaction transaction{_root};
+    std::vector<std::pair<fs::path, std::string>> files = {
+        {_root / "2024/a", "new a"}, {_root / "2024/b", "new b"}};
+    transaction.stage(files);
+  }
+  EXPECT_EQ(read_file(_root / "2024/a"), "old");
+  EXPECT_FALSE(fs::exists(_root / "2024/b"));
+  EXPECT_FALSE(fs::exists(_root / "2024/a.staged"));
+  EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+}
+
+TEST_F(WriteTransactionTest, RecoveryCompletesCommittedJournal) {
+  // A crash after the first of two files was renamed into place.
+  write_file(_root / "2024/a", "new a");
+  write_file(_root / "2024/b", "old");
+  write_file(_root / "2024/b.staged", "new b");
+  fs::create_directories(_root / "2024/legacy");
+  write_file(
+      _root / WRITE_JOURNAL_NAME,
+      "committed\nwrite 2024/a\nwrite 2024/b\nremove 2024/legacy\n");
+
+  recover_write_transaction(_root);
+  EXPECT_EQ(read_file(_root / "2024/a"), "new a");
+  EXPECT_EQ(read_file(_root / "2024/b"), "new b");
+  EXPECT_FALSE(fs::exists(_root / "2024/b.staged"));
+  EXPECT_FALSE(fs::exists(_root / "2024/legacy"));
+  EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+}
+
+TEST_F(WriteTransactionTest, RecoveryDiscardsStagedJournal) {
+  write_file(_root / "2024/a", "old");
+  write_file(_root / "2024/a.staged", "new a");
+  fs::create_directories(_root / "2024/legacy");
+  write_file(
+      _root / WRITE_JOURNAL_NAME,
+      "staged\nwrite 2024/a\nwrite 2024/b\nremove 2024/legacy\n");
+
+  recover_write_transaction(_root);
+  EXPECT_EQ(read_file(_root / "2024/a"), "old");
+  EXPECT_FALSE(fs::exists(_root / "2024/a.staged"));
+  EXPECT_FALSE(fs::exists(_root / "2024/b"));
+  EXPECT_TRUE(fs::exists(_root / "2024/legacy"));
+  EXPECT_FALSE(fs::exists(_root / WRITE_JOURNAL_NAME));
+}
+
+} // namespace
+} // namespace f1_predict
@@ -0,0 +1,90 @@
+#include "model/csv_sink.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string_view>
+
+namespace f1_predict {
+
+namespace fs = ::std::filesystem;
+
+csv_sink::csv_sink(const fs::path& path, size_t flush_threshold)
+    : _path{path}, _fd{::open(
+                       path.c_str(),
+                       O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                       0644)},
+      _flush_threshold{std::max<size_t>(flush_threshold, 1)},
+      _capacity{_flush_threshold + MAX_DOUBLE_SIZE} {
+  if (_fd < 0) {
+    std::cerr << "Failed to open " << _path << ": " << std::strerror(errno)
+              << std::endl;
+    std::exit(1);
+  }
+  _buffer = std::make_unique_for_overwrite<char[]>(_capacity);
+}
+
+csv_sink::~csv_sink() {
+  flush();
+  ::close(_fd);
+}
+
+csv_sink& csv_sink::operator<<(std::string_view text) {
+  std::memcpy(reserve(text.size()), text.data(), text.size());
+  _size += text.size();
+  return *this;
+}
+
+csv_sink& csv_sink::operator<<(char c) {
+  *reserve(1) = c;
+  ++_size;
+  return *this;
+}
+
+csv_sink& csv_sink::operator<<(double value) {
+  size_t size = MAX_DOUBLE_SIZE + _precision;
+  char* end = reserve(size);
+  _size = std::to_chars(end, end + size, value, _double_format, _precision)
+              .ptr -
+      _buffer.get();
+  return *this;
+}
+
+void csv_sink::set_fixed(int precision) {
+  _double_format = std::chars_format::fixed;
+  _precision = precision;
+}
+
+void csv_sink::flush() {
+  size_t written = 0;
+  while (written < _size) {
+    ssize_t result = ::write(_fd, _buffer.get() + written, _size - written);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) {
+      std::cerr << "Failed to write " << _path << ": " << std::strerror(errno)
+                << std::endl;
+      std::exit(1);
+    }
+    written += result;
+  }
+  _size = 0;
+}
+
+char* csv_sink::reserve(size_t size) {
+  if (_size >= _flush_threshold || _capacity - _size < size) flush();
+  if (_capacity < size) {
+    _capacity = size;
+    _buffer = std::make_unique_for_overwrite<char[]>(_capacity);
+  }
+  return _buffer.get() + _size;
+}
+
+} // namespace f1_predict
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace f1_predict {
+
+// Buffered output for large CSV files. Numbers are formatted with
+// std::to_chars straight into one reusable buffer. The buffer is written to
+// the file whenever it fills past a threshold, and once more when the sink is
+// destroyed.
+//
+// The text matches what an std::ostream with default flags writes for the
+// same values, including after `set_fixed`, which stands in for
+// `std::fixed << std::setprecision`.
+class csv_sink {
+public:
+  static constexpr size_t DEFAULT_FLUSH_THRESHOLD = 1 << 20;
+
+  // Opens `path` for writing, replacing any existing file. Exits if it cannot
+  // be opened.
+  explicit csv_sink(
+      const std::filesystem::path& path,
+      size_t flush_threshold = DEFAULT_FLUSH_THRESHOLD);
+  csv_sink(const csv_sink&) = delete;
+  csv_sink& operator=(const csv_sink&) = delete;
+  ~csv_sink();
+
+  csv_sink& operator<<(std::string_view text);
+  csv_sink& operator<<(char c);
+  csv_sink& operator<<(double value);
+
+  template <std::integral Integer>
+  csv_sink& operator<<(Integer value) {
+    char* end = reserve(MAX_INTEGER_SIZE);
+    _size = std::to_chars(end, end + MAX_INTEGER_SIZE, value).ptr -
+        _buffer.get();
+    return *this;
+  }
+
+  // Enums are written as their underlying numbers, as by an ostream.
+  template <typename Enum>
+    requires std::is_enum_v<Enum>
+  csv_sink& operator<<(Enum value) {
+    return *this << std::to_underlying(value);
+  }
+
+  // Writes every later double in fixed notation with `precision` decimals.
+  void set_fixed(int precision);
+
+  // Writes out everything buffered so far. Exits if the file cannot be
+  // written.
+  void flush();
+
+private:
+  static constexpr size_t MAX_INTEGER_SIZE = 24;
+  // Room for any double before its decimals: a sign, 309 digits, an exponent
+  // and a decimal point.
+  static constexpr size_t MAX_DOUBLE_SIZE = 320;
+
+  // Returns the end of the buffered text, after making room for `size` more
+  // bytes.
+  char* reserve(size_t size);
+
+  std::filesystem::path _path;
+  int _fd;
+  size_t _flush_threshold;
+  std::unique_ptr<char[]> _buffer;
+  size_t _capacity;
+  size_t _size = 0;
+  std::chars_format _double_format = std::chars_format::general;
+  // An ostream's default precision.
+  int _precision = 6;
+};
+
+} // namespace f1_predict
@@ -0,0 +1,84 @@
+#include "model/csv_sink.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+const std::vector<double> DOUBLES = {
+    0.0,
+    -0.0,
+    1.0,
+    0.5,
+    19.5,
+    2.0 / 3.0,
+    1234567.0,
+    0.000012345,
+    5686.384460,
+    1e21,
+    std::numeric_limits<double>::max(),
+    std::numeric_limits<double>::denorm_min(),
+    -std::numeric_limits<double>::infinity()};
+
+std::string read_file(const fs::path& path) {
+  std::ifstream in{path};
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+TEST(CsvSinkTest, FormatsLikeAnOstream) {
+  fs::path path = fs::path{::testing::TempDir()} / "csv_sink_test.csv";
+  std::ostringstream expected;
+  {
+    // A tiny threshold makes almost every write flush.
+    csv_sink sink{path, 8};
+    sink << "name" << ',' << 42 << ',' << int64_t{-1234567890123} << ','
+         << size_t{18446744073709551615u} << ',' << constants::MONACO_CIRCUIT
+         << '\n';
+    expected << "name" << ',' << 42 << ',' << int64_t{-1234567890123} << ','
+             << size_t{18446744073709551615u} << ','
+             << constants::MONACO_CIRCUIT << '\n';
+
+    for (double value : DOUBLES) {
+      sink << value << '\n';
+      expected << value << '\n';
+    }
+    sink.set_fixed(6);
+    expected << std::setprecision(6) << std::fixed;
+    for (double value : DOUBLES) {
+      sink << value << '\n';
+      expected << value << '\n';
+    }
+  }
+  EXPECT_EQ(read_file(path), expected.str());
+}
+
+TEST(CsvSinkTest, WritesOnlyPastTheThreshold) {
+  fs::path path = fs::path{::testing::TempDir()} / "csv_sink_threshold.csv";
+  csv_sink sink{path, 1024};
+  sink << std::string(1000, 'x');
+  sink << 'y';
+  EXPECT_EQ(fs::file_size(path), 0);
+  sink.flush();
+  EXPECT_EQ(fs::file_size(path), 1001);
+  sink << std::string(4096, 'z');
+  EXPECT_EQ(fs::file_size(path), 1001);
+  sink << 'y';
+  EXPECT_EQ(fs::file_size(path), 5097);
+}
+
+} // namespace
+} // namespace f1_predict
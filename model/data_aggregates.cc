@@ -0,0 +1,94 @@
+#include "model/data_aggregates.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "data/constants.pb.h"
+
+namespace f1_predict {
+namespace {
+
+// Returns whether `value` is one of the `count` values of a dense enum.
+bool in_range(int value, size_t count) {
+  return static_cast<size_t>(value) < count;
+}
+
+size_t checked_index(int value, size_t count) {
+  if (!in_range(value, count)) {
+    std::cerr << "No historical stats for unknown enum value " << value
+              << std::endl;
+    std::exit(1);
+  }
+  return value;
+}
+
+} // namespace
+
+template <typename Key, size_t KEY_COUNT, typename Slot>
+historical_data::stats&
+historical_data::slot_table<Key, KEY_COUNT, Slot>::get(Key key) {
+  static_assert(KEY_COUNT <= std::numeric_limits<Slot>::max());
+  size_t index = checked_index(key, KEY_COUNT);
+  if (_slots.empty()) _slots.resize(KEY_COUNT);
+  Slot& slot = _slots[index];
+  if (slot == 0) {
+    _stats.emplace_back();
+    slot = _stats.size();
+  }
+  return _stats[slot - 1];
+}
+
+template <typename Key, size_t KEY_COUNT, typename Slot>
+const historical_data::stats*
+historical_data::slot_table<Key, KEY_COUNT, Slot>::find(Key key) const {
+  if (_slots.empty() || !in_range(key, KEY_COUNT)) return nullptr;
+  Slot slot = _slots[key];
+  return slot == 0 ? nullptr : &_stats[slot - 1];
+}
+
+historical_data::stats& historical_data::circuit_driver(
+    constants::Circuit circuit, constants::Driver driver) {
+  return _circuit_drivers[checked_index(circuit, _circuit_drivers.size())].get(
+      driver);
+}
+
+historical_data::stats& historical_data::circuit_team(
+    constants::Circuit circuit, constants::Team team) {
+  return _circuit_teams[checked_index(circuit, _circuit_teams.size())].get(
+      team);
+}
+
+historical_data::stats&
+historical_data::driver_career(constants::Driver driver) {
+  return _driver_career.get(driver);
+}
+
+historical_data::stats& historical_data::team_career(constants::Team team) {
+  return _team_career.get(team);
+}
+
+const historical_data::stats* historical_data::find_circuit_driver(
+    constants::Circuit circuit, constants::Driver driver) const {
+  if (!in_range(circuit, _circuit_drivers.size())) return nullptr;
+  return _circuit_drivers[circuit].find(driver);
+}
+
+const historical_data::stats* historical_data::find_circuit_team(
+    constants::Circuit circuit, constants::Team team) const {
+  if (!in_range(circuit, _circuit_teams.size())) return nullptr;
+  return _circuit_teams[circuit].find(team);
+}
+
+const historical_data::stats*
+historical_data::find_driver_career(constants::Driver driver) const {
+  return _driver_career.find(driver);
+}
+
+const historical_data::stats*
+historical_data::find_team_career(constants::Team team) const {
+  return _team_career.find(team);
+}
+
+} // namespace f1_predict
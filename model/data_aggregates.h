@@ -1,25 +1,73 @@
 #pragma once
 
-#include <unordered_map>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "data/constants.pb.h"
+#include "model/rolling_stats.h"
 
 namespace f1_predict {
 
-struct historical_data {
+// Statistics of past races: per driver and per team at each circuit, and over
+// the careers of drivers and teams.
+//
+// Circuits, drivers and teams are dense enums, so stats are found by indexing
+// with their values instead of hashing them. Each table gives the drivers or
+// teams a compact slot in the order they first got stats, and keeps the stats
+// contiguously by slot, so memory grows with the pairs that have raced rather
+// than with every pair the enums allow.
+class historical_data {
+public:
   struct stats {
-    std::vector<int> finals_positions;
+    rolling_stats finals_positions;
+    // Stops made and median stop time in each race with pit stop data.
+    rolling_stats pit_stop_counts;
+    rolling_stats pit_stop_times_ms;
   };
-  std::unordered_map<
-      constants::Circuit,
-      std::unordered_map<constants::Driver, stats>>
-      circuit_drivers;
-  std::unordered_map<
-      constants::Circuit,
-      std::unordered_map<constants::Team, stats>>
-      circuit_teams;
-  std::unordered_map<constants::Driver, stats> driver_career;
+
+  // Return the stats, adding empty ones if there were none. The references
+  // are invalidated by adding stats to the same table.
+  stats& circuit_driver(constants::Circuit circuit, constants::Driver driver);
+  stats& circuit_team(constants::Circuit circuit, constants::Team team);
+  stats& driver_career(constants::Driver driver);
+  stats& team_career(constants::Team team);
+
+  // Return the stats, or null if there were none.
+  const stats*
+  find_circuit_driver(constants::Circuit circuit, constants::Driver driver)
+      const;
+  const stats*
+  find_circuit_team(constants::Circuit circuit, constants::Team team) const;
+  const stats* find_driver_career(constants::Driver driver) const;
+  const stats* find_team_career(constants::Team team) const;
+
+private:
+  // Stats of the values of one enum with `KEY_COUNT` values, in slots of type
+  // `Slot`.
+  template <typename Key, size_t KEY_COUNT, typename Slot>
+  class slot_table {
+  public:
+    stats& get(Key key);
+    const stats* find(Key key) const;
+
+  private:
+    // One past the index of each key's stats, or 0 for keys without any.
+    // Empty until the first stats are added.
+    std::vector<Slot> _slots;
+    std::vector<stats> _stats;
+  };
+
+  using driver_table =
+      slot_table<constants::Driver, constants::Driver_ARRAYSIZE, uint16_t>;
+  using team_table =
+      slot_table<constants::Team, constants::Team_ARRAYSIZE, uint8_t>;
+
+  std::array<driver_table, constants::Circuit_ARRAYSIZE> _circuit_drivers;
+  std::array<team_table, constants::Circuit_ARRAYSIZE> _circuit_teams;
+  driver_table _driver_career;
+  team_table _team_career;
 };
 
 } // namespace f1_predict
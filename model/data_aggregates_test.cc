@@ -0,0 +1,77 @@
+#include "model/data_aggregates.h"
+
+#include "data/constants.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+TEST(HistoricalDataTest, FindsOnlyAddedStats) {
+  historical_data historical;
+  EXPECT_EQ(
+      historical.find_circuit_driver(
+          constants::MONACO_CIRCUIT, constants::Driver_MAX),
+      nullptr);
+
+  historical.circuit_driver(constants::MONACO_CIRCUIT, constants::Driver_MAX)
+      .finals_positions.add(3);
+  historical.circuit_team(constants::MONACO_CIRCUIT, constants::Team_MAX)
+      .finals_positions.add(4);
+  historical.driver_career(constants::Driver_MAX).finals_positions.add(5);
+  historical.team_career(constants::Team_MAX).pit_stop_times_ms.add(2400);
+
+  const historical_data::stats* circuit_driver = historical.find_circuit_driver(
+      constants::MONACO_CIRCUIT, constants::Driver_MAX);
+  ASSERT_NE(circuit_driver, nullptr);
+  EXPECT_EQ(circuit_driver->finals_positions.average(), 3.0);
+  const historical_data::stats* circuit_team = historical.find_circuit_team(
+      constants::MONACO_CIRCUIT, constants::Team_MAX);
+  ASSERT_NE(circuit_team, nullptr);
+  EXPECT_EQ(circuit_team->finals_positions.average(), 4.0);
+  ASSERT_NE(historical.find_driver_career(constants::Driver_MAX), nullptr);
+  ASSERT_NE(historical.find_team_career(constants::Team_MAX), nullptr);
+
+  EXPECT_EQ(
+      historical.find_circuit_driver(
+          constants::Circuit_MAX, constants::Driver_MAX),
+      nullptr);
+  EXPECT_EQ(
+      historical.find_circuit_team(
+          constants::MONACO_CIRCUIT, constants::Team_MIN),
+      nullptr);
+  EXPECT_EQ(historical.find_driver_career(constants::Driver_MIN), nullptr);
+  EXPECT_EQ(
+      historical.find_driver_career(
+          static_cast<constants::Driver>(constants::Driver_ARRAYSIZE)),
+      nullptr);
+}
+
+TEST(HistoricalDataTest, KeepsStatsOfEachPairApart) {
+  historical_data historical;
+  for (int driver = constants::Driver_MIN; driver <= constants::Driver_MAX;
+       ++driver) {
+    historical
+        .circuit_driver(
+            constants::MONACO_CIRCUIT, static_cast<constants::Driver>(driver))
+        .finals_positions.add(driver % 20 + 1);
+  }
+  for (int driver = constants::Driver_MIN; driver <= constants::Driver_MAX;
+       ++driver) {
+    const historical_data::stats* stats = historical.find_circuit_driver(
+        constants::MONACO_CIRCUIT, static_cast<constants::Driver>(driver));
+    ASSERT_NE(stats, nullptr);
+    EXPECT_EQ(stats->finals_positions.size(), 1);
+    EXPECT_EQ(stats->finals_positions.average(), driver % 20 + 1);
+  }
+}
+
+TEST(HistoricalDataDeathTest, ExitsOnUnknownValues) {
+  historical_data historical;
+  EXPECT_EXIT(
+      historical.team_career(static_cast<constants::Team>(-1)),
+      ::testing::ExitedWithCode(1),
+      "unknown enum value");
+}
+
+} // namespace
+} // namespace f1_predict
@@ -1,21 +1,35 @@
+#include <sys/resource.h>
+
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <string>
+#include <string_view>
 #include <system_error>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/random/random.h"
+#include "absl/strings/numbers.h"
 #include "data/constants.pb.h"
+#include "data/pit_stops.h"
 #include "data/proto_utils.h"
+#include "data/race_dataset.h"
 #include "data/race_results.pb.h"
+#include "data/results_manifest.h"
+#include "data/results_pack.h"
+#include "data/season_archive.h"
+#include "data/write_transaction.h"
 #include "model/data_aggregates.h"
+#include "model/results_table.h"
 #include "model/writer.h"
 
 ABSL_FLAG(
@@ -27,50 +41,102 @@ ABSL_FLAG(
 ABSL_FLAG(std::string, tests_file, "tests.csv", "Path to save test data.");
 ABSL_FLAG(
     std::string, results_dir, "", "Path to directory containing race results.");
+ABSL_FLAG(
+    std::string,
+    result_cache_dir,
+    "",
+    "Directory for caching parsed result files between runs.");
+ABSL_FLAG(
+    int,
+    load_threads,
+    0,
+    "Number of threads used to parse result files. Defaults to one per core.");
+ABSL_FLAG(
+    std::string,
+    results_pack,
+    "",
+    "Path to a results pack to load instead of --results_dir.");
+ABSL_FLAG(
+    std::string,
+    results_archive,
+    "",
+    "Directory of season archives to load instead of --results_dir.");
+ABSL_FLAG(
+    std::string,
+    pit_stops,
+    "",
+    "Path to a pit stop table written by kaggle_importer --pit_stops, for the "
+    "pit stop aggregates. Their columns are not in the training files yet.");
+ABSL_FLAG(
+    std::string,
+    seasons,
+    "",
+    "Inclusive range of seasons to load, e.g. 2014-2024. Defaults to all.");
+ABSL_FLAG(
+    std::vector<std::string>,
+    circuits,
+    {},
+    "Comma-separated circuits to load, e.g. MONACO_CIRCUIT. Defaults to all.");
+ABSL_FLAG(
+    bool,
+    report_load_stats,
+    false,
+    "Print the time and memory taken to load and organize the results.");
+ABSL_FLAG(
+    bool,
+    use_manifest,
+    true,
+    "Select races from the manifest in --results_dir when it has one, instead "
+    "of walking the tree.");
 
 namespace fs = ::std::filesystem;
 
-using ::f1_predict::constants::Circuit;
-using ::f1_predict::constants::Driver;
-using ::f1_predict::constants::Team;
-using ::f1_predict::load_result;
-using ::f1_predict::to_milliseconds;
-
-using driver_to_results_map_t =
-    ::std::unordered_map<Driver, ::f1_predict::DriverResult>;
-using circuit_to_drivers_map_t =
-    ::std::unordered_map<Circuit, ::driver_to_results_map_t>;
-using season_to_circuit_map_t =
-    ::std::unordered_map<int, ::circuit_to_drivers_map_t>;
-
-std::vector<std::string> enumerate_files(const fs::path& root) {
-  if (!fs::is_directory(root)) {
-    if (!fs::exists(root)) return {};
-    return {root};
-  }
-
-  std::vector<std::string> files;
-  for (const fs::directory_entry& child : fs::directory_iterator(root)) {
-    if (child.is_directory()) {
-      std::ranges::move(
-          enumerate_files(child.path()), std::back_inserter(files));
+using ::f1_predict::is_legacy_result_file;
+using ::f1_predict::list_race_files;
+using ::f1_predict::manifest_summary;
+using ::f1_predict::pit_stop_table;
+using ::f1_predict::race_exists;
+using ::f1_predict::race_filter;
+using ::f1_predict::recover_write_transaction;
+using ::f1_predict::results_manifest;
+using ::f1_predict::results_table;
+
+f1_predict::race_dataset
+load_all_data(std::span<const std::string> file_paths, int thread_count) {
+  std::vector<fs::path> race_paths;
+  race_paths.reserve(file_paths.size());
+  // Per-driver files of the old layout still load as one result each.
+  std::vector<fs::path> legacy_paths;
+  std::size_t error_count = 0;
+  for (fs::path file_path : file_paths) {
+    if (!race_exists(file_path)) {
+      std::cerr << "File not found: \"" << file_path.string() << "\"\n";
+      ++error_count;
+      continue;
+    }
+    if (is_legacy_result_file(file_path)) {
+      legacy_paths.push_back(std::move(file_path));
+    } else {
+      race_paths.push_back(std::move(file_path));
     }
-    files.push_back(child.path());
   }
-  return files;
-}
 
-std::vector<f1_predict::DriverResult>
-load_all_data(std::span<std::string> file_paths) {
-  std::vector<f1_predict::DriverResult> data;
-  int error_count = 0;
-  for (fs::path file_path : file_paths) {
-    if (!fs::exists(file_path)) {
-      std::cerr << "File not found: " << file_path << std::endl;
+  f1_predict::race_dataset data;
+  for (std::size_t i : data.load_races(race_paths, thread_count)) {
+    std::cerr << "Failed to parse race from \"" << race_paths[i].string()
+              << "\"\n";
+    ++error_count;
+  }
+  std::vector<std::optional<f1_predict::DriverResult>> legacy_results =
+      f1_predict::load_results(legacy_paths, thread_count);
+  for (std::size_t i = 0; i < legacy_paths.size(); ++i) {
+    if (!legacy_results[i]) {
+      std::cerr << "Failed to parse result from \""
+                << legacy_paths[i].string() << "\"\n";
       ++error_count;
       continue;
     }
-    data.push_back(load_result(file_path));
+    data.add_result() = *std::move(legacy_results[i]);
   }
 
   if (error_count > 0) {
@@ -80,103 +146,252 @@ load_all_data(std::span<std::string> file_paths) {
   return data;
 }
 
-season_to_circuit_map_t
-organize_data(std::vector<f1_predict::DriverResult> raw_data) {
-  season_to_circuit_map_t organized;
-  for (f1_predict::DriverResult& result : raw_data) {
-    organized[result.race_season()][result.circuit()][result.driver()] =
-        std::move(result);
+f1_predict::race_dataset
+load_pack_data(const fs::path& pack_path, const race_filter& filter) {
+  std::optional<f1_predict::results_pack> pack =
+      f1_predict::results_pack::open(pack_path);
+  if (!pack) std::exit(1);
+
+  f1_predict::race_dataset data;
+  for (const f1_predict::results_pack_race& race : pack->races()) {
+    if (!filter.matches(
+            race.race_season,
+            static_cast<f1_predict::constants::Circuit>(race.circuit))) {
+      continue;
+    }
+    for (const f1_predict::packed_result& record : pack->race_records(race)) {
+      record.to_proto(data.add_result());
+    }
   }
-  return organized;
+  return data;
 }
 
-bool is_valid_duration(const google::protobuf::Duration& duration) {
-  return duration.seconds() || duration.nanos();
-}
+// Loads the archives of the seasons the filter selects, skipping seasons by
+// file name and, within a season, races by their circuit column.
+f1_predict::race_dataset
+load_archive_data(const fs::path& archive_dir, const race_filter& filter) {
+  std::vector<fs::path> archive_paths;
+  for (const fs::directory_entry& entry :
+       fs::directory_iterator{archive_dir}) {
+    int season = 0;
+    if (entry.path().extension() == f1_predict::SEASON_ARCHIVE_EXTENSION &&
+        absl::SimpleAtoi(entry.path().stem().string(), &season) &&
+        filter.matches_season(season)) {
+      archive_paths.push_back(entry.path());
+    }
+  }
+  std::ranges::sort(archive_paths);
 
-void filter_data(season_to_circuit_map_t& data) {
-  season_to_circuit_map_t filtered;
-
-  for (auto& [season, circuits] : data) {
-    for (auto& [circuit, drivers] : circuits) {
-      for (auto& [driver, results] : drivers) {
-        if (is_valid_duration(results.qualification_time_1()) ||
-            is_valid_duration(results.qualification_time_2()) ||
-            is_valid_duration(results.qualification_time_3())) {
-          filtered[season][circuit][driver] = std::move(results);
-        }
-      }
-      if (filtered[season][circuit].size() < 5) {
-        filtered[season].erase(circuit);
+  f1_predict::race_dataset data;
+  for (const fs::path& archive_path : archive_paths) {
+    std::optional<f1_predict::season_archive> archive =
+        f1_predict::season_archive::open(archive_path);
+    if (!archive) std::exit(1);
+    std::vector<int64_t> circuits(archive->race_count());
+    if (!archive->read_column(
+            f1_predict::archive_column::race_circuit, circuits)) {
+      std::exit(1);
+    }
+    if (std::ranges::none_of(circuits, [&](int64_t circuit) {
+          return filter.matches(
+              archive->race_season(),
+              static_cast<f1_predict::constants::Circuit>(circuit));
+        })) {
+      continue;
+    }
+
+    std::optional<std::vector<f1_predict::DriverResult>> results =
+        archive->read_results();
+    if (!results) std::exit(1);
+    for (f1_predict::DriverResult& result : *results) {
+      if (filter.matches(result.race_season(), result.circuit())) {
+        data.add_result() = std::move(result);
       }
     }
-    if (filtered[season].empty()) filtered.erase(season);
   }
+  return data;
+}
+
+race_filter parse_race_filter() {
+  race_filter filter;
+  const std::string seasons = absl::GetFlag(FLAGS_seasons);
+  if (!seasons.empty() && !f1_predict::parse_season_range(seasons, filter)) {
+    std::cerr << "Invalid --seasons range: " << seasons << std::endl;
+    std::exit(1);
+  }
+  for (const std::string& name : absl::GetFlag(FLAGS_circuits)) {
+    f1_predict::constants::Circuit circuit;
+    if (!f1_predict::constants::Circuit_Parse(name, &circuit)) {
+      std::cerr << "Unknown circuit: " << name << std::endl;
+      std::exit(1);
+    }
+    filter.circuits.push_back(circuit);
+  }
+  return filter;
+}
+
+void print_summary(std::string_view label, const manifest_summary& summary) {
+  std::cout << label << " " << summary.result_count << " results from "
+            << summary.race_count << " races over " << summary.season_count
+            << " seasons." << std::endl;
+}
+
+std::vector<std::string>
+find_race_files(const fs::path& results_dir, const race_filter& filter) {
+  std::vector<std::string> race_files;
+  std::optional<results_manifest> manifest;
+  if (absl::GetFlag(FLAGS_use_manifest)) {
+    manifest = results_manifest::load(results_dir);
+  }
+  // A manifest left behind by a change to the tree would silently drop or
+  // add races.
+  if (manifest && !manifest->lists_every_race()) {
+    std::cerr << "The manifest in " << results_dir
+              << " does not list the races there; scanning the tree instead."
+              << std::endl;
+    manifest.reset();
+  }
+  if (manifest) {
+    print_summary("Manifest lists", manifest->summarize());
+    print_summary("Selected", manifest->summarize(filter));
+    for (const fs::path& race_path : manifest->race_files(filter)) {
+      race_files.push_back(race_path.string());
+    }
+    return race_files;
+  }
+
+  for (const fs::path& race_path : list_race_files(results_dir)) {
+    if (filter.matches(race_path)) race_files.push_back(race_path.string());
+  }
+  std::cout << "Found " << race_files.size() << " races under " << results_dir
+            << std::endl;
+  return race_files;
+}
+
+// Prints how long loading took and how much memory it used, for comparing
+// loader changes.
+void report_load_stats(
+    const f1_predict::race_dataset& raw_data,
+    std::chrono::steady_clock::duration load_time) {
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  std::cout << "Loaded " << raw_data.size() << " results in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(load_time)
+                   .count()
+            << " ms. Peak RSS: " << usage.ru_maxrss / 1024 << " MiB."
+            << std::endl;
+}
+
+results_table organize_data(const f1_predict::race_dataset& raw_data) {
+  return results_table::from_results(raw_data.results());
+}
 
-  data = std::move(filtered);
+bool has_qual_time(const results_table::row& result) {
+  return result.qualification_time_1().count() ||
+      result.qualification_time_2().count() ||
+      result.qualification_time_3().count();
 }
 
-season_to_circuit_map_t extract_tests(season_to_circuit_map_t& data) {
+void filter_data(results_table& data) {
+  std::vector<std::size_t> kept_rows;
+  kept_rows.reserve(data.size());
+  for (const results_table::race_range& race : data.races()) {
+    std::size_t race_start = kept_rows.size();
+    for (std::size_t i = race.begin; i < race.end; ++i) {
+      if (has_qual_time(data[i])) kept_rows.push_back(i);
+    }
+    if (kept_rows.size() - race_start < 5) kept_rows.resize(race_start);
+  }
+
+  data = data.select_rows(kept_rows);
+}
+
+results_table extract_tests(results_table& data) {
   absl::BitGen bit_gen;
-  season_to_circuit_map_t tests;
-  for (auto& [season, circuits] : data) {
-    if (circuits.size() == 1) continue;
-    std::size_t pick = absl::Uniform(bit_gen, 0u, circuits.size());
-    std::size_t i = 0;
-    for (auto& [circuit, results] : circuits) {
-      if (++i == pick) {
-        tests[season][circuit] = std::move(results);
-        data[season].erase(circuit);
-        break;
-      }
+  std::vector<results_table::race_range> kept_races;
+  std::vector<results_table::race_range> test_races;
+  std::span<const results_table::race_range> races = data.races();
+  while (!races.empty()) {
+    int season = data[races.front().begin].race_season();
+    std::size_t season_size = 1;
+    while (season_size < races.size() &&
+           data[races[season_size].begin].race_season() == season) {
+      ++season_size;
     }
+
+    std::size_t pick =
+        season_size > 1 ? absl::Uniform(bit_gen, 0u, season_size) : 0;
+    for (std::size_t i = 0; i < season_size; ++i) {
+      (i + 1 == pick ? test_races : kept_races).push_back(races[i]);
+    }
+    races = races.subspan(season_size);
   }
+
+  results_table tests = data.select_races(test_races);
+  data = data.select_races(kept_races);
   return tests;
 }
 
-template <std::ranges::range ResultList>
-void add_race(f1_predict::historical_data& historical, const ResultList& race) {
-  for (const f1_predict::DriverResult& result : race) {
-    historical.circuit_drivers[result.circuit()][result.driver()]
-        .finals_positions.push_back(result.final_position());
-    historical.circuit_teams[result.circuit()][result.team()]
-        .finals_positions.push_back(result.final_position());
-    historical.driver_career[result.driver()].finals_positions.push_back(
+void add_race(
+    f1_predict::historical_data& historical,
+    const results_table& table,
+    results_table::race_range race,
+    const pit_stop_table& pit_stops) {
+  std::vector<f1_predict::constants::Team> pit_stop_teams;
+  for (std::size_t i = race.begin; i < race.end; ++i) {
+    results_table::row result = table[i];
+    historical.circuit_driver(result.circuit(), result.driver())
+        .finals_positions.add(result.final_position());
+    historical.circuit_team(result.circuit(), result.team())
+        .finals_positions.add(result.final_position());
+    historical.driver_career(result.driver()).finals_positions.add(
         result.final_position());
+
+    const f1_predict::pit_stop_summary* stops = pit_stops.find(
+        result.race_season(), result.circuit(), result.driver());
+    if (!stops) continue;
+    historical.circuit_driver(result.circuit(), result.driver())
+        .pit_stop_counts.add(stops->stop_count);
+    // Teammates share their team's median, which is counted once per race.
+    if (std::ranges::find(pit_stop_teams, result.team()) ==
+        pit_stop_teams.end()) {
+      pit_stop_teams.push_back(result.team());
+      historical.team_career(result.team()).pit_stop_times_ms.add(
+          stops->team_median_time_ms);
+    }
   }
 }
 
 void save_data(
-    const season_to_circuit_map_t& data, const fs::path& output_path) {
+    const results_table& data,
+    const fs::path& output_path,
+    const pit_stop_table& pit_stops) {
   f1_predict::writer out{output_path};
   f1_predict::historical_data historical;
   out.write_header();
 
-  auto [first_season, last_season] =
-      std::ranges::minmax_element(data | std::views::keys);
-
-  for (int season = *first_season; season <= *last_season; ++season) {
-    auto itr = data.find(season);
-    if (itr == data.end()) continue;
-    for (const auto& race : itr->second | std::views::values) {
-      out.write_race(
-          race | std::views::values | std::ranges::to<std::vector>(),
-          historical);
-      add_race(historical, race | std::views::values);
-    }
+  for (const results_table::race_range& race : data.races()) {
+    out.write_race(data, race, historical);
+    add_race(historical, data, race, pit_stops);
   }
 }
 
 int main(int argc, char** argv) {
   std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  f1_predict::set_result_cache_dir(absl::GetFlag(FLAGS_result_cache_dir));
   auto input_files =
       args | std::views::drop(1) | std::ranges::to<std::vector<std::string>>();
-  if (input_files.empty() && !absl::GetFlag(FLAGS_results_dir).empty()) {
-    input_files = enumerate_files(absl::GetFlag(FLAGS_results_dir));
-    std::cout << "Found " << input_files.size() << " files under "
-              << absl::GetFlag(FLAGS_results_dir) << std::endl;
+  const fs::path results_pack = absl::GetFlag(FLAGS_results_pack);
+  const fs::path results_archive = absl::GetFlag(FLAGS_results_archive);
+  const fs::path results_dir = absl::GetFlag(FLAGS_results_dir);
+  const race_filter filter = parse_race_filter();
+  // Finish or undo an import that was interrupted while writing the tree.
+  if (!results_dir.empty()) recover_write_transaction(results_dir);
+  if (input_files.empty() && results_pack.empty() && results_archive.empty() &&
+      !results_dir.empty()) {
+    input_files = find_race_files(results_dir, filter);
   }
-  if (input_files.empty()) {
+  if (input_files.empty() && results_pack.empty() && results_archive.empty()) {
     std::cerr << "Must specify at least 1 source file." << std::endl;
     return 1;
   }
@@ -197,13 +412,30 @@ int main(int argc, char** argv) {
     fs::create_directories(tests_file.parent_path());
   }
 
-  auto raw_data = load_all_data(input_files);
-  season_to_circuit_map_t data = organize_data(std::move(raw_data));
+  auto load_start = std::chrono::steady_clock::now();
+  f1_predict::race_dataset raw_data;
+  if (!input_files.empty()) {
+    raw_data = load_all_data(input_files, absl::GetFlag(FLAGS_load_threads));
+  } else if (!results_archive.empty()) {
+    raw_data = load_archive_data(results_archive, filter);
+  } else {
+    raw_data = load_pack_data(results_pack, filter);
+  }
+  results_table data = organize_data(raw_data);
+  if (absl::GetFlag(FLAGS_report_load_stats)) {
+    report_load_stats(raw_data, std::chrono::steady_clock::now() - load_start);
+  }
   filter_data(data);
-  season_to_circuit_map_t tests = extract_tests(data);
+  results_table tests = extract_tests(data);
 
-  save_data(data, training_file);
-  save_data(tests, tests_file);
+  pit_stop_table pit_stops;
+  if (const fs::path path = absl::GetFlag(FLAGS_pit_stops); !path.empty()) {
+    std::optional<pit_stop_table> table = pit_stop_table::load(path);
+    if (!table) return 1;
+    pit_stops = *std::move(table);
+  }
+  save_data(data, training_file, pit_stops);
+  save_data(tests, tests_file, pit_stops);
 
   return 0;
 }
@@ -0,0 +1,147 @@
+#include "model/results_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/proto_utils.h"
+#include "data/race_results.pb.h"
+#include "google/protobuf/duration.pb.h"
+
+namespace f1_predict {
+namespace {
+
+int32_t to_table_time(const google::protobuf::Duration& duration) {
+  return static_cast<int32_t>(to_milliseconds(duration).count());
+}
+
+auto race_key(const DriverResult& result) {
+  return std::make_tuple(
+      result.race_season(), result.circuit(), result.driver());
+}
+
+} // namespace
+
+results_table
+results_table::from_results(std::span<const DriverResult> results) {
+  std::vector<const DriverResult*> pointers;
+  pointers.reserve(results.size());
+  for (const DriverResult& result : results) pointers.push_back(&result);
+  return from_results(pointers);
+}
+
+results_table
+results_table::from_results(std::span<const DriverResult* const> results) {
+  std::vector<size_t> order(results.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, [&](size_t a, size_t b) {
+    return race_key(*results[a]) < race_key(*results[b]);
+  });
+
+  results_table table;
+  table.reserve(results.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    const DriverResult& result = *results[order[i]];
+    if (i + 1 < order.size() &&
+        race_key(result) == race_key(*results[order[i + 1]])) {
+      continue;
+    }
+    table.append_row(result);
+  }
+  table.index_races();
+  return table;
+}
+
+results_table results_table::select_rows(std::span<const size_t> rows) const {
+  results_table table;
+  table.reserve(rows.size());
+  for (size_t index : rows) table.append_row(*this, index);
+  table.index_races();
+  return table;
+}
+
+results_table
+results_table::select_races(std::span<const race_range> races) const {
+  size_t row_count = 0;
+  for (const race_range& race : races) row_count += race.size();
+
+  results_table table;
+  table.reserve(row_count);
+  for (const race_range& race : races) {
+    for (size_t i = race.begin; i < race.end; ++i) table.append_row(*this, i);
+  }
+  table.index_races();
+  return table;
+}
+
+void results_table::append_row(const DriverResult& result) {
+  _seasons.push_back(result.race_season());
+  _circuits.push_back(result.circuit());
+  _teams.push_back(result.team());
+  _drivers.push_back(result.driver());
+  _starting_positions.push_back(result.starting_position());
+  _final_positions.push_back(result.final_position());
+  _finals_lap_counts.push_back(result.finals_lap_count());
+  _qualification_time_1.push_back(
+      to_table_time(result.qualification_time_1()));
+  _qualification_time_2.push_back(
+      to_table_time(result.qualification_time_2()));
+  _qualification_time_3.push_back(
+      to_table_time(result.qualification_time_3()));
+  _qualification_fastest_lap_time.push_back(
+      to_table_time(result.qualification_fastest_lap_time()));
+  _finals_time.push_back(to_table_time(result.finals_time()));
+  _finals_fastest_lap_time.push_back(
+      to_table_time(result.finals_fastest_lap_time()));
+}
+
+void results_table::append_row(const results_table& source, size_t index) {
+  _seasons.push_back(source._seasons[index]);
+  _circuits.push_back(source._circuits[index]);
+  _teams.push_back(source._teams[index]);
+  _drivers.push_back(source._drivers[index]);
+  _starting_positions.push_back(source._starting_positions[index]);
+  _final_positions.push_back(source._final_positions[index]);
+  _finals_lap_counts.push_back(source._finals_lap_counts[index]);
+  _qualification_time_1.push_back(source._qualification_time_1[index]);
+  _qualification_time_2.push_back(source._qualification_time_2[index]);
+  _qualification_time_3.push_back(source._qualification_time_3[index]);
+  _qualification_fastest_lap_time.push_back(
+      source._qualification_fastest_lap_time[index]);
+  _finals_time.push_back(source._finals_time[index]);
+  _finals_fastest_lap_time.push_back(source._finals_fastest_lap_time[index]);
+}
+
+void results_table::reserve(size_t size) {
+  _seasons.reserve(size);
+  _circuits.reserve(size);
+  _teams.reserve(size);
+  _drivers.reserve(size);
+  _starting_positions.reserve(size);
+  _final_positions.reserve(size);
+  _finals_lap_counts.reserve(size);
+  _qualification_time_1.reserve(size);
+  _qualification_time_2.reserve(size);
+  _qualification_time_3.reserve(size);
+  _qualification_fastest_lap_time.reserve(size);
+  _finals_time.reserve(size);
+  _finals_fastest_lap_time.reserve(size);
+}
+
+void results_table::index_races() {
+  _races.clear();
+  for (size_t i = 0; i < size(); ++i) {
+    if (_races.empty() || _seasons[i] != _seasons[i - 1] ||
+        _circuits[i] != _circuits[i - 1]) {
+      _races.push_back({.begin = i, .end = i});
+    }
+    ++_races.back().end;
+  }
+}
+
+} // namespace f1_predict
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+
+namespace f1_predict {
+
+// Column-oriented table of driver results.
+//
+// Rows are sorted by season, then circuit, then driver. The results tree has no
+// round numbers, so the circuit stands in for the order of races within a
+// season. Every race occupies a contiguous range of rows listed by `races()`.
+// Times are stored as whole milliseconds with 0 meaning unset.
+class results_table {
+public:
+  struct race_range {
+    size_t begin;
+    size_t end;
+
+    size_t size() const { return end - begin; }
+  };
+
+  // Lightweight view of a single row, with accessors named after the matching
+  // DriverResult fields.
+  class row {
+  public:
+    row(const results_table& table, size_t index)
+        : _table{&table}, _index{index} {}
+
+    size_t index() const { return _index; }
+    int race_season() const { return _table->_seasons[_index]; }
+    constants::Circuit circuit() const { return _table->_circuits[_index]; }
+    constants::Team team() const { return _table->_teams[_index]; }
+    constants::Driver driver() const { return _table->_drivers[_index]; }
+    int starting_position() const {
+      return _table->_starting_positions[_index];
+    }
+    int final_position() const { return _table->_final_positions[_index]; }
+    int finals_lap_count() const {
+      return _table->_finals_lap_counts[_index];
+    }
+    std::chrono::milliseconds qualification_time_1() const {
+      return std::chrono::milliseconds{_table->_qualification_time_1[_index]};
+    }
+    std::chrono::milliseconds qualification_time_2() const {
+      return std::chrono::milliseconds{_table->_qualification_time_2[_index]};
+    }
+    std::chrono::milliseconds qualification_time_3() const {
+      return std::chrono::milliseconds{_table->_qualification_time_3[_index]};
+    }
+    std::chrono::milliseconds qualification_fastest_lap_time() const {
+      return std::chrono::milliseconds{
+          _table->_qualification_fastest_lap_time[_index]};
+    }
+    std::chrono::milliseconds finals_time() const {
+      return std::chrono::milliseconds{_table->_finals_time[_index]};
+    }
+    std::chrono::milliseconds finals_fastest_lap_time() const {
+      return std::chrono::milliseconds{
+          _table->_finals_fastest_lap_time[_index]};
+    }
+
+  private:
+    const results_table* _table;
+    size_t _index;
+  };
+
+  results_table() = default;
+
+  // Builds a sorted table from the given results. When several results share a
+  // season, circuit, and driver, the last one wins.
+  static results_table from_results(std::span<const DriverResult> results);
+  // Same as above, for results owned elsewhere, e.g. by a race_dataset.
+  static results_table
+  from_results(std::span<const DriverResult* const> results);
+
+  size_t size() const { return _seasons.size(); }
+  bool empty() const { return _seasons.empty(); }
+  row operator[](size_t index) const { return row{*this, index}; }
+  std::span<const race_range> races() const { return _races; }
+
+  std::span<const int32_t> seasons() const { return _seasons; }
+  std::span<const constants::Circuit> circuits() const { return _circuits; }
+  std::span<const constants::Driver> drivers() const { return _drivers; }
+  std::span<const constants::Team> teams() const { return _teams; }
+  std::span<const int32_t> final_positions() const { return _final_positions; }
+
+  // Copies the given rows, in order, into a new table. The rows must already
+  // be grouped by race.
+  results_table select_rows(std::span<const size_t> rows) const;
+
+  // Copies the given races, in order, into a new table.
+  results_table select_races(std::span<const race_range> races) const;
+
+private:
+  void append_row(const DriverResult& result);
+  void append_row(const results_table& source, size_t index);
+  void reserve(size_t size);
+  void index_races();
+
+  std::vector<int32_t> _seasons;
+  std::vector<constants::Circuit> _circuits;
+  std::vector<constants::Team> _teams;
+  std::vector<constants::Driver> _drivers;
+  std::vector<int32_t> _starting_positions;
+  std::vector<int32_t> _final_positions;
+  std::vector<int32_t> _finals_lap_counts;
+  std::vector<int32_t> _qualification_time_1;
+  std::vector<int32_t> _qualification_time_2;
+  std::vector<int32_t> _qualification_time_3;
+  std::vector<int32_t> _qualification_fastest_lap_time;
+  std::vector<int32_t> _finals_time;
+  std::vector<int32_t> _finals_fastest_lap_time;
+  std::vector<race_range> _races;
+};
+
+} // namespace f1_predict
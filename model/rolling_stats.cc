@@ -0,0 +1,62 @@
+#include "model/rolling_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace f1_predict {
+
+void rolling_stats::add(int value) {
+  if (_count >= SHORT_WINDOW) _short_sum -= recent(SHORT_WINDOW - 1);
+  if (_count >= LONG_WINDOW) _long_sum -= recent(LONG_WINDOW - 1);
+  _recent[_count % LONG_WINDOW] = value;
+  _short_sum += value;
+  _long_sum += value;
+
+  ++_count;
+  _sum += value;
+  double delta = value - _mean;
+  _mean += delta / _count;
+  _squared_deviations += delta * (value - _mean);
+}
+
+double rolling_stats::average() const {
+  return static_cast<double>(_sum) / _count;
+}
+
+double rolling_stats::standard_deviation() const {
+  if (_count <= 1) return 0.0;
+  return std::sqrt(_squared_deviations / _count);
+}
+
+double rolling_stats::recent_average(size_t window) const {
+  size_t size = std::min(window, _count);
+  int64_t sum = 0;
+  if (window == SHORT_WINDOW) {
+    sum = _short_sum;
+  } else if (window == LONG_WINDOW) {
+    sum = _long_sum;
+  } else {
+    for (size_t age = 0; age < size; ++age) sum += recent(age);
+  }
+  return static_cast<double>(sum) / size;
+}
+
+double rolling_stats::recent_standard_deviation(size_t window) const {
+  size_t size = std::min(window, _count);
+  if (size <= 1) return 0.0;
+  // Two passes from the oldest value to the newest, which is how the values
+  // were summed before they were kept here.
+  double sum = 0.0;
+  for (size_t age = size; age-- > 0;) sum += recent(age);
+  double mean = sum / size;
+  double squared_deviations = 0.0;
+  for (size_t age = size; age-- > 0;) {
+    double deviation = recent(age) - mean;
+    squared_deviations += deviation * deviation;
+  }
+  return std::sqrt(squared_deviations / size);
+}
+
+} // namespace f1_predict
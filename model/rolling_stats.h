@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace f1_predict {
+
+// Running statistics of a growing sequence of integers, such as a driver's
+// finishing positions, updated in constant time per value.
+//
+// The all-time variance uses Welford's method. The last LONG_WINDOW values are
+// kept in a ring buffer, with running sums over the last SHORT_WINDOW and
+// LONG_WINDOW of them. Averages come from exact integer sums, so they equal
+// averaging the values directly, bit for bit. So do the recent standard
+// deviations, which are computed from the ring in the same order.
+class rolling_stats {
+public:
+  static constexpr size_t SHORT_WINDOW = 3;
+  static constexpr size_t LONG_WINDOW = 6;
+
+  void add(int value);
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+
+  // Mean of every value. Must not be empty.
+  double average() const;
+  // Population standard deviation of every value, or 0 with fewer than two.
+  double standard_deviation() const;
+
+  // Mean of the last `window` values, or of all of them when there are fewer.
+  // `window` must be at most LONG_WINDOW, and is a constant-time sum for
+  // SHORT_WINDOW and LONG_WINDOW. Must not be empty.
+  double recent_average(size_t window) const;
+  // Population standard deviation of the same values as `recent_average`, or
+  // 0 with fewer than two.
+  double recent_standard_deviation(size_t window) const;
+
+private:
+  // Returns the `age`th most recent value, counting the last one as 0.
+  int recent(size_t age) const {
+    return _recent[(_count - 1 - age) % LONG_WINDOW];
+  }
+
+  size_t _count = 0;
+  int64_t _sum = 0;
+  double _mean = 0;
+  double _squared_deviations = 0;
+  std::array<int, LONG_WINDOW> _recent{};
+  int64_t _short_sum = 0;
+  int64_t _long_sum = 0;
+};
+
+} // namespace f1_predict
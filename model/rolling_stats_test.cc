@@ -0,0 +1,69 @@
+#include "model/rolling_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+std::span<const int> last_n(const std::vector<int>& values, size_t n) {
+  return std::span{values}.last(std::min(n, values.size()));
+}
+
+double direct_average(std::span<const int> values) {
+  return static_cast<double>(std::accumulate(values.begin(), values.end(), 0)) /
+      values.size();
+}
+
+double direct_standard_deviation(std::span<const int> values) {
+  if (values.size() <= 1) return 0.0;
+  double mean =
+      std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+  double squared_deviations = 0.0;
+  for (int value : values) {
+    squared_deviations += (value - mean) * (value - mean);
+  }
+  return std::sqrt(squared_deviations / values.size());
+}
+
+TEST(RollingStatsTest, StartsEmpty) {
+  rolling_stats stats;
+  EXPECT_TRUE(stats.empty());
+  EXPECT_EQ(stats.size(), 0);
+  EXPECT_EQ(stats.standard_deviation(), 0.0);
+  EXPECT_EQ(stats.recent_standard_deviation(rolling_stats::SHORT_WINDOW), 0.0);
+}
+
+TEST(RollingStatsTest, MatchesStatisticsOfAllValues) {
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> position{1, 20};
+  rolling_stats stats;
+  std::vector<int> values;
+  for (int i = 0; i < 200; ++i) {
+    values.push_back(position(random));
+    stats.add(values.back());
+
+    ASSERT_EQ(stats.size(), values.size());
+    EXPECT_EQ(stats.average(), direct_average(values));
+    EXPECT_NEAR(
+        stats.standard_deviation(), direct_standard_deviation(values), 1e-12);
+    for (size_t window = 1; window <= rolling_stats::LONG_WINDOW; ++window) {
+      EXPECT_EQ(
+          stats.recent_average(window),
+          direct_average(last_n(values, window)));
+      EXPECT_EQ(
+          stats.recent_standard_deviation(window),
+          direct_standard_deviation(last_n(values, window)));
+    }
+  }
+}
+
+} // namespace
+} // namespace f1_predict
@@ -1,26 +1,26 @@
 #include "model/writer.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
-#include <fstream>
-#include <iomanip>
-#include <ostream>
+#include <cmath>
+#include <limits>
 #include <span>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "data/constants.pb.h"
-#include "data/proto_utils.h"
 #include "data/race_results.pb.h"
-#include "google/protobuf/duration.pb.h"
+#include "model/csv_sink.h"
+#include "model/results_table.h"
 
 namespace f1_predict {
 namespace {
 
-using ::google::protobuf::Duration;
 using ::std::chrono::duration_cast;
 using ::std::chrono::milliseconds;
 
@@ -28,7 +28,12 @@ constexpr int64_t DEFAULT_NUMBER = 999999999;
 constexpr milliseconds DEFAULT_TIME{DEFAULT_NUMBER};
 constexpr milliseconds ZERO_MS{0};
 constexpr std::string NA = "NA";
+constexpr size_t NO_TEAMMATE = std::numeric_limits<size_t>::max();
 
+// Values of a race that columns share, computed once per race. The per-driver
+// vectors are indexed like the rows of the race, which are in order of result,
+// so columns comparing a driver with the rest of the grid only index into
+// them.
 struct aggregate_data {
   size_t race_id;
   size_t race_size;
@@ -36,85 +41,140 @@ struct aggregate_data {
   milliseconds worst_qual_time;
   milliseconds qual_spread;
   milliseconds median_qual_time;
+
+  // DEFAULT_TIME for drivers without a qualifying time.
+  std::vector<milliseconds> best_qual_times;
+  std::vector<milliseconds> gaps_to_pole;
+  // Ranks of the drivers with a qualifying time, from 1 for pole, with equal
+  // times sharing a rank. 0 for the others.
+  std::vector<int> qual_ranks;
+  // Standard scores of the qualifying times among the drivers with one. NaN
+  // for the others, or when there are no two different times.
+  std::vector<double> qual_z_scores;
+  // The fastest other driver of the same team with a qualifying time, for
+  // drivers with one, and the gap to them. NO_TEAMMATE when there is none.
+  std::vector<size_t> teammates;
+  std::vector<milliseconds> teammate_gaps;
 };
 
-struct result_data {
+// Values several columns of a row share, computed once per row.
+struct row_data {
   size_t index;
-  const DriverResult& driver;
+  results_table::row driver;
+  const historical_data::stats* circuit_driver_stats;
+  const historical_data::stats* circuit_team_stats;
+  const historical_data::stats* driver_career_stats;
+  const historical_data::stats* team_career_stats;
 };
 
-milliseconds time_or_default(
-    const Duration& duration, milliseconds default_value = DEFAULT_TIME) {
-  milliseconds mils = to_milliseconds(duration);
-  return mils.count() > 0 ? mils : default_value;
+milliseconds
+time_or_default(milliseconds time, milliseconds default_value = DEFAULT_TIME) {
+  return time.count() > 0 ? time : default_value;
 }
 
-std::string time_or_na(const Duration& duration) {
-  milliseconds ms = time_or_default(duration);
-  return ms == DEFAULT_TIME ? NA : std::to_string(ms.count());
+void write_time_or_na(csv_sink& out, milliseconds time) {
+  milliseconds ms = time_or_default(time);
+  if (ms == DEFAULT_TIME) {
+    out << NA;
+  } else {
+    out << ms.count();
+  }
 }
 
-milliseconds best_qual_time(const DriverResult& result) {
+milliseconds best_qual_time(const results_table::row& result) {
   return std::min(
       {time_or_default(result.qualification_time_1()),
        time_or_default(result.qualification_time_2()),
        time_or_default(result.qualification_time_3())});
 }
 
-template <
-    std::ranges::range Values,
-    std::enable_if_t<!std::is_integral_v<std::ranges::range_value_t<Values>>>* =
-        nullptr>
-auto average(const Values& values) {
-  using namespace std::ranges;
-  return std::accumulate(begin(values), end(values), range_value_t<Values>{0}) /
-      size(values);
-}
-
-template <
-    std::ranges::range Values,
-    std::enable_if_t<std::is_integral_v<std::ranges::range_value_t<Values>>>* =
-        nullptr>
-double average(const Values& values) {
-  using namespace std::ranges;
-  return static_cast<double>(std::accumulate(
-             begin(values), end(values), range_value_t<Values>{0})) /
-      size(values);
-}
-
-const historical_data::stats* find_historical_circuit_driver_data(
-    const historical_data& data, const DriverResult& race) {
-  auto circuit_itr = data.circuit_drivers.find(race.circuit());
-  if (circuit_itr != data.circuit_drivers.end()) {
-    auto drivers_itr = circuit_itr->second.find(race.driver());
-    if (drivers_itr != circuit_itr->second.end()) return &drivers_itr->second;
+// Fills in the qualifying values of `aggregate` for the rows of a race, in
+// order of result. Apart from ranking, which sorts the grid, each is a single
+// pass over it.
+void add_qual_context(
+    std::span<const results_table::row> results, aggregate_data& aggregate) {
+  size_t size = results.size();
+  aggregate.best_qual_time = milliseconds::max();
+  aggregate.best_qual_times.resize(size);
+  std::vector<size_t> qual_order;
+  qual_order.reserve(size);
+  double qual_time_sum = 0.0;
+  for (size_t i = 0; i < size; ++i) {
+    milliseconds time = best_qual_time(results[i]);
+    aggregate.best_qual_times[i] = time;
+    aggregate.best_qual_time = std::min(aggregate.best_qual_time, time);
+    if (time != DEFAULT_TIME) {
+      aggregate.worst_qual_time = std::max(aggregate.worst_qual_time, time);
+      qual_order.push_back(i);
+      qual_time_sum += time.count();
+    }
   }
-  return nullptr;
-}
 
-const historical_data::stats* find_historical_circuit_team_data(
-    const historical_data& data, const DriverResult& race) {
-  auto circuit_itr = data.circuit_teams.find(race.circuit());
-  if (circuit_itr != data.circuit_teams.end()) {
-    auto team_itr = circuit_itr->second.find(race.team());
-    if (team_itr != circuit_itr->second.end()) return &team_itr->second;
+  const std::vector<milliseconds>& times = aggregate.best_qual_times;
+  if (size % 2 == 1) {
+    aggregate.median_qual_time = times[size / 2];
+  } else {
+    aggregate.median_qual_time = (times[size / 2] + times[size / 2 - 1]) / 2;
+  }
+  aggregate.gaps_to_pole.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    aggregate.gaps_to_pole[i] = times[i] - aggregate.best_qual_time;
   }
-  return nullptr;
-}
 
-const historical_data::stats* find_historical_driver_career_data(
-    const historical_data& data, const DriverResult& race) {
-  auto driver_itr = data.driver_career.find(race.driver());
-  if (driver_itr != data.driver_career.end()) { return &driver_itr->second; }
-  return nullptr;
-}
+  // Equal times keep the order of result, like a stable sort would.
+  std::ranges::sort(qual_order, [&times](size_t a, size_t b) {
+    return std::pair{times[a], a} < std::pair{times[b], b};
+  });
+  aggregate.qual_ranks.assign(size, 0);
+  for (size_t k = 0; k < qual_order.size(); ++k) {
+    size_t i = qual_order[k];
+    bool tied = k > 0 && times[i] == times[qual_order[k - 1]];
+    aggregate.qual_ranks[i] = tied ? aggregate.qual_ranks[qual_order[k - 1]]
+                                   : static_cast<int>(k + 1);
+  }
+
+  aggregate.qual_z_scores.assign(size, std::nan(""));
+  if (!qual_order.empty()) {
+    double mean = qual_time_sum / qual_order.size();
+    double squared_deviations = 0.0;
+    for (size_t i : qual_order) {
+      double deviation = times[i].count() - mean;
+      squared_deviations += deviation * deviation;
+    }
+    double stddev = std::sqrt(squared_deviations / qual_order.size());
+    if (stddev > 0.0) {
+      for (size_t i : qual_order) {
+        aggregate.qual_z_scores[i] = (times[i].count() - mean) / stddev;
+      }
+    }
+  }
 
-template <std::ranges::range Container>
-auto last_n(Container&& container, int64_t n) {
-  return std::ranges::subrange(
-      std::ranges::begin(container) +
-          std::max(0l, static_cast<int64_t>(std::ranges::size(container)) - n),
-      std::ranges::end(container));
+  // In qualifying order, the first driver of each team is its fastest, and
+  // the second is the fastest's teammate.
+  std::array<size_t, constants::Team_ARRAYSIZE> fastest_of_team;
+  fastest_of_team.fill(NO_TEAMMATE);
+  aggregate.teammates.assign(size, NO_TEAMMATE);
+  aggregate.teammate_gaps.assign(size, ZERO_MS);
+  for (size_t i : qual_order) {
+    size_t team = results[i].team();
+    if (team == constants::TEAM_UNSPECIFIED || team >= fastest_of_team.size()) {
+      continue;
+    }
+    size_t fastest = fastest_of_team[team];
+    if (fastest == NO_TEAMMATE) {
+      fastest_of_team[team] = i;
+      continue;
+    }
+    aggregate.teammates[i] = fastest;
+    if (aggregate.teammates[fastest] == NO_TEAMMATE) {
+      aggregate.teammates[fastest] = i;
+    }
+  }
+  for (size_t i : qual_order) {
+    if (aggregate.teammates[i] != NO_TEAMMATE) {
+      aggregate.teammate_gaps[i] = times[i] - times[aggregate.teammates[i]];
+    }
+  }
 }
 
 template <std::ranges::range Container>
@@ -136,491 +196,442 @@ double standard_deviation(const Container& container) {
   return std::sqrt(sq_diff_sum / size);
 }
 
-} // namespace
-
-namespace writer_internal {
-
-class column_writer {
-public:
-  column_writer() = default;
-  virtual ~column_writer() = default;
-  virtual void write_header(std::ostream& out) const = 0;
-  virtual void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data& aggregate,
-      const historical_data& historical) const = 0;
-};
-
-} // namespace writer_internal
+// Each column is a type with its header `name` and a static `write` that
+// writes its value in a row. They are listed in order by `training_columns`.
 
-namespace {
-
-class relevance_label_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "relevance_label";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data& aggregate,
-      const historical_data&) const override {
-    out << (aggregate.race_size - result.index);
+struct relevance_label_column {
+  static constexpr std::string_view name = "relevance_label";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    out << (aggregate.race_size - row.index);
   }
 };
 
-class race_id_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "race_id"; }
-  void write_column(
-      std::ostream& out,
-      const result_data&,
-      const aggregate_data& aggregate,
-      const historical_data&) const override {
+struct race_id_column {
+  static constexpr std::string_view name = "race_id";
+  static void
+  write(csv_sink& out, const row_data&, const aggregate_data& aggregate) {
     out << aggregate.race_id;
   }
 };
 
-class circuit_id_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "circuit_id"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << result.driver.circuit();
+struct circuit_id_column {
+  static constexpr std::string_view name = "circuit_id";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    out << row.driver.circuit();
   }
 };
 
-class season_id_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "season_id"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << (result.driver.race_season() - 1900);
+struct season_id_column {
+  static constexpr std::string_view name = "season_id";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    out << (row.driver.race_season() - 1900);
   }
 };
 
-class team_id_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "team_id"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << result.driver.team();
+struct team_id_column {
+  static constexpr std::string_view name = "team_id";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    out << row.driver.team();
   }
 };
 
-class driver_id_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "driver_id"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << result.driver.driver();
+struct driver_id_column {
+  static constexpr std::string_view name = "driver_id";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    out << row.driver.driver();
   }
 };
 
-class qual_spread_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "qual_spread_msec";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data& aggregate,
-      const historical_data&) const override {
+struct qual_spread_column {
+  static constexpr std::string_view name = "qual_spread_msec";
+  static void
+  write(csv_sink& out, const row_data&, const aggregate_data& aggregate) {
     out << duration_cast<milliseconds>(
                aggregate.worst_qual_time - aggregate.best_qual_time)
                .count();
   }
 };
 
-class starting_position_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "starting_position";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << result.driver.starting_position();
+struct starting_position_column {
+  static constexpr std::string_view name = "starting_position";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    out << row.driver.starting_position();
   }
 };
 
-class q1_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "q1_time_msec"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << time_or_na(result.driver.qualification_time_1());
+struct q1_time_column {
+  static constexpr std::string_view name = "q1_time_msec";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    write_time_or_na(out, row.driver.qualification_time_1());
   }
 };
 
-class q2_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "q2_time_msec"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << time_or_na(result.driver.qualification_time_2());
+struct q2_time_column {
+  static constexpr std::string_view name = "q2_time_msec";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    write_time_or_na(out, row.driver.qualification_time_2());
   }
 };
 
-class q3_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override { out << "q3_time_msec"; }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << time_or_na(result.driver.qualification_time_3());
+struct q3_time_column {
+  static constexpr std::string_view name = "q3_time_msec";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    write_time_or_na(out, row.driver.qualification_time_3());
   }
 };
 
-class driver_best_qual_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_best_qual_time_msec";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    out << best_qual_time(result.driver).count();
+struct driver_best_qual_time_column {
+  static constexpr std::string_view name = "driver_best_qual_time_msec";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    out << aggregate.best_qual_times[row.index].count();
   }
 };
 
-class gap_to_best_qual_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "gap_to_best_qual_time_msec";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data& aggregate,
-      const historical_data&) const override {
-    out << best_qual_time(result.driver).count() -
-            duration_cast<milliseconds>(aggregate.best_qual_time).count();
+struct gap_to_best_qual_time_column {
+  static constexpr std::string_view name = "gap_to_best_qual_time_msec";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    out << aggregate.gaps_to_pole[row.index].count();
   }
 };
 
-class gap_to_median_qual_time_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "gap_to_median_qual_time_msec";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data& aggregate,
-      const historical_data&) const override {
-    out << best_qual_time(result.driver).count() -
-            duration_cast<milliseconds>(aggregate.median_qual_time).count();
+struct gap_to_median_qual_time_column {
+  static constexpr std::string_view name = "gap_to_median_qual_time_msec";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    out << (aggregate.best_qual_times[row.index] - aggregate.median_qual_time)
+               .count();
   }
 };
 
-class qual_consistency_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "qual_consistency_stddev";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data&) const override {
-    std::vector<double> qual_times;
-    if (to_milliseconds(result.driver.qualification_time_1()) != ZERO_MS) {
-      qual_times.push_back(
-          to_milliseconds(result.driver.qualification_time_1()).count());
-    }
-    if (to_milliseconds(result.driver.qualification_time_2()) != ZERO_MS) {
-      qual_times.push_back(
-          to_milliseconds(result.driver.qualification_time_2()).count());
-    }
-    if (to_milliseconds(result.driver.qualification_time_3()) != ZERO_MS) {
-      qual_times.push_back(
-          to_milliseconds(result.driver.qualification_time_3()).count());
+struct qual_consistency_column {
+  static constexpr std::string_view name = "qual_consistency_stddev";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    std::array<double, 3> qual_times;
+    size_t qual_count = 0;
+    for (milliseconds time :
+         {row.driver.qualification_time_1(),
+          row.driver.qualification_time_2(),
+          row.driver.qualification_time_3()}) {
+      if (time != ZERO_MS) qual_times[qual_count++] = time.count();
     }
-    if (qual_times.size() <= 1) {
+    if (qual_count <= 1) {
       out << NA;
       return;
     }
-    double stddev = standard_deviation(qual_times);
-    out << std::setprecision(6) << std::fixed
-        << (std::isnan(stddev) ? 0.0 : stddev);
+    double stddev =
+        standard_deviation(std::span{qual_times}.first(qual_count));
+    // Leaves the sink in fixed notation for every later double, which the
+    // training files have always relied on.
+    out.set_fixed(6);
+    out << (std::isnan(stddev) ? 0.0 : stddev);
   }
 };
 
-class driver_average_result_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_average_result";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* driver_stats =
-        find_historical_circuit_driver_data(historical, result.driver);
-    if (driver_stats) {
-      out << average(driver_stats->finals_positions);
+struct driver_average_result_column {
+  static constexpr std::string_view name = "driver_average_result";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    if (row.circuit_driver_stats) {
+      out << row.circuit_driver_stats->finals_positions.average();
     } else {
       out << NA;
     }
   }
 };
 
-class driver_circuit_result_stddev_column :
-    public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_circuit_result_stddev";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* driver_stats =
-        find_historical_circuit_driver_data(historical, result.driver);
+struct driver_circuit_result_stddev_column {
+  static constexpr std::string_view name = "driver_circuit_result_stddev";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    const auto* driver_stats = row.circuit_driver_stats;
     if (driver_stats && driver_stats->finals_positions.size() > 1) {
-      out << standard_deviation(driver_stats->finals_positions);
+      out << driver_stats->finals_positions.standard_deviation();
     } else {
       out << NA;
     }
   }
 };
 
-class driver_recent_circuit_result_stddev_column :
-    public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_recent_circuit_result_stddev";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* driver_stats =
-        find_historical_circuit_driver_data(historical, result.driver);
+struct driver_recent_circuit_result_stddev_column {
+  static constexpr std::string_view name =
+      "driver_recent_circuit_result_stddev";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    const auto* driver_stats = row.circuit_driver_stats;
     if (driver_stats && driver_stats->finals_positions.size() > 1) {
-      out << standard_deviation(last_n(driver_stats->finals_positions, 3));
+      out << driver_stats->finals_positions.recent_standard_deviation(
+          rolling_stats::SHORT_WINDOW);
     } else {
       out << NA;
     }
   }
 };
 
-class driver_recent_average_result_column :
-    public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_recent_average_result";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* driver_stats =
-        find_historical_circuit_driver_data(historical, result.driver);
-    if (driver_stats) {
-      out << average(last_n(driver_stats->finals_positions, 3));
+struct driver_recent_average_result_column {
+  static constexpr std::string_view name = "driver_recent_average_result";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    if (row.circuit_driver_stats) {
+      out << row.circuit_driver_stats->finals_positions.recent_average(
+          rolling_stats::SHORT_WINDOW);
     } else {
       out << NA;
     }
   }
 };
 
-class driver_career_stddev_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "driver_career_stddev";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* driver_stats =
-        find_historical_driver_career_data(historical, result.driver);
+struct driver_career_stddev_column {
+  static constexpr std::string_view name = "driver_career_stddev";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    const auto* driver_stats = row.driver_career_stats;
     if (driver_stats && driver_stats->finals_positions.size() > 1) {
-      out << standard_deviation(last_n(driver_stats->finals_positions, 3));
+      out << driver_stats->finals_positions.recent_standard_deviation(
+          rolling_stats::SHORT_WINDOW);
     } else {
       out << NA;
     }
   }
 };
 
-class team_average_result_column : public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "team_average_result";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* team_stats =
-        find_historical_circuit_team_data(historical, result.driver);
-    if (team_stats) {
-      out << average(team_stats->finals_positions);
+struct team_average_result_column {
+  static constexpr std::string_view name = "team_average_result";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    if (row.circuit_team_stats) {
+      out << row.circuit_team_stats->finals_positions.average();
     } else {
       out << NA;
     }
   }
 };
 
-class team_recent_average_result_column :
-    public writer_internal::column_writer {
-public:
-  void write_header(std::ostream& out) const override {
-    out << "team_recent_average_result";
-  }
-  void write_column(
-      std::ostream& out,
-      const result_data& result,
-      const aggregate_data&,
-      const historical_data& historical) const override {
-    const auto* team_stats =
-        find_historical_circuit_team_data(historical, result.driver);
-    if (team_stats) {
-      out << average(last_n(team_stats->finals_positions, 6));
+struct team_recent_average_result_column {
+  static constexpr std::string_view name = "team_recent_average_result";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    if (row.circuit_team_stats) {
+      out << row.circuit_team_stats->finals_positions.recent_average(
+          rolling_stats::LONG_WINDOW);
     } else {
       out << NA;
     }
   }
 };
 
-template <typename... ColumnWriters>
-std::vector<std::shared_ptr<writer_internal::column_writer>> make_columns() {
-  std::vector<std::shared_ptr<writer_internal::column_writer>> columns;
-  (columns.push_back(std::make_shared<ColumnWriters>()), ...);
-  return columns;
-}
+struct driver_average_pit_stops_column {
+  static constexpr std::string_view name = "driver_average_pit_stops";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    const auto* driver_stats = row.circuit_driver_stats;
+    if (driver_stats && !driver_stats->pit_stop_counts.empty()) {
+      out << driver_stats->pit_stop_counts.average();
+    } else {
+      out << NA;
+    }
+  }
+};
+
+struct team_recent_pit_stop_time_column {
+  static constexpr std::string_view name = "team_recent_pit_stop_time_msec";
+  static void
+  write(csv_sink& out, const row_data& row, const aggregate_data&) {
+    const auto* team_stats = row.team_career_stats;
+    if (team_stats && !team_stats->pit_stop_times_ms.empty()) {
+      out << team_stats->pit_stop_times_ms.recent_average(
+          rolling_stats::LONG_WINDOW);
+    } else {
+      out << NA;
+    }
+  }
+};
+
+struct qual_rank_column {
+  static constexpr std::string_view name = "qual_rank";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    int rank = aggregate.qual_ranks[row.index];
+    if (rank > 0) {
+      out << rank;
+    } else {
+      out << NA;
+    }
+  }
+};
+
+struct qual_z_score_column {
+  static constexpr std::string_view name = "qual_z_score";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    double z_score = aggregate.qual_z_scores[row.index];
+    if (!std::isnan(z_score)) {
+      out << z_score;
+    } else {
+      out << NA;
+    }
+  }
+};
+
+struct teammate_qual_gap_column {
+  static constexpr std::string_view name = "teammate_qual_gap_msec";
+  static void write(
+      csv_sink& out, const row_data& row, const aggregate_data& aggregate) {
+    if (aggregate.teammates[row.index] != NO_TEAMMATE) {
+      out << aggregate.teammate_gaps[row.index].count();
+    } else {
+      out << NA;
+    }
+  }
+};
+
+// An ordered list of column types. Writing a row expands at compile time into
+// one direct call per column.
+template <typename... Columns>
+struct column_list {
+  static constexpr std::array<std::string_view, sizeof...(Columns)> names{
+      Columns::name...};
+
+  template <typename Column>
+  static constexpr size_t index_of() {
+    constexpr std::array<bool, sizeof...(Columns)> matches{
+        std::is_same_v<Column, Columns>...};
+    static_assert(std::ranges::count(matches, true) == 1);
+    return std::ranges::find(matches, true) - matches.begin();
+  }
+
+  static void write_header(csv_sink& out, char delim) {
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (i > 0) out << delim;
+      out << names[i];
+    }
+  }
+
+  static void write_row(
+      csv_sink& out,
+      char delim,
+      const row_data& row,
+      const aggregate_data& aggregate) {
+    bool first = true;
+    ((first ? void(first = false) : void(out << delim),
+      Columns::write(out, row, aggregate)),
+     ...);
+  }
+};
+
+using training_columns = column_list<
+    relevance_label_column,
+    race_id_column,
+    circuit_id_column,
+    season_id_column,
+    team_id_column,
+    driver_id_column,
+    qual_spread_column,
+    starting_position_column,
+    // q1_time_column,
+    // q2_time_column,
+    // q3_time_column,
+    driver_best_qual_time_column,
+    gap_to_best_qual_time_column,
+    qual_consistency_column,
+    driver_average_result_column,
+    driver_recent_average_result_column,
+    driver_career_stddev_column,
+    team_average_result_column,
+    team_recent_average_result_column,
+    // Left out until the training_data genrule has a pit stop table to pass
+    // with --pit_stops; without one they are NA in every row.
+    // driver_average_pit_stops_column,
+    // team_recent_pit_stop_time_column,
+    qual_rank_column,
+    qual_z_score_column,
+    teammate_qual_gap_column>;
+
+// training.conf and predict.conf refer to these columns by index.
+static_assert(training_columns::index_of<relevance_label_column>() == 0);
+static_assert(training_columns::index_of<race_id_column>() == 1);
+static_assert(training_columns::index_of<circuit_id_column>() == 2);
+static_assert(training_columns::index_of<season_id_column>() == 3);
+static_assert(training_columns::index_of<team_id_column>() == 4);
+static_assert(training_columns::index_of<driver_id_column>() == 5);
 
 } // namespace
 
 writer::writer(std::filesystem::path output_path, writer_options opts)
     : _options{std::move(opts)}, _output_path{std::move(output_path)},
-      _out{_output_path}, _columns{make_columns<
-                              relevance_label_column,
-                              race_id_column,
-                              circuit_id_column,
-                              season_id_column,
-                              team_id_column,
-                              driver_id_column,
-                              qual_spread_column,
-                              starting_position_column,
-                              // q1_time_column,
-                              // q2_time_column,
-                              // q3_time_column,
-                              driver_best_qual_time_column,
-                              gap_to_best_qual_time_column,
-                              qual_consistency_column,
-                              driver_average_result_column,
-                              driver_recent_average_result_column,
-                              driver_career_stddev_column,
-                              team_average_result_column,
-                              team_recent_average_result_column>()} {}
+      _out{_output_path, _options.flush_threshold} {}
 
 void writer::write_header() {
-  int column_counter = 0;
-  for (const auto& column : _columns) {
-    if (++column_counter > 1) _out << _options.delim;
-    column->write_header(_out);
-  }
-  _out << '\n' << std::flush;
+  training_columns::write_header(_out, _options.delim);
+  _out << '\n';
 }
 
 void writer::write_race(
     std::span<const DriverResult> race_results,
     const historical_data& historical) {
   if (race_results.empty()) return;
+  results_table table = results_table::from_results(race_results);
+  write_race(table, table.races().front(), historical);
+}
 
+void writer::write_race(
+    const results_table& table,
+    results_table::race_range race,
+    const historical_data& historical) {
+  if (race.size() == 0) return;
+
+  results_table::row first = table[race.begin];
   aggregate_data aggregate{
       .race_id = std::hash<std::string>{}(absl::StrCat(
-          constants::Circuit_Name(race_results.front().circuit()),
-          "_",
-          race_results.front().race_season())),
-      .race_size = std::min(_options.race_size_limit, race_results.size()),
-      .best_qual_time = milliseconds::max()};
-
-  std::vector<const DriverResult*> sorted_results;
-  for (const DriverResult& result : race_results) {
-    milliseconds driver_best_qual_time = best_qual_time(result);
-    aggregate.best_qual_time =
-        std::min(aggregate.best_qual_time, driver_best_qual_time);
-    if (driver_best_qual_time != DEFAULT_TIME) {
-      aggregate.worst_qual_time =
-          std::max(aggregate.worst_qual_time, driver_best_qual_time);
-    }
-    sorted_results.push_back(&result);
+          constants::Circuit_Name(first.circuit()), "_", first.race_season())),
+      .race_size = std::min(_options.race_size_limit, race.size())};
+
+  std::vector<results_table::row> sorted_results;
+  sorted_results.reserve(race.size());
+  for (size_t i = race.begin; i < race.end; ++i) {
+    sorted_results.push_back(table[i]);
   }
 
-  std::ranges::sort(sorted_results, [](const auto* a, const auto* b) {
-    if (!a->final_position() && b->final_position()) return false;
-    if (a->final_position() == b->final_position()) {
-      return a->starting_position() < b->starting_position();
+  std::ranges::sort(sorted_results, [](const auto& a, const auto& b) {
+    if (!a.final_position() && b.final_position()) return false;
+    if (a.final_position() == b.final_position()) {
+      return a.starting_position() < b.starting_position();
     }
-    if (!b->final_position()) return true;
-    return a->final_position() < b->final_position();
+    if (!b.final_position()) return true;
+    return a.final_position() < b.final_position();
   });
+  add_qual_context(sorted_results, aggregate);
 
-  if (sorted_results.size() % 2 == 1) {
-    aggregate.median_qual_time =
-        best_qual_time(*sorted_results[sorted_results.size() / 2]);
-  } else {
-    aggregate.median_qual_time =
-        (best_qual_time(*sorted_results[sorted_results.size() / 2]) +
-         best_qual_time(*sorted_results[(sorted_results.size() / 2) - 1])) /
-        2;
-  }
-
-  std::span<const f1_predict::DriverResult*> results_span{
-      sorted_results.begin(), sorted_results.end()};
+  std::span<const results_table::row> results_span{sorted_results};
   if (results_span.size() > _options.race_size_limit) {
     results_span = results_span.subspan(0, _options.race_size_limit);
   }
 
   for (size_t i = 0; i < results_span.size(); ++i) {
-    size_t column_counter = 0;
-    for (const auto& column : _columns) {
-      if (++column_counter > 1) _out << _options.delim;
-      column->write_column(
-          _out,
-          {.index = i, .driver = *results_span[i]},
-          aggregate,
-          historical);
-    }
+    const results_table::row& result = results_span[i];
+    row_data row{
+        .index = i,
+        .driver = result,
+        .circuit_driver_stats =
+            historical.find_circuit_driver(result.circuit(), result.driver()),
+        .circuit_team_stats =
+            historical.find_circuit_team(result.circuit(), result.team()),
+        .driver_career_stats = historical.find_driver_career(result.driver()),
+        .team_career_stats = historical.find_team_career(result.team())};
+    training_columns::write_row(_out, _options.delim, row, aggregate);
     _out << '\n';
   }
-  _out << std::flush;
 }
 
 } // namespace f1_predict
@@ -1,24 +1,20 @@
 #pragma once
 
 #include <filesystem>
-#include <fstream>
-#include <memory>
 #include <span>
-#include <vector>
 
 #include "data/race_results.pb.h"
+#include "model/csv_sink.h"
 #include "model/data_aggregates.h"
+#include "model/results_table.h"
 
 namespace f1_predict {
-namespace writer_internal {
-
-class column_writer;
-
-} // namespace writer_internal
 
 struct writer_options {
   size_t race_size_limit = 20;
   char delim = ',';
+  // Bytes of output buffered before they are written to the file.
+  size_t flush_threshold = csv_sink::DEFAULT_FLUSH_THRESHOLD;
 };
 
 class writer {
@@ -29,12 +25,15 @@ public:
   void write_race(
       std::span<const DriverResult> race_results,
       const historical_data& historical = {});
+  void write_race(
+      const results_table& table,
+      results_table::race_range race,
+      const historical_data& historical = {});
 
 private:
   writer_options _options;
   std::filesystem::path _output_path;
-  std::ofstream _out;
-  std::vector<std::shared_ptr<writer_internal::column_writer>> _columns;
+  csv_sink _out;
 };
 
 } // namespace f1_predict
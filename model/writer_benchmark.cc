@@ -0,0 +1,119 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "model/data_aggregates.h"
+#include "model/results_table.h"
+#include "model/writer.h"
+
+ABSL_FLAG(int, seasons, 50, "Number of seasons of synthetic races.");
+ABSL_FLAG(int, iterations, 10, "Times to write every race.");
+ABSL_FLAG(
+    std::string,
+    output_file,
+    "/dev/null",
+    "Path to write the training rows to.");
+
+namespace constants = ::f1_predict::constants;
+
+using ::f1_predict::DriverResult;
+using ::f1_predict::historical_data;
+using ::f1_predict::results_table;
+
+constexpr int RACES_PER_SEASON = 20;
+constexpr int DRIVERS_PER_RACE = 20;
+
+void set_time(google::protobuf::Duration* duration, int ms) {
+  duration->set_seconds(ms / 1000);
+  duration->set_nanos((ms % 1000) * 1000000);
+}
+
+// Results of full grids at the first circuits, drivers and teams, with a
+// random few of the qualifying times missing.
+std::vector<DriverResult> make_results(int seasons) {
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> qual_time{70000, 100000};
+  std::bernoulli_distribution missing{0.2};
+  std::vector<DriverResult> results;
+  for (int season = 0; season < seasons; ++season) {
+    for (int race = 0; race < RACES_PER_SEASON; ++race) {
+      for (int driver = 0; driver < DRIVERS_PER_RACE; ++driver) {
+        DriverResult& result = results.emplace_back();
+        result.set_race_season(1980 + season);
+        result.set_circuit(static_cast<constants::Circuit>(race + 1));
+        result.set_driver(static_cast<constants::Driver>(driver + 1));
+        result.set_team(static_cast<constants::Team>(driver / 2 + 1));
+        result.set_starting_position(driver + 1);
+        result.set_final_position(DRIVERS_PER_RACE - driver);
+        set_time(result.mutable_qualification_time_1(), qual_time(random));
+        if (!missing(random)) {
+          set_time(result.mutable_qualification_time_2(), qual_time(random));
+        }
+        if (!missing(random)) {
+          set_time(result.mutable_qualification_time_3(), qual_time(random));
+        }
+      }
+    }
+  }
+  return results;
+}
+
+// Adds a race to the history the way the training generator does, so the
+// history grows over the seasons as it does there.
+void add_race(
+    historical_data& historical,
+    const results_table& table,
+    results_table::race_range race) {
+  for (size_t i = race.begin; i < race.end; ++i) {
+    results_table::row row = table[i];
+    historical_data::stats& circuit_driver =
+        historical.circuit_driver(row.circuit(), row.driver());
+    circuit_driver.finals_positions.add(row.final_position());
+    circuit_driver.pit_stop_counts.add(2);
+    historical.circuit_team(row.circuit(), row.team())
+        .finals_positions.add(row.final_position());
+    historical.driver_career(row.driver()).finals_positions.add(
+        row.final_position());
+    if (row.driver() % 2 == 1) {
+      historical.team_career(row.team()).pit_stop_times_ms.add(2400);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  if (absl::GetFlag(FLAGS_seasons) <= 0 || iterations <= 0) {
+    std::cerr << "seasons and iterations must be positive." << std::endl;
+    return 1;
+  }
+
+  results_table table = results_table::from_results(
+      make_results(absl::GetFlag(FLAGS_seasons)));
+
+  std::vector<double> times;
+  for (int i = 0; i < iterations; ++i) {
+    f1_predict::writer out{absl::GetFlag(FLAGS_output_file)};
+    historical_data historical;
+    out.write_header();
+    auto start = std::chrono::steady_clock::now();
+    for (results_table::race_range race : table.races()) {
+      out.write_race(table, race, historical);
+      add_race(historical, table, race);
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    times.push_back(elapsed.count() / table.size());
+  }
+  std::ranges::nth_element(times, times.begin() + times.size() / 2);
+  std::cout << table.size() << " rows, " << std::fixed << std::setprecision(1)
+            << times[times.size() / 2] << " ns/row" << std::endl;
+  return 0;
+}
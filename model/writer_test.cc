@@ -0,0 +1,131 @@
+#include "model/writer.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "data/constants.pb.h"
+#include "data/race_results.pb.h"
+#include "gtest/gtest.h"
+
+namespace f1_predict {
+namespace {
+
+namespace fs = ::std::filesystem;
+
+DriverResult make_result(
+    constants::Driver driver,
+    constants::Team team,
+    int final_position,
+    int qualification_millis) {
+  DriverResult result;
+  result.set_race_season(2024);
+  result.set_circuit(constants::MONACO_CIRCUIT);
+  result.set_driver(driver);
+  result.set_team(team);
+  result.set_starting_position(final_position);
+  result.set_final_position(final_position);
+  if (qualification_millis) {
+    result.mutable_qualification_time_1()->set_seconds(
+        qualification_millis / 1000);
+    result.mutable_qualification_time_1()->set_nanos(
+        qualification_millis % 1000 * 1000000);
+  }
+  return result;
+}
+
+// Writes the race and returns each driver's row, keyed by column name.
+std::map<int, std::map<std::string, std::string>>
+write_rows(const std::vector<DriverResult>& race) {
+  fs::path path = fs::path{::testing::TempDir()} / "writer_test.csv";
+  {
+    writer out{path};
+    out.write_header();
+    out.write_race(race);
+  }
+  std::ifstream in{path};
+  std::string line;
+  std::vector<std::string> header;
+  std::getline(in, line);
+  std::istringstream header_cells{line};
+  for (std::string cell; std::getline(header_cells, cell, ',');) {
+    header.push_back(cell);
+  }
+  std::map<int, std::map<std::string, std::string>> rows;
+  while (std::getline(in, line)) {
+    std::map<std::string, std::string> row;
+    std::istringstream cells{line};
+    std::string cell;
+    for (size_t i = 0; i < header.size() && std::getline(cells, cell, ',');
+         ++i) {
+      row[header[i]] = cell;
+    }
+    rows[std::stoi(row["driver_id"])] = row;
+  }
+  return rows;
+}
+
+TEST(WriterTest, RanksAndComparesQualifyingTimes) {
+  auto rows = write_rows(
+      {make_result(constants::CHARLES_LECLERC, constants::FERRARI, 1, 80000),
+       make_result(constants::CARLOS_SAINZ, constants::FERRARI, 2, 81000),
+       make_result(constants::LANDO_NORRIS, constants::MCLAREN, 3, 80000),
+       make_result(constants::OSCAR_PIASTRI, constants::MCLAREN, 4, 0),
+       make_result(
+           constants::GEORGE_RUSSELL, constants::TEAM_UNSPECIFIED, 5, 82000),
+       make_result(
+           constants::MAX_VERSTAPPEN, constants::RED_BULL_RACING, 6, 83000)});
+  ASSERT_EQ(rows.size(), 6);
+
+  // Equal times share a rank, and the next rank skips past them.
+  EXPECT_EQ(rows[constants::CHARLES_LECLERC]["qual_rank"], "1");
+  EXPECT_EQ(rows[constants::LANDO_NORRIS]["qual_rank"], "1");
+  EXPECT_EQ(rows[constants::CARLOS_SAINZ]["qual_rank"], "3");
+  EXPECT_EQ(rows[constants::GEORGE_RUSSELL]["qual_rank"], "4");
+  EXPECT_EQ(rows[constants::MAX_VERSTAPPEN]["qual_rank"], "5");
+  EXPECT_EQ(rows[constants::OSCAR_PIASTRI]["qual_rank"], "NA");
+
+  // Times of 80, 81, 80, 82 and 83 seconds have a mean of 81.2 and a standard
+  // deviation of sqrt(1.36).
+  double stddev = std::sqrt(1.36);
+  EXPECT_NEAR(
+      std::stod(rows[constants::CHARLES_LECLERC]["qual_z_score"]),
+      -1.2 / stddev,
+      1e-4);
+  EXPECT_NEAR(
+      std::stod(rows[constants::MAX_VERSTAPPEN]["qual_z_score"]),
+      1.8 / stddev,
+      1e-4);
+  EXPECT_EQ(rows[constants::OSCAR_PIASTRI]["qual_z_score"], "NA");
+
+  EXPECT_EQ(
+      rows[constants::CHARLES_LECLERC]["teammate_qual_gap_msec"], "-1000");
+  EXPECT_EQ(rows[constants::CARLOS_SAINZ]["teammate_qual_gap_msec"], "1000");
+  // A teammate without a qualifying time is no comparison.
+  EXPECT_EQ(rows[constants::LANDO_NORRIS]["teammate_qual_gap_msec"], "NA");
+  EXPECT_EQ(rows[constants::OSCAR_PIASTRI]["teammate_qual_gap_msec"], "NA");
+  // Drivers without a known team have no teammates.
+  EXPECT_EQ(rows[constants::GEORGE_RUSSELL]["teammate_qual_gap_msec"], "NA");
+  // Nor does the only driver of a team.
+  EXPECT_EQ(rows[constants::MAX_VERSTAPPEN]["teammate_qual_gap_msec"], "NA");
+}
+
+TEST(WriterTest, LeavesZScoresOutWhenAllTimesAreEqual) {
+  auto rows = write_rows(
+      {make_result(constants::CHARLES_LECLERC, constants::FERRARI, 1, 80000),
+       make_result(constants::LANDO_NORRIS, constants::MCLAREN, 2, 80000),
+       make_result(
+           constants::MAX_VERSTAPPEN, constants::RED_BULL_RACING, 3, 80000)});
+  ASSERT_EQ(rows.size(), 3);
+  for (auto& [driver, row] : rows) {
+    EXPECT_EQ(row["qual_rank"], "1") << driver;
+    EXPECT_EQ(row["qual_z_score"], "NA") << driver;
+  }
+}
+
+} // namespace
+} // namespace f1_predict
@@ -0,0 +1,354 @@
+#include "strings/simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+#include "strings/parse.h"
+#include "strings/trim.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define F1_PREDICT_SIMD_X86 1
+#endif
+
+namespace f1_predict {
+namespace {
+
+// Every power of ten up to 10^15 is exact in a double.
+constexpr double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+// Longest digit run whose value is exact in a double.
+constexpr int MAX_SECONDS_DIGITS = 15;
+// Longest digit run that cannot overflow an int, or milliseconds when scaled
+// from hours.
+constexpr int MAX_INT_DIGITS = 9;
+
+constexpr int64_t MS_PER_HOUR = 3600000;
+constexpr int64_t MS_PER_MINUTE = 60000;
+
+// Converts `digits` * 10^-`fraction_digits` seconds to milliseconds, giving
+// the same result as `parse_duration` and `parse_gap`. Those parse the
+// decimal into the nearest double, which is also what dividing two exact
+// doubles rounds to, then truncate it scaled to milliseconds.
+int64_t seconds_to_ms(int64_t digits, int fraction_digits) {
+  double seconds =
+      static_cast<double>(digits) / POWERS_OF_TEN[fraction_digits];
+  return static_cast<int64_t>(seconds * 1000);
+}
+
+#if F1_PREDICT_SIMD_X86
+
+constexpr size_t BLOCK_SIZE = 16;
+constexpr uintptr_t PAGE_SIZE = 4096;
+
+// Loads the 16 bytes starting at a non-empty cell. Bytes past its end are
+// whatever follows it in memory, or zero when that would cross into the next
+// page.
+__attribute__((target("sse4.2,popcnt"), no_sanitize("address"))) __m128i
+load_block(std::string_view cell) {
+  if (reinterpret_cast<uintptr_t>(cell.data()) % PAGE_SIZE <=
+      PAGE_SIZE - BLOCK_SIZE) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(cell.data()));
+  }
+  alignas(BLOCK_SIZE) char block[BLOCK_SIZE] = {};
+  std::memcpy(block, cell.data(), std::min(cell.size(), BLOCK_SIZE));
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+// Mask of the first `size` bytes of a block, for `size` of at most 16.
+uint32_t valid_mask(size_t size) { return (1u << size) - 1; }
+
+__attribute__((target("sse4.2,popcnt"))) uint32_t
+byte_mask(__m128i block, char byte) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(byte)));
+}
+
+// Subtracts '0' from every byte of `block`, and returns the mask of the bytes
+// that were digits.
+__attribute__((target("sse4.2,popcnt"))) uint32_t
+digit_values(__m128i block, __m128i& values) {
+  values = _mm_sub_epi8(block, _mm_set1_epi8('0'));
+  __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(values, _mm_set1_epi8(9)), values);
+  return _mm_movemask_epi8(is_digit);
+}
+
+// Mask of the bytes `std::isspace` accepts: ' ' and '\t' through '\r'.
+__attribute__((target("sse4.2,popcnt"))) uint32_t space_mask(__m128i block) {
+  __m128i controls = _mm_sub_epi8(block, _mm_set1_epi8('\t'));
+  __m128i is_control =
+      _mm_cmpeq_epi8(_mm_min_epu8(controls, _mm_set1_epi8(4)), controls);
+  __m128i is_blank = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+  return _mm_movemask_epi8(_mm_or_si128(is_control, is_blank));
+}
+
+// Returns the number spelled by the `count` digit values starting at `start`,
+// for up to 16 digits. The digits are shuffled to the end of the register and
+// then combined pairwise: into 2-digit, 4-digit and finally 8-digit lanes.
+__attribute__((target("sse4.2,popcnt"))) int64_t
+to_int(__m128i values, int start, int count) {
+  const __m128i lanes =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i index =
+      _mm_add_epi8(lanes, _mm_set1_epi8(static_cast<char>(start + count - 16)));
+  // Indices with the high bit set shuffle in zero.
+  __m128i leading = _mm_cmplt_epi8(lanes, _mm_set1_epi8(16 - count));
+  __m128i digits = _mm_shuffle_epi8(values, _mm_or_si128(index, leading));
+
+  __m128i pairs = _mm_maddubs_epi16(
+      digits,
+      _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  __m128i quads =
+      _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  __m128i octets = _mm_madd_epi16(
+      _mm_packus_epi32(quads, quads),
+      _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+  int64_t high = _mm_cvtsi128_si32(octets);
+  int64_t low = _mm_extract_epi32(octets, 1);
+  return high * 100000000 + low;
+}
+
+// Parses the seconds in bytes [start, end) of a block: digits with at most
+// one '.' between two of them. Returns false for anything else.
+__attribute__((target("sse4.2,popcnt"))) bool parse_seconds(
+    __m128i values,
+    uint32_t digits,
+    uint32_t dots,
+    int start,
+    int end,
+    int64_t& ms) {
+  int digit_count = std::popcount(digits >> start);
+  if (digit_count > MAX_SECONDS_DIGITS) return false;
+  if (dots == 0) {
+    ms = seconds_to_ms(to_int(values, start, end - start), 0);
+    return true;
+  }
+  int dot = std::countr_zero(dots);
+  if (!std::has_single_bit(dots) || dot == start || dot == end - 1) {
+    return false;
+  }
+  // Shifts the fraction down over the '.' so all the digits convert at once.
+  const __m128i lanes =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i fraction_lanes = _mm_cmpgt_epi8(lanes, _mm_set1_epi8(dot - 1));
+  __m128i packed =
+      _mm_shuffle_epi8(values, _mm_sub_epi8(lanes, fraction_lanes));
+  ms = seconds_to_ms(to_int(packed, start, digit_count), end - dot - 1);
+  return true;
+}
+
+// Parses durations made of up to three ':' separated chunks of digits, with
+// any '.' in the seconds. Empty chunks count as zero, like in
+// `parse_duration`.
+__attribute__((target("sse4.2,popcnt"))) bool
+parse_duration_sse42(std::string_view cell, int64_t& ms) {
+  if (cell.empty() || cell.size() > BLOCK_SIZE) return false;
+  __m128i block = load_block(cell);
+  uint32_t valid = valid_mask(cell.size());
+  __m128i values;
+  uint32_t digits = digit_values(block, values) & valid;
+  uint32_t colons = byte_mask(block, ':') & valid;
+  uint32_t dots = byte_mask(block, '.') & valid;
+  if ((digits | colons | dots) != valid || std::popcount(colons) > 2) {
+    return false;
+  }
+
+  int seconds_start = std::bit_width(colons);
+  if ((dots & ((1u << seconds_start) - 1)) != 0) return false;
+  int64_t seconds_ms;
+  if (!parse_seconds(
+          values, digits, dots, seconds_start, cell.size(), seconds_ms)) {
+    return false;
+  }
+  if (colons == 0) {
+    ms = seconds_ms;
+    return true;
+  }
+
+  int minutes_end = seconds_start - 1;
+  uint32_t hours_colon = colons & ~(1u << minutes_end);
+  int minutes_start = std::bit_width(hours_colon);
+  int hours_end = minutes_start - 1;
+  if (minutes_end - minutes_start > MAX_INT_DIGITS ||
+      hours_end > MAX_INT_DIGITS) {
+    return false;
+  }
+  int64_t minutes =
+      to_int(values, minutes_start, minutes_end - minutes_start);
+  ms = seconds_ms + MS_PER_MINUTE * minutes;
+  if (hours_colon != 0) ms += MS_PER_HOUR * to_int(values, 0, hours_end);
+  return true;
+}
+
+// Parses gaps of an optional '+' followed by seconds.
+__attribute__((target("sse4.2,popcnt"))) bool
+parse_gap_sse42(std::string_view cell, int64_t& ms) {
+  if (cell.empty() || cell.size() > BLOCK_SIZE) return false;
+  __m128i block = load_block(cell);
+  int start = cell.front() == '+' ? 1 : 0;
+  uint32_t valid = valid_mask(cell.size()) & ~valid_mask(start);
+  __m128i values;
+  uint32_t digits = digit_values(block, values) & valid;
+  uint32_t dots = byte_mask(block, '.') & valid;
+  if (digits == 0 || (digits | dots) != valid) return false;
+  return parse_seconds(values, digits, dots, start, cell.size(), ms);
+}
+
+// Parses an optional '-' followed by digits, ignoring anything after them
+// like `std::from_chars` does.
+__attribute__((target("sse4.2,popcnt"))) bool
+parse_int_sse42(std::string_view cell, int& value) {
+  if (cell.empty() || cell.size() > BLOCK_SIZE) return false;
+  __m128i block = load_block(cell);
+  bool negative = cell.front() == '-';
+  int start = negative ? 1 : 0;
+  __m128i values;
+  uint32_t digits = digit_values(block, values) & valid_mask(cell.size());
+  int count = std::countr_one(digits >> start);
+  if (count == 0 || count > MAX_INT_DIGITS) return false;
+  int64_t magnitude = to_int(values, start, count);
+  value = static_cast<int>(negative ? -magnitude : magnitude);
+  return true;
+}
+
+__attribute__((target("sse4.2,popcnt"))) void
+trim_sse42(std::string_view& cell) {
+  if (cell.empty()) return;
+  if (cell.size() <= BLOCK_SIZE) {
+    uint32_t text = ~space_mask(load_block(cell)) & valid_mask(cell.size());
+    if (text == 0) {
+      cell = cell.substr(cell.size());
+      return;
+    }
+    int first = std::countr_zero(text);
+    cell = cell.substr(first, std::bit_width(text) - first);
+    return;
+  }
+
+  // Longer cells are scanned a block at a time from each end.
+  size_t first = cell.size();
+  for (size_t position = 0; position < cell.size(); position += BLOCK_SIZE) {
+    std::string_view rest = cell.substr(position);
+    uint32_t text = ~space_mask(load_block(rest)) &
+        valid_mask(std::min(rest.size(), BLOCK_SIZE));
+    if (text != 0) {
+      first = position + std::countr_zero(text);
+      break;
+    }
+  }
+  if (first == cell.size()) {
+    cell = cell.substr(cell.size());
+    return;
+  }
+  size_t end = cell.size();
+  while (true) {
+    size_t start = end >= BLOCK_SIZE ? end - BLOCK_SIZE : 0;
+    uint32_t text = ~space_mask(load_block(cell.substr(start))) &
+        valid_mask(end - start);
+    if (text != 0) {
+      end = start + std::bit_width(text);
+      break;
+    }
+    end = start;
+  }
+  cell = cell.substr(first, end - first);
+}
+
+__attribute__((target("sse4.2,popcnt"))) void
+trim_cells_sse42(std::span<std::string_view> cells) {
+  for (std::string_view& cell : cells) trim_sse42(cell);
+}
+
+__attribute__((target("sse4.2,popcnt"))) void parse_durations_sse42(
+    std::span<const std::string_view> cells, std::span<int64_t> durations_ms) {
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (!parse_duration_sse42(cells[i], durations_ms[i])) {
+      durations_ms[i] = parse_duration(cells[i]).count();
+    }
+  }
+}
+
+__attribute__((target("sse4.2,popcnt"))) void parse_gaps_sse42(
+    std::span<const std::string_view> cells, std::span<int64_t> gaps_ms) {
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (!parse_gap_sse42(cells[i], gaps_ms[i])) {
+      gaps_ms[i] = parse_gap(cells[i]).count();
+    }
+  }
+}
+
+__attribute__((target("sse4.2,popcnt"))) void parse_ints_sse42(
+    std::span<const std::string_view> cells, std::span<int> values) {
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (!parse_int_sse42(cells[i], values[i])) values[i] = parse_int(cells[i]);
+  }
+}
+
+#endif // F1_PREDICT_SIMD_X86
+
+} // namespace
+
+simd_level detected_simd_level() {
+#if F1_PREDICT_SIMD_X86
+  static const simd_level level = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")
+        ? simd_level::sse42
+        : simd_level::scalar;
+  }();
+  return level;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+void trim_cells(std::span<std::string_view> cells, simd_level level) {
+#if F1_PREDICT_SIMD_X86
+  if (level == simd_level::sse42) return trim_cells_sse42(cells);
+#endif
+  for (std::string_view& cell : cells) cell = trim(cell);
+}
+
+void parse_durations(
+    std::span<const std::string_view> cells,
+    std::span<int64_t> durations_ms,
+    simd_level level) {
+#if F1_PREDICT_SIMD_X86
+  if (level == simd_level::sse42) {
+    return parse_durations_sse42(cells, durations_ms);
+  }
+#endif
+  for (size_t i = 0; i < cells.size(); ++i) {
+    durations_ms[i] = parse_duration(cells[i]).count();
+  }
+}
+
+void parse_gaps(
+    std::span<const std::string_view> cells,
+    std::span<int64_t> gaps_ms,
+    simd_level level) {
+#if F1_PREDICT_SIMD_X86
+  if (level == simd_level::sse42) return parse_gaps_sse42(cells, gaps_ms);
+#endif
+  for (size_t i = 0; i < cells.size(); ++i) {
+    gaps_ms[i] = parse_gap(cells[i]).count();
+  }
+}
+
+void parse_ints(
+    std::span<const std::string_view> cells,
+    std::span<int> values,
+    simd_level level) {
+#if F1_PREDICT_SIMD_X86
+  if (level == simd_level::sse42) return parse_ints_sse42(cells, values);
+#endif
+  for (size_t i = 0; i < cells.size(); ++i) values[i] = parse_int(cells[i]);
+}
+
+} // namespace f1_predict
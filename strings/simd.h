@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace f1_predict {
+
+// Batch versions of `trim`, `parse_duration`, `parse_gap` and `parse_int` for
+// whole columns of cells. Each produces exactly what calling the single-cell
+// function on every cell would, including exiting on cells that function
+// rejects.
+//
+// Cells of up to 16 bytes in the common shapes ("1:23.456", "+1.234", "42")
+// are classified and converted with SSE4.2 when the CPU has it. Anything else
+// falls back to the single-cell functions. Cells are read in 16 byte blocks
+// that may extend past their end, but never onto another memory page.
+
+enum class simd_level {
+  scalar,
+  sse42,
+};
+
+// The best level supported by this CPU, detected once.
+simd_level detected_simd_level();
+
+// Trims each cell in place.
+void trim_cells(
+    std::span<std::string_view> cells,
+    simd_level level = detected_simd_level());
+
+// Parses each cell like `parse_duration` into milliseconds. `durations_ms`
+// must be as long as `cells`.
+void parse_durations(
+    std::span<const std::string_view> cells,
+    std::span<int64_t> durations_ms,
+    simd_level level = detected_simd_level());
+
+// Parses each cell like `parse_gap` into milliseconds. `gaps_ms` must be as
+// long as `cells`.
+void parse_gaps(
+    std::span<const std::string_view> cells,
+    std::span<int64_t> gaps_ms,
+    simd_level level = detected_simd_level());
+
+// Parses each cell like `parse_int`. `values` must be as long as `cells`.
+void parse_ints(
+    std::span<const std::string_view> cells,
+    std::span<int> values,
+    simd_level level = detected_simd_level());
+
+} // namespace f1_predict
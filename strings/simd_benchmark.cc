@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "strings/simd.h"
+
+ABSL_FLAG(int, cells, 1000000, "Number of cells in each column.");
+ABSL_FLAG(int, iterations, 20, "Times to parse each column per level.");
+
+using ::f1_predict::detected_simd_level;
+using ::f1_predict::parse_durations;
+using ::f1_predict::parse_gaps;
+using ::f1_predict::parse_ints;
+using ::f1_predict::simd_level;
+using ::f1_predict::trim_cells;
+
+// Cells shaped like the columns of the Kaggle and results CSVs.
+struct Columns {
+  std::vector<std::string> lap_times;
+  std::vector<std::string> gaps;
+  std::vector<std::string> ints;
+  std::vector<std::string> padded;
+};
+
+std::string zero_padded(int value, int width) {
+  std::string digits = std::to_string(value);
+  return std::string(width - std::min<int>(width, digits.size()), '0') +
+      digits;
+}
+
+Columns make_columns(int count) {
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> minutes{1, 2};
+  std::uniform_int_distribution<int> milliseconds{0, 59999};
+  std::uniform_int_distribution<int> gap{1, 99999};
+  std::uniform_int_distribution<int> id{1, 200000};
+  std::uniform_int_distribution<int> spaces{0, 3};
+
+  Columns columns;
+  for (int i = 0; i < count; ++i) {
+    int ms = milliseconds(random);
+    columns.lap_times.push_back(
+        std::to_string(minutes(random)) + ':' + zero_padded(ms / 1000, 2) +
+        '.' + zero_padded(ms % 1000, 3));
+    int gap_ms = gap(random);
+    columns.gaps.push_back(
+        '+' + std::to_string(gap_ms / 1000) + '.' +
+        zero_padded(gap_ms % 1000, 3));
+    columns.ints.push_back(std::to_string(id(random)));
+    columns.padded.push_back(
+        std::string(spaces(random), ' ') + "Max Verstappen" +
+        std::string(spaces(random), ' '));
+  }
+  return columns;
+}
+
+// Returns the median time of `iterations` runs of `fn`, in nanoseconds per
+// cell.
+double time_per_cell(
+    int iterations, size_t cells, const std::function<void()>& fn) {
+  std::vector<double> times;
+  for (int i = 0; i < iterations; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    times.push_back(elapsed.count() / cells);
+  }
+  std::ranges::nth_element(times, times.begin() + times.size() / 2);
+  return times[times.size() / 2];
+}
+
+void report(
+    std::string_view name,
+    int iterations,
+    const std::vector<std::string>& column,
+    const std::function<void(std::span<const std::string_view>, simd_level)>&
+        parse) {
+  std::vector<std::string_view> cells(column.begin(), column.end());
+  double scalar = time_per_cell(
+      iterations, cells.size(), [&] { parse(cells, simd_level::scalar); });
+  double simd = time_per_cell(
+      iterations, cells.size(), [&] { parse(cells, detected_simd_level()); });
+  std::cout << std::fixed << std::setprecision(2) << std::left
+            << std::setw(10) << name << std::right << " scalar "
+            << std::setw(6) << scalar << " ns/cell  simd " << std::setw(6)
+            << simd << " ns/cell  " << std::setw(5) << scalar / simd << 'x'
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  if (absl::GetFlag(FLAGS_cells) <= 0 || iterations <= 0) {
+    std::cerr << "cells and iterations must be positive." << std::endl;
+    return 1;
+  }
+  if (detected_simd_level() == simd_level::scalar) {
+    std::cerr << "This CPU has no supported SIMD level; both columns below "
+                 "time the scalar functions."
+              << std::endl;
+  }
+
+  Columns columns = make_columns(absl::GetFlag(FLAGS_cells));
+  std::vector<int64_t> ms(columns.lap_times.size());
+  std::vector<int> values(columns.ints.size());
+  std::vector<std::string_view> trimmed(columns.padded.size());
+
+  report(
+      "trim",
+      iterations,
+      columns.padded,
+      [&](std::span<const std::string_view> cells, simd_level level) {
+        std::ranges::copy(cells, trimmed.begin());
+        trim_cells(trimmed, level);
+      });
+  report(
+      "duration",
+      iterations,
+      columns.lap_times,
+      [&](std::span<const std::string_view> cells, simd_level level) {
+        parse_durations(cells, ms, level);
+      });
+  report(
+      "gap",
+      iterations,
+      columns.gaps,
+      [&](std::span<const std::string_view> cells, simd_level level) {
+        parse_gaps(cells, ms, level);
+      });
+  report(
+      "int",
+      iterations,
+      columns.ints,
+      [&](std::span<const std::string_view> cells, simd_level level) {
+        parse_ints(cells, values, level);
+      });
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include "strings/simd.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "strings/parse.h"
+#include "strings/trim.h"
+
+namespace f1_predict {
+namespace {
+
+class SimdTest : public ::testing::TestWithParam<simd_level> {};
+
+INSTANTIATE_TEST_SUITE_P(
+    Levels,
+    SimdTest,
+    ::testing::Values(simd_level::scalar, detected_simd_level()));
+
+std::vector<std::string_view> views(const std::vector<std::string>& cells) {
+  return {cells.begin(), cells.end()};
+}
+
+// Random cells drawn from `alphabet`, mostly short enough for one block.
+std::vector<std::string> random_cells(std::string_view alphabet) {
+  std::mt19937 random{42};
+  std::uniform_int_distribution<size_t> length{0, 20};
+  std::uniform_int_distribution<size_t> letter{0, alphabet.size() - 1};
+  std::vector<std::string> cells(10000);
+  for (std::string& cell : cells) {
+    cell.resize(length(random));
+    for (char& c : cell) c = alphabet[letter(random)];
+  }
+  return cells;
+}
+
+TEST_P(SimdTest, TrimsLikeTrim) {
+  std::vector<std::string> cells = {
+      "",
+      "  \t\r\nfront",
+      "back  \t\r\n",
+      "  \t\r\nboth \t\r\n  ",
+      " \v\f ",
+      "    leading spaces past one block",
+      "trailing spaces past one block    ",
+      "                                  "};
+  for (const std::string& cell : random_cells(" \t\n\v\f\rab")) {
+    cells.push_back(cell);
+  }
+  std::vector<std::string_view> trimmed = views(cells);
+  trim_cells(trimmed, GetParam());
+  for (size_t i = 0; i < cells.size(); ++i) {
+    EXPECT_EQ(trimmed[i], trim(cells[i])) << '"' << cells[i] << '"';
+  }
+}
+
+TEST_P(SimdTest, ParsesDurationsLikeParseDuration) {
+  std::vector<std::string> cells = {
+      "123",
+      "123.456",
+      "123.456789",
+      ":123.456",
+      "::123.456",
+      "1:23",
+      "12:3",
+      "12:03",
+      "1:55.018",
+      "1:",
+      ":1:23",
+      "1:2:3",
+      "12:34:56.789",
+      "1:2:",
+      "1::",
+      "1::3",
+      "1:.5",
+      "1:5.",
+      "1.5:30",
+      "1:2:3:4",
+      "-1:30.5",
+      "1:23.4e1",
+      "",
+      "99999:59.999",
+      "1234567890:00.000"};
+  for (const std::string& cell : random_cells("0123456789:.")) {
+    cells.push_back(cell);
+  }
+  std::vector<int64_t> durations(cells.size());
+  parse_durations(views(cells), durations, GetParam());
+  for (size_t i = 0; i < cells.size(); ++i) {
+    EXPECT_EQ(durations[i], parse_duration(cells[i]).count())
+        << '"' << cells[i] << '"';
+  }
+}
+
+TEST_P(SimdTest, ParsesGapsLikeParseGap) {
+  std::vector<std::string> cells = {
+      "1",
+      "1.234",
+      "+1.234",
+      "+0.001",
+      "12.3456789",
+      "+99.9",
+      "1.",
+      ".5"};
+  for (const std::string& cell : random_cells("0123456789.")) {
+    // Cells parse_gap would reject are left out, as it exits on them.
+    if (cell.empty() || cell.front() == '.' ||
+        cell.find_first_of("0123456789") == std::string::npos) {
+      continue;
+    }
+    cells.push_back('+' + cell);
+  }
+  std::vector<int64_t> gaps(cells.size());
+  parse_gaps(views(cells), gaps, GetParam());
+  for (size_t i = 0; i < cells.size(); ++i) {
+    EXPECT_EQ(gaps[i], parse_gap(cells[i]).count()) << '"' << cells[i] << '"';
+  }
+}
+
+TEST_P(SimdTest, ParsesIntsLikeParseInt) {
+  std::vector<std::string> cells = {
+      "1",
+      "-1",
+      "0",
+      "007",
+      "123456789",
+      "-123456789",
+      "2147483647",
+      "-2147483648",
+      "42abc",
+      "1.5"};
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> value;
+  for (int i = 0; i < 10000; ++i) {
+    cells.push_back(std::to_string(value(random)));
+  }
+  std::vector<int> values(cells.size());
+  parse_ints(views(cells), values, GetParam());
+  for (size_t i = 0; i < cells.size(); ++i) {
+    EXPECT_EQ(values[i], parse_int(cells[i])) << '"' << cells[i] << '"';
+  }
+}
+
+TEST(SimdDeathTest, ExitsOnMalformedInt) {
+  std::vector<std::string_view> cells = {"1", "x"};
+  std::vector<int> values(cells.size());
+  EXPECT_EXIT(
+      parse_ints(cells, values),
+      ::testing::ExitedWithCode(1),
+      "Failed to parse integer");
+}
+
+} // namespace
+} // namespace f1_predict